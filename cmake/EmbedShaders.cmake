@@ -0,0 +1,55 @@
+# engine_embed_shaders(<target> <shader>...)
+# compiles the shaders to spirv with the vendored glslc at build time and generates <target>_shaders.hpp,
+# one constexpr array per shader named after its file (test-3.vert -> shaders::test_3_vert),
+# pass them to GraphicsPipeline::Builder::addShaderFromSpirv, two shaders mapping to the same name are a configure error
+function(engine_embed_shaders TARGET)
+    set(OUTPUT_DIR ${CMAKE_CURRENT_BINARY_DIR}/embedded_shaders)
+    set(HEADER_CONTENT "// generated by engine_embed_shaders, do not edit\n#pragma once\n\n#include <cstdint>\n\nnamespace shaders {\n")
+    set(SPIRV_FILES)
+    set(SHADER_IDENTIFIERS)
+
+    foreach(SHADER ${ARGN})
+        get_filename_component(SHADER_PATH ${SHADER} ABSOLUTE)
+        get_filename_component(SHADER_NAME ${SHADER} NAME)
+        string(MAKE_C_IDENTIFIER ${SHADER_NAME} SHADER_IDENTIFIER)
+        # the name is all that goes into the symbol and the .inc file, so e.g. a/blur.frag and b/blur.frag would clash
+        if(SHADER_IDENTIFIER IN_LIST SHADER_IDENTIFIERS)
+            message(FATAL_ERROR "engine_embed_shaders(${TARGET}): ${SHADER} maps to shaders::${SHADER_IDENTIFIER} like an earlier shader, rename one of them")
+        endif()
+        list(APPEND SHADER_IDENTIFIERS ${SHADER_IDENTIFIER})
+        set(SPIRV_FILE ${OUTPUT_DIR}/${SHADER_NAME}.inc)
+
+        # same default as the runtime compiler, which optimizes when NDEBUG is defined, i.e. in the configurations below
+        # anything else, including an empty CMAKE_BUILD_TYPE, is compiled unoptimized there too
+        set(GLSLC_OPTIMIZE $<OR:$<CONFIG:Release>,$<CONFIG:RelWithDebInfo>,$<CONFIG:MinSizeRel>>)
+        set(GLSLC_ARGS -mfmt=num $<IF:${GLSLC_OPTIMIZE},-O,-O0> -o ${SPIRV_FILE} ${SHADER_PATH})
+        # makefile generators only take a depfile from 3.20 on, before that included files are not tracked
+        if(CMAKE_VERSION VERSION_GREATER_EQUAL 3.20)
+            add_custom_command(
+                OUTPUT ${SPIRV_FILE}
+                COMMAND glslc_exe -MD -MF ${SPIRV_FILE}.d ${GLSLC_ARGS}
+                DEPENDS ${SHADER_PATH} glslc_exe
+                DEPFILE ${SPIRV_FILE}.d
+                COMMENT "Compiling shader ${SHADER_NAME}"
+                VERBATIM)
+        else()
+            add_custom_command(
+                OUTPUT ${SPIRV_FILE}
+                COMMAND glslc_exe ${GLSLC_ARGS}
+                DEPENDS ${SHADER_PATH} glslc_exe
+                COMMENT "Compiling shader ${SHADER_NAME}"
+                VERBATIM)
+        endif()
+        list(APPEND SPIRV_FILES ${SPIRV_FILE})
+
+        string(APPEND HEADER_CONTENT "\ninline constexpr uint32_t ${SHADER_IDENTIFIER}[] = {\n#include \"${SHADER_NAME}.inc\"\n};\n")
+    endforeach()
+
+    string(APPEND HEADER_CONTENT "\n} // namespace shaders\n")
+    # only rewritten when the shader list changes, so the target does not rebuild on every configure
+    file(GENERATE OUTPUT ${OUTPUT_DIR}/${TARGET}_shaders.hpp CONTENT "${HEADER_CONTENT}")
+
+    add_custom_target(${TARGET}_shaders DEPENDS ${SPIRV_FILES})
+    add_dependencies(${TARGET} ${TARGET}_shaders)
+    target_include_directories(${TARGET} PRIVATE ${OUTPUT_DIR})
+endfunction()
@@ -0,0 +1,71 @@
+#include "file.hpp"
+
+#include "log.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+
+namespace core {
+
+std::string readFile(const std::filesystem::path& path) {
+    std::ifstream file{path};
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to read file: " + path.string());
+    }
+    INFO("Read file {}", path.string());
+
+    return std::string((std::istreambuf_iterator<char>(file)), (std::istreambuf_iterator<char>()));
+}
+
+std::optional<std::string> tryReadFile(const std::filesystem::path& path) {
+    std::ifstream file{path, std::ios::binary};
+    if (!file.is_open()) {
+        return std::nullopt;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), (std::istreambuf_iterator<char>()));
+    if (file.bad()) {
+        return std::nullopt;
+    }
+    return data;
+}
+
+bool writeFileAtomic(const std::filesystem::path& path, std::string_view data) {
+    // unique per thread and call so concurrent writers of the same path never share a temporary
+    static std::atomic<uint64_t> counter{0};
+    std::stringstream suffix;
+    suffix << ".tmp." << std::this_thread::get_id() << "." << counter++;
+    std::filesystem::path temporaryPath = path;
+    temporaryPath += suffix.str();
+
+    std::error_code errorCode;
+    if (path.has_parent_path()) {
+        std::filesystem::create_directories(path.parent_path(), errorCode);
+    }
+    {
+        std::ofstream file{temporaryPath, std::ios::binary | std::ios::trunc};
+        if (!file.is_open()) {
+            WARN("Failed to open {} for writing", temporaryPath.string());
+            return false;
+        }
+        file.write(data.data(), data.size());
+        file.flush();
+        if (!file) {
+            WARN("Failed to write {}", temporaryPath.string());
+            file.close();
+            std::filesystem::remove(temporaryPath, errorCode);
+            return false;
+        }
+    }
+    // rename is atomic on the same filesystem
+    std::filesystem::rename(temporaryPath, path, errorCode);
+    if (errorCode) {
+        WARN("Failed to move {} to {}: {}", temporaryPath.string(), path.string(), errorCode.message());
+        std::filesystem::remove(temporaryPath, errorCode);
+        return false;
+    }
+    return true;
+}
+
+} // namespace core
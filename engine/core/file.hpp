@@ -0,0 +1,23 @@
+#ifndef CORE_FILE_HPP
+#define CORE_FILE_HPP
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace core {
+
+// throws if the file cannot be opened
+std::string readFile(const std::filesystem::path& path);
+
+// binary read, std::nullopt if the file does not exist or cannot be read
+std::optional<std::string> tryReadFile(const std::filesystem::path& path);
+
+// writes to a temporary file next to path and renames it over path, readers never see a partially written file
+// returns false on failure instead of throwing since callers use it for caches
+bool writeFileAtomic(const std::filesystem::path& path, std::string_view data);
+
+} // namespace core
+
+#endif
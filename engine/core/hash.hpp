@@ -0,0 +1,75 @@
+#ifndef CORE_HASH_HPP
+#define CORE_HASH_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+
+namespace core {
+
+// 64 bit FNV-1a, stable across runs and platforms so it can be used for on disk keys
+class Hasher {
+public:
+    Hasher& add(const void *data, size_t size) {
+        auto bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; i++) {
+            m_hash ^= bytes[i];
+            m_hash *= 0x100000001b3ull;
+        }
+        return *this;
+    }
+
+    // the size goes in first so that ("ab", "c") and ("a", "bc") hash differently
+    Hasher& add(std::string_view string) {
+        add(static_cast<uint64_t>(string.size()));
+        return add(string.data(), string.size());
+    }
+
+    template <typename T>
+    Hasher& add(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be hashed by value");
+        return add(&value, sizeof(T));
+    }
+
+    uint64_t get() const { return m_hash; }
+
+private:
+    uint64_t m_hash = 0xcbf29ce484222325ull;
+};
+
+// builds an exact key for a map out of fields appended one by one, for when a hash collision is not acceptable
+// whole structs should only be written when they have no padding and no pointers
+class KeyWriter {
+public:
+    template <typename T>
+    KeyWriter& add(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be written by value");
+        m_key.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        return *this;
+    }
+
+    KeyWriter& add(std::string_view string) {
+        add(static_cast<uint64_t>(string.size()));
+        m_key.append(string);
+        return *this;
+    }
+
+    template <typename T>
+    KeyWriter& addVector(const std::vector<T>& values) {
+        add(static_cast<uint64_t>(values.size()));
+        for (auto& value : values) add(value);
+        return *this;
+    }
+
+    std::string get() { return std::move(m_key); }
+
+private:
+    std::string m_key;
+};
+
+} // namespace core
+
+#endif
@@ -0,0 +1,45 @@
+#include "threadpool.hpp"
+
+#include <algorithm>
+
+namespace core {
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    m_threads.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++) {
+        m_threads.emplace_back(&ThreadPool::worker, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    // queued jobs are still run, their futures would never be satisfied otherwise
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::worker() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock{m_mutex};
+            m_condition.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+            if (m_jobs.empty()) {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop();
+        }
+        job();
+    }
+}
+
+} // namespace core
@@ -0,0 +1,55 @@
+#ifndef CORE_THREADPOOL_HPP
+#define CORE_THREADPOOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace core {
+
+// fixed set of workers pulling from a single fifo queue
+class ThreadPool {
+public:
+    // 0 picks std::thread::hardware_concurrency
+    explicit ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // exceptions thrown by the job are rethrown from future::get
+    template <typename Function>
+    auto submit(Function&& function) -> std::future<std::invoke_result_t<std::decay_t<Function>>> {
+        using Return = std::invoke_result_t<std::decay_t<Function>>;
+        auto task = std::make_shared<std::packaged_task<Return()>>(std::forward<Function>(function));
+        std::future<Return> future = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_jobs.emplace([task]() { (*task)(); });
+        }
+        m_condition.notify_one();
+        return future;
+    }
+
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(m_threads.size()); }
+
+private:
+    void worker();
+
+private:
+    std::vector<std::thread> m_threads;
+    std::queue<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stop = false;
+};
+
+} // namespace core
+
+#endif
@@ -0,0 +1,75 @@
+#include "asyncpipeline.hpp"
+
+#include <cassert>
+
+namespace gfx {
+
+// **********************ASYNCGRAPHICSPIPELINE*********************
+AsyncGraphicsPipeline::Status AsyncGraphicsPipeline::getStatus() const {
+    assert(m_state && "AsyncGraphicsPipeline was not returned by an AsyncPipelineCompiler!");
+    return m_state->status.load(std::memory_order_acquire);
+}
+
+GraphicsPipeline *AsyncGraphicsPipeline::get() const {
+    if (getStatus() == Status::eReady) return m_state->pipeline.get();
+    return m_state->fallback.get();
+}
+
+bool AsyncGraphicsPipeline::bind(const CommandBuffer& commandBuffer) const {
+    GraphicsPipeline *pipeline = get();
+    if (!pipeline) return false;
+    pipeline->bind(commandBuffer);
+    return true;
+}
+
+const std::string& AsyncGraphicsPipeline::getError() const {
+    assert(getStatus() == Status::eFailed && "The pipeline did not fail to build!");
+    return m_state->error;
+}
+
+// **********************ASYNCPIPELINECOMPILER*********************
+AsyncPipelineCompiler::AsyncPipelineCompiler(std::shared_ptr<Device> device, uint32_t threadCount) 
+  : m_device(device), m_fallback(nullptr), m_pendingCount(0), m_threadPool(threadCount) {}
+
+AsyncPipelineCompiler::~AsyncPipelineCompiler() {}
+
+AsyncPipelineCompiler& AsyncPipelineCompiler::setFallback(std::shared_ptr<GraphicsPipeline> fallback) {
+    m_fallback = fallback;
+    return *this;
+}
+
+AsyncGraphicsPipeline AsyncPipelineCompiler::build(const GraphicsPipeline::Builder& builder) {
+    return build(builder, m_fallback);
+}
+
+AsyncGraphicsPipeline AsyncPipelineCompiler::build(const GraphicsPipeline::Builder& builder, std::shared_ptr<GraphicsPipeline> fallback) {
+    auto state = std::make_shared<AsyncGraphicsPipeline::State>();
+    state->fallback = fallback;
+
+    GraphicsPipeline::Builder pipelineBuilder = builder;
+    // queued on the shader compiler pool right away, the worker only waits on it
+    pipelineBuilder.compileShadersAsync();
+
+    m_pendingCount++;
+    // nothing waits on the future, the state is how the result gets out
+    m_threadPool.submit([this, state, pipelineBuilder = std::move(pipelineBuilder)]() mutable {
+        try {
+            state->pipeline = std::make_unique<GraphicsPipeline>(pipelineBuilder.build(m_device));
+            state->status.store(AsyncGraphicsPipeline::Status::eReady, std::memory_order_release);
+        } catch (const std::exception& e) {
+            ERROR("Failed to build a Graphics Pipeline in the background: {}", e.what());
+            state->error = e.what();
+            state->status.store(AsyncGraphicsPipeline::Status::eFailed, std::memory_order_release);
+        } catch (...) {
+            // whatever was thrown, the pending count still has to come down
+            ERROR("Failed to build a Graphics Pipeline in the background: unknown exception");
+            state->error = "unknown exception";
+            state->status.store(AsyncGraphicsPipeline::Status::eFailed, std::memory_order_release);
+        }
+        m_pendingCount--;
+    });
+
+    return {state};
+}
+
+} // namespace gfx
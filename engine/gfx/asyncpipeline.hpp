@@ -0,0 +1,83 @@
+#ifndef GFX_ASYNCPIPELINE_HPP
+#define GFX_ASYNCPIPELINE_HPP
+
+#include "pipeline.hpp"
+#include "../core/threadpool.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace gfx {
+
+// a pipeline that is still being built by an AsyncPipelineCompiler, cheap to copy and safe to query every frame
+// until it is ready, get hands out the fallback (or nothing, then skip the draw)
+// note: the fallback is bound in place of the real pipeline, it has to be compatible with the descriptor sets and push constants used with it
+class AsyncGraphicsPipeline {
+public:
+    enum class Status {
+        ePending,
+        eReady,
+        eFailed,    // the fallback stays in use, getError says why
+    };
+
+    AsyncGraphicsPipeline() = default;
+
+    Status getStatus() const;
+    bool isReady() const { return getStatus() == Status::eReady; }
+    // never blocks: the real pipeline once built, the fallback before that or if the build failed, nullptr without a fallback
+    GraphicsPipeline *get() const;
+    // binds whatever get returns, false when there is nothing to bind and the draw should be skipped
+    bool bind(const CommandBuffer& commandBuffer) const;
+    // only valid once the status is eFailed
+    const std::string& getError() const;
+
+private:
+    friend class AsyncPipelineCompiler;
+
+    struct State {
+        std::atomic<Status> status{Status::ePending};
+        // written by the worker before status is published
+        std::unique_ptr<GraphicsPipeline> pipeline;
+        std::string error;
+        std::shared_ptr<GraphicsPipeline> fallback;
+    };
+
+    AsyncGraphicsPipeline(std::shared_ptr<State> state) : m_state(std::move(state)) {}
+
+private:
+    std::shared_ptr<State> m_state;
+};
+
+// builds graphics pipelines on worker threads so a pipeline first needed mid frame never stalls the frame on the shader compiler
+class AsyncPipelineCompiler {
+public:
+    // 0 picks one thread per core
+    AsyncPipelineCompiler(std::shared_ptr<Device> device, uint32_t threadCount = 0);
+    // waits for the builds that were already started
+    ~AsyncPipelineCompiler();
+
+    AsyncPipelineCompiler(const AsyncPipelineCompiler&) = delete;
+    AsyncPipelineCompiler& operator=(const AsyncPipelineCompiler&) = delete;
+
+    // handed out by every build that does not bring its own fallback
+    AsyncPipelineCompiler& setFallback(std::shared_ptr<GraphicsPipeline> fallback);
+
+    // builds a copy of builder in the background and returns right away
+    AsyncGraphicsPipeline build(const GraphicsPipeline::Builder& builder);
+    AsyncGraphicsPipeline build(const GraphicsPipeline::Builder& builder, std::shared_ptr<GraphicsPipeline> fallback);
+
+    // builds started and not finished yet
+    uint32_t getPendingCount() const { return m_pendingCount; }
+
+private:
+    std::shared_ptr<Device> m_device;
+    std::shared_ptr<GraphicsPipeline> m_fallback;
+    std::atomic<uint32_t> m_pendingCount;
+    // last so it is drained before anything the jobs use goes away
+    core::ThreadPool m_threadPool;
+};
+
+} // namespace gfx
+
+#endif
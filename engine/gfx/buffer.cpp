@@ -25,6 +25,11 @@ Buffer::Builder& Buffer::Builder::setMemoryProperty(vk::MemoryPropertyFlags flag
 
 Buffer Buffer::Builder::build(std::shared_ptr<Device> device) {
     assert(m_memoryPropertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent && "buffer must be host coherent atm, temporary!");
+    // the descriptor buffer backend describes buffers by device address
+    const vk::BufferUsageFlags descriptorUsage = vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer;
+    if (device->getDescriptorBackend() == Device::DescriptorBackend::eDescriptorBuffer && (m_bufferCreateInfo.usage & descriptorUsage)) {
+        m_bufferCreateInfo.usage |= vk::BufferUsageFlagBits::eShaderDeviceAddress;
+    }
     vk::Buffer buffer;
     if (device->get().createBuffer(&m_bufferCreateInfo, nullptr, &buffer) != vk::Result::eSuccess) {
         throw std::runtime_error("Failed to create buffer!");
@@ -35,6 +40,12 @@ Buffer Buffer::Builder::build(std::shared_ptr<Device> device) {
         .setAllocationSize(memoryRequirements.size)
         .setMemoryTypeIndex(device->findMemoryType(memoryRequirements.memoryTypeBits, m_memoryPropertyFlags));
 
+    vk::MemoryAllocateFlagsInfo memoryAllocateFlagsInfo = vk::MemoryAllocateFlagsInfo{}
+        .setFlags(vk::MemoryAllocateFlagBits::eDeviceAddress);
+    if (m_bufferCreateInfo.usage & vk::BufferUsageFlagBits::eShaderDeviceAddress) {
+        memoryAllocateInfo.setPNext(&memoryAllocateFlagsInfo);
+    }
+
     vk::DeviceMemory deviceMemory;
 
     auto res = device->get().allocateMemory(&memoryAllocateInfo, nullptr, &deviceMemory);
@@ -61,13 +72,13 @@ Buffer::~Buffer() {
     m_deviceMemory = VK_NULL_HANDLE;
 }
 
+// the mapping belongs to the memory, so it moves along with it
 Buffer::Buffer(Buffer&& buffer) 
-  : m_device(buffer.m_device), m_buffer(buffer.m_buffer), m_deviceMemory(buffer.m_deviceMemory), m_bufferSize(buffer.m_bufferSize) {
-    if (isMapped()) 
-        unmap();
+  : m_device(buffer.m_device), m_buffer(buffer.m_buffer), m_deviceMemory(buffer.m_deviceMemory), m_bufferSize(buffer.m_bufferSize), m_mapped(buffer.m_mapped) {
     buffer.m_device = nullptr;
     buffer.m_buffer = VK_NULL_HANDLE;
     buffer.m_deviceMemory = VK_NULL_HANDLE;
+    buffer.m_mapped = nullptr;
 }
 
 Buffer& Buffer::operator=(Buffer&& buffer) {
@@ -77,9 +88,11 @@ Buffer& Buffer::operator=(Buffer&& buffer) {
     m_buffer = buffer.m_buffer;
     m_deviceMemory = buffer.m_deviceMemory;
     m_bufferSize = buffer.m_bufferSize;
+    m_mapped = buffer.m_mapped;
     buffer.m_device = nullptr;
     buffer.m_buffer = VK_NULL_HANDLE;
     buffer.m_deviceMemory = VK_NULL_HANDLE;
+    buffer.m_mapped = nullptr;
     return *this;
 }
 
@@ -93,11 +106,17 @@ void Buffer::unmap() {
     m_mapped = nullptr;
 }
 
-vk::DescriptorBufferInfo Buffer::getDescriptorBufferInfo(uint32_t offset) const {
+vk::DescriptorBufferInfo Buffer::getDescriptorBufferInfo(vk::DeviceSize offset, vk::DeviceSize range) const {
+    assert(offset < m_bufferSize && (range == VK_WHOLE_SIZE || offset + range <= m_bufferSize));
+    // resolved here so the info is self contained (the descriptor buffer backend needs the real size)
     return vk::DescriptorBufferInfo{}
         .setBuffer(m_buffer)
         .setOffset(offset)
-        .setRange(m_bufferSize);
+        .setRange(range == VK_WHOLE_SIZE ? m_bufferSize - offset : range);
+}
+
+vk::DeviceAddress Buffer::getDeviceAddress() const {
+    return m_device->get().getBufferAddress(vk::BufferDeviceAddressInfo{}.setBuffer(m_buffer));
 }
 
 } // namespace gfx
\ No newline at end of file
@@ -39,7 +39,11 @@ public:
     // void flush();
     // void invalidate();
 
-    vk::DescriptorBufferInfo getDescriptorBufferInfo(uint32_t offset = 0) const;
+    // for dynamic buffers offset is usually 0 and range the size of one element, the rest comes from the dynamic offset
+    vk::DescriptorBufferInfo getDescriptorBufferInfo(vk::DeviceSize offset = 0, vk::DeviceSize range = VK_WHOLE_SIZE) const;
+    vk::DeviceSize getSize() const { return m_bufferSize; }
+    // requires vk::BufferUsageFlagBits::eShaderDeviceAddress
+    vk::DeviceAddress getDeviceAddress() const;
 
 private:
     Buffer(std::shared_ptr<Device> device, vk::Buffer buffer, vk::DeviceMemory deviceMemory, vk::DeviceSize bufferSize);
@@ -1,5 +1,7 @@
 #include "commandbuffer.hpp"
 
+#include <algorithm>
+
 namespace gfx {
 
 // **********CommandPool::Builder**********
@@ -46,11 +48,11 @@ CommandPool& CommandPool::operator=(CommandPool&& commandPool) {
     return *this;
 }
 
-std::vector<CommandBuffer> CommandPool::createCommandBuffer(uint32_t commandBufferCount) {
+std::vector<CommandBuffer> CommandPool::createCommandBuffer(uint32_t commandBufferCount, vk::CommandBufferLevel commandBufferLevel) {
     vk::CommandBufferAllocateInfo commandBufferAllocateInfo = vk::CommandBufferAllocateInfo{}
         .setCommandPool(m_commandPool)
         .setCommandBufferCount(commandBufferCount)
-        .setLevel(vk::CommandBufferLevel::ePrimary);
+        .setLevel(commandBufferLevel);
     
     std::vector<vk::CommandBuffer> vkCommandBuffers;
     vkCommandBuffers.resize(commandBufferCount);
@@ -63,17 +65,47 @@ std::vector<CommandBuffer> CommandPool::createCommandBuffer(uint32_t commandBuff
     commandBuffers.reserve(vkCommandBuffers.size());
 
     for (auto& vkCommandBuffer : vkCommandBuffers) {
-        commandBuffers.emplace_back(vkCommandBuffer);
+        commandBuffers.emplace_back(vkCommandBuffer, &m_device->getDispatchLoaderDynamic());
     }
 
     return commandBuffers;
 }
 
+void CommandPool::reset(vk::CommandPoolResetFlags resetFlags) {
+    m_device->get().resetCommandPool(m_commandPool, resetFlags);
+}
+
+// **********LinearCommandPool**********
+LinearCommandPool::LinearCommandPool(std::shared_ptr<Device> device, uint32_t queueFamilyIndex, vk::CommandBufferLevel commandBufferLevel) : m_commandBufferLevel(commandBufferLevel), m_acquiredCommandBuffers(0) {
+    // no eResetCommandBuffer, the buffers are only ever reset together with the pool
+    m_commandPool = CommandPool::Builder{}
+        .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+        .setQueueFamilyIndex(queueFamilyIndex)
+        .build(device);
+}
+
+CommandBuffer LinearCommandPool::acquire() {
+    if (m_acquiredCommandBuffers == m_commandBuffers.size()) {
+        m_commandBuffers.push_back(m_commandPool.createCommandBuffer(1, m_commandBufferLevel)[0]);
+    }
+    return m_commandBuffers[m_acquiredCommandBuffers++];
+}
+
+void LinearCommandPool::reset() {
+    if (m_acquiredCommandBuffers == 0) return;
+    m_commandPool.reset();
+    m_acquiredCommandBuffers = 0;
+}
+
 // **********CommandBuffer::Builder**********
 
 
 // **********CommandBuffer**********
-CommandBuffer::CommandBuffer(vk::CommandBuffer commandBuffer) : m_commandBuffer(commandBuffer) {
+CommandBuffer::CommandBuffer(vk::CommandBuffer commandBuffer) : m_commandBuffer(commandBuffer), m_dispatchLoaderDynamic(nullptr), m_boundDescriptorBuffers(std::make_shared<std::vector<vk::DeviceAddress>>()) {
+
+}
+
+CommandBuffer::CommandBuffer(vk::CommandBuffer commandBuffer, const vk::DispatchLoaderDynamic *dispatchLoaderDynamic) : m_commandBuffer(commandBuffer), m_dispatchLoaderDynamic(dispatchLoaderDynamic), m_boundDescriptorBuffers(std::make_shared<std::vector<vk::DeviceAddress>>()) {
 
 }
 
@@ -81,7 +113,7 @@ CommandBuffer::~CommandBuffer() {
     // m_commandBuffer = VK_NULL_HANDLE;
 }
 
-CommandBuffer::CommandBuffer(CommandBuffer&& commandBuffer) : m_commandBuffer(commandBuffer.m_commandBuffer) {
+CommandBuffer::CommandBuffer(CommandBuffer&& commandBuffer) : m_commandBuffer(commandBuffer.m_commandBuffer), m_dispatchLoaderDynamic(commandBuffer.m_dispatchLoaderDynamic), m_boundDescriptorBuffers(commandBuffer.m_boundDescriptorBuffers) {
     // commandBuffer.m_commandBuffer = VK_NULL_HANDLE;
 }
 
@@ -93,6 +125,7 @@ void CommandBuffer::begin(vk::CommandBufferUsageFlags commandBufferUsageFlags, c
     if (m_commandBuffer.begin(&commandBufferBeginInfo) != vk::Result::eSuccess) {
         throw std::runtime_error("Failed to begin recording command buffer!");
     }
+    if (m_boundDescriptorBuffers) m_boundDescriptorBuffers->clear();
 }
 
 void CommandBuffer::end() {
@@ -103,4 +136,164 @@ void CommandBuffer::reset(vk::CommandBufferResetFlags resetFlags) {
     m_commandBuffer.reset(resetFlags);
 }
 
+void CommandBuffer::executeCommands(vk::ArrayProxy<const CommandBuffer> const& commandBuffers) const {
+    if (commandBuffers.empty()) return;
+
+    std::vector<vk::CommandBuffer> vkCommandBuffers;
+    vkCommandBuffers.reserve(commandBuffers.size());
+    for (auto& commandBuffer : commandBuffers) {
+        vkCommandBuffers.push_back(commandBuffer.get());
+    }
+    m_commandBuffer.executeCommands(vkCommandBuffers);
+}
+
+void CommandBuffer::bindDescriptorBuffers(vk::ArrayProxy<const DescriptorPool * const> const& descriptorPools) const {
+    if (descriptorPools.empty()) return;
+
+    std::vector<vk::DeviceAddress> addresses;
+    addresses.reserve(descriptorPools.size());
+    for (auto *descriptorPool : descriptorPools) {
+        assert(descriptorPool->m_descriptorBufferAddress && "Descriptor pool is not descriptor buffer backed!");
+        addresses.push_back(descriptorPool->m_descriptorBufferAddress);
+    }
+    bindDescriptorBuffers(addresses.data(), static_cast<uint32_t>(addresses.size()), descriptorPools.front()->m_device->getDispatchLoaderDynamic());
+}
+
+void CommandBuffer::bindDescriptorBuffers(const vk::DeviceAddress *addresses, uint32_t addressCount, const vk::DispatchLoaderDynamic& dispatchLoaderDynamic) const {
+    std::vector<vk::DescriptorBufferBindingInfoEXT> descriptorBufferBindingInfos;
+    descriptorBufferBindingInfos.reserve(addressCount);
+    for (uint32_t i = 0; i < addressCount; i++) {
+        descriptorBufferBindingInfos.push_back(vk::DescriptorBufferBindingInfoEXT{}
+            .setAddress(addresses[i])
+            .setUsage(DescriptorPool::getDescriptorBufferUsage()));
+    }
+    m_commandBuffer.bindDescriptorBuffersEXT(addressCount, descriptorBufferBindingInfos.data(), dispatchLoaderDynamic);
+    m_boundDescriptorBuffers->assign(addresses, addresses + addressCount);
+}
+
+void CommandBuffer::bindDescriptorSets(vk::PipelineBindPoint pipelineBindPoint, vk::PipelineLayout pipelineLayout, uint32_t set, const DescriptorSet& descriptorSet, vk::ArrayProxy<const uint32_t> const& dynamicOffsets) const {
+    const DescriptorSet *descriptorSetPtr = &descriptorSet;
+    bindDescriptorSets(pipelineBindPoint, pipelineLayout, set, vk::ArrayProxy<const DescriptorSet * const>(descriptorSetPtr), dynamicOffsets);
+}
+
+void CommandBuffer::bindDescriptorSets(vk::PipelineBindPoint pipelineBindPoint, vk::PipelineLayout pipelineLayout, uint32_t firstSet, vk::ArrayProxy<const DescriptorSet * const> const& descriptorSets, vk::ArrayProxy<const uint32_t> const& dynamicOffsets) const {
+    constexpr uint32_t MAX_SETS = 8;
+    assert(descriptorSets.size() <= MAX_SETS && "Too many descriptor sets bound at once!");
+    if (descriptorSets.empty()) return;
+
+    if (descriptorSets.front()->isDescriptorBufferBacked()) {
+        assert(dynamicOffsets.empty() && "Dynamic offsets are not supported by the descriptor buffer backend!");
+        auto& boundDescriptorBuffers = *m_boundDescriptorBuffers;
+        // nothing bound yet in this recording, bind the pools of these sets
+        if (boundDescriptorBuffers.empty()) {
+            std::array<vk::DeviceAddress, MAX_SETS> addresses;
+            uint32_t addressCount = 0;
+            for (uint32_t i = 0; i < descriptorSets.size(); i++) {
+                vk::DeviceAddress address = descriptorSets.data()[i]->m_descriptorBufferAddress;
+                if (std::find(addresses.begin(), addresses.begin() + addressCount, address) == addresses.begin() + addressCount) {
+                    addresses[addressCount++] = address;
+                }
+            }
+            bindDescriptorBuffers(addresses.data(), addressCount, descriptorSets.front()->m_device->getDispatchLoaderDynamic());
+        }
+
+        std::array<uint32_t, MAX_SETS> bufferIndices;
+        std::array<vk::DeviceSize, MAX_SETS> offsets;
+        for (uint32_t i = 0; i < descriptorSets.size(); i++) {
+            const DescriptorSet *descriptorSet = descriptorSets.data()[i];
+            assert(descriptorSet->isDescriptorBufferBacked() && "Cannot mix descriptor backends in a single bind!");
+            auto it = std::find(boundDescriptorBuffers.begin(), boundDescriptorBuffers.end(), descriptorSet->m_descriptorBufferAddress);
+            // binding it now would invalidate the offsets of the sets already bound from the other buffers
+            if (it == boundDescriptorBuffers.end()) {
+                throw std::runtime_error("Descriptor set's pool is not bound, pass every pool of the recording to bindDescriptorBuffers up front!");
+            }
+            bufferIndices[i] = static_cast<uint32_t>(it - boundDescriptorBuffers.begin());
+            offsets[i] = descriptorSet->m_descriptorBufferOffset;
+        }
+        m_commandBuffer.setDescriptorBufferOffsetsEXT(pipelineBindPoint, pipelineLayout, firstSet, descriptorSets.size(), bufferIndices.data(), offsets.data(), descriptorSets.front()->m_device->getDispatchLoaderDynamic());
+        return;
+    }
+
+    std::array<vk::DescriptorSet, MAX_SETS> vkDescriptorSets;
+    uint32_t dynamicOffsetCount = 0;
+    for (uint32_t i = 0; i < descriptorSets.size(); i++) {
+        vkDescriptorSets[i] = descriptorSets.data()[i]->get();
+        dynamicOffsetCount += descriptorSets.data()[i]->getDescriptorSetLayout().getDynamicOffsetCount();
+    }
+    assert(dynamicOffsets.size() == dynamicOffsetCount && "Dynamic offset count does not match the sets' layouts!");
+    m_commandBuffer.bindDescriptorSets(pipelineBindPoint, pipelineLayout, firstSet, descriptorSets.size(), vkDescriptorSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
+}
+
+void CommandBuffer::bindDescriptorSets(vk::PipelineBindPoint pipelineBindPoint, vk::PipelineLayout pipelineLayout, uint32_t firstSet, vk::ArrayProxy<const vk::DescriptorSet> const& descriptorSets, vk::ArrayProxy<const uint32_t> const& dynamicOffsets) const {
+    m_commandBuffer.bindDescriptorSets(pipelineBindPoint, pipelineLayout, firstSet, descriptorSets.size(), descriptorSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
+}
+
+void CommandBuffer::pushDescriptorSet(vk::PipelineBindPoint pipelineBindPoint, vk::PipelineLayout pipelineLayout, uint32_t set, const DescriptorSetLayout& descriptorSetLayout, const DescriptorSet::Update& update) const {
+    assert(descriptorSetLayout.isPushDescriptor() && "Descriptor Set Layout was not built with setPushDescriptor(true)!");
+    std::array<vk::WriteDescriptorSet, DescriptorSet::Update::MAX_WRITES> writeDescriptorSets;
+    for (uint32_t i = 0; i < update.m_writeCount; i++) {
+        // dstSet is ignored for push descriptors
+        writeDescriptorSets[i] = update.m_writes[i].resolve(descriptorSetLayout, VK_NULL_HANDLE);
+    }
+    m_commandBuffer.pushDescriptorSetKHR(pipelineBindPoint, pipelineLayout, set, update.m_writeCount, writeDescriptorSets.data(), descriptorSetLayout.m_device->getDispatchLoaderDynamic());
+}
+
+const vk::DispatchLoaderDynamic& CommandBuffer::getDispatchLoaderDynamic() const {
+    assert(m_dispatchLoaderDynamic && "Command buffer was not allocated from a CommandPool, extension commands are unavailable!");
+    return *m_dispatchLoaderDynamic;
+}
+
+void CommandBuffer::setViewport(const vk::Viewport& viewport) const {
+    m_commandBuffer.setViewport(0, viewport);
+}
+
+void CommandBuffer::setScissor(const vk::Rect2D& scissor) const {
+    m_commandBuffer.setScissor(0, scissor);
+}
+
+// the dispatch falls back to the EXT entry points when the device is older than 1.3
+void CommandBuffer::setCullMode(vk::CullModeFlags cullMode) const {
+    m_commandBuffer.setCullMode(cullMode, getDispatchLoaderDynamic());
+}
+
+void CommandBuffer::setFrontFace(vk::FrontFace frontFace) const {
+    m_commandBuffer.setFrontFace(frontFace, getDispatchLoaderDynamic());
+}
+
+void CommandBuffer::setPrimitiveTopology(vk::PrimitiveTopology primitiveTopology) const {
+    m_commandBuffer.setPrimitiveTopology(primitiveTopology, getDispatchLoaderDynamic());
+}
+
+void CommandBuffer::setRasterizerDiscardEnable(bool enable) const {
+    m_commandBuffer.setRasterizerDiscardEnable(enable, getDispatchLoaderDynamic());
+}
+
+void CommandBuffer::setDepthBiasEnable(bool enable) const {
+    m_commandBuffer.setDepthBiasEnable(enable, getDispatchLoaderDynamic());
+}
+
+void CommandBuffer::setPrimitiveRestartEnable(bool enable) const {
+    m_commandBuffer.setPrimitiveRestartEnable(enable, getDispatchLoaderDynamic());
+}
+
+void CommandBuffer::setPolygonMode(vk::PolygonMode polygonMode) const {
+    m_commandBuffer.setPolygonModeEXT(polygonMode, getDispatchLoaderDynamic());
+}
+
+void CommandBuffer::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) const {
+    m_commandBuffer.dispatch(groupCountX, groupCountY, groupCountZ);
+}
+
+void CommandBuffer::dispatchThreads(const vk::Extent3D& threadCount, const vk::Extent3D& workgroupSize) const {
+    assert(workgroupSize.width > 0 && workgroupSize.height > 0 && workgroupSize.depth > 0 && "Workgroup size can not be zero!");
+    m_commandBuffer.dispatch(getGroupCount(threadCount.width, workgroupSize.width), 
+                             getGroupCount(threadCount.height, workgroupSize.height), 
+                             getGroupCount(threadCount.depth, workgroupSize.depth));
+}
+
+void CommandBuffer::dispatchIndirect(const Buffer& buffer, vk::DeviceSize offset) const {
+    assert(offset % 4 == 0 && "Indirect dispatch offset must be a multiple of 4!");
+    m_commandBuffer.dispatchIndirect(buffer.get(), offset);
+}
+
 } // namespace gfx
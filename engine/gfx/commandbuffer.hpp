@@ -2,27 +2,87 @@
 #define GFX_COMMANDBUFFER_HPP
 
 #include "device.hpp"
+#include "descriptors.hpp"
 
 namespace gfx {
 
 class CommandBuffer {
 public:
     CommandBuffer(vk::CommandBuffer commandBuffer);
+    // the dispatch is needed for the extension entry points (extended dynamic state), command pools pass the device's
+    CommandBuffer(vk::CommandBuffer commandBuffer, const vk::DispatchLoaderDynamic *dispatchLoaderDynamic);
 
     void reset(vk::CommandBufferResetFlags resetFlags = {});
     void begin(vk::CommandBufferUsageFlags commandBufferUsageFlags = {}, const vk::CommandBufferInheritanceInfo& commandBufferInheritanceInfo = {});
     void end();
 
-    CommandBuffer() : m_commandBuffer(VK_NULL_HANDLE) {}
+    // secondary command buffers, recorded against the render pass of the primary when begun with eRenderPassContinue
+    void executeCommands(vk::ArrayProxy<const CommandBuffer> const& commandBuffers) const;
+
+    // descriptor buffer backend, binds the buffers of every pool the recording will take sets from, each at its index in descriptorPools
+    // binding replaces the earlier bindings and invalidates the sets bound from them, so call it once right after begin
+    // without it the first bindDescriptorSets binds the pools of its own sets
+    void bindDescriptorBuffers(vk::ArrayProxy<const DescriptorPool * const> const& descriptorPools) const;
+
+    // dynamic offsets are consumed in binding order, one per dynamic descriptor of the set's layout
+    void bindDescriptorSets(vk::PipelineBindPoint pipelineBindPoint, vk::PipelineLayout pipelineLayout, uint32_t set, const DescriptorSet& descriptorSet, vk::ArrayProxy<const uint32_t> const& dynamicOffsets = nullptr) const;
+    // binds consecutive sets, descriptor buffer backed sets are selected by offset into the buffers bound with bindDescriptorBuffers
+    void bindDescriptorSets(vk::PipelineBindPoint pipelineBindPoint, vk::PipelineLayout pipelineLayout, uint32_t firstSet, vk::ArrayProxy<const DescriptorSet * const> const& descriptorSets, vk::ArrayProxy<const uint32_t> const& dynamicOffsets = nullptr) const;
+    // raw handles, only valid for the pool descriptor backend
+    void bindDescriptorSets(vk::PipelineBindPoint pipelineBindPoint, vk::PipelineLayout pipelineLayout, uint32_t firstSet, vk::ArrayProxy<const vk::DescriptorSet> const& descriptorSets, vk::ArrayProxy<const uint32_t> const& dynamicOffsets = nullptr) const;
+
+    // VK_KHR_push_descriptor, records the writes straight into the command buffer, nothing is allocated from a pool
+    // descriptorSetLayout must be built with setPushDescriptor(true) and be the layout of set in pipelineLayout
+    void pushDescriptorSet(vk::PipelineBindPoint pipelineBindPoint, vk::PipelineLayout pipelineLayout, uint32_t set, const DescriptorSetLayout& descriptorSetLayout, const DescriptorSet::Update& update) const;
+
+    template <typename T>
+    void pushConstants(vk::PipelineLayout pipelineLayout, vk::ShaderStageFlags shaderStageFlags, const T& value, uint32_t offset = 0) const {
+        static_assert(std::is_trivially_copyable_v<T>, "Push constants are copied as raw bytes!");
+        m_commandBuffer.pushConstants(pipelineLayout, shaderStageFlags, offset, sizeof(T), &value);
+    }
+
+    // dynamic state, only valid when the bound pipeline has the state dynamic (GraphicsPipeline::hasDynamicState)
+    void setViewport(const vk::Viewport& viewport) const;
+    void setScissor(const vk::Rect2D& scissor) const;
+    // extended dynamic state
+    void setCullMode(vk::CullModeFlags cullMode) const;
+    void setFrontFace(vk::FrontFace frontFace) const;
+    void setPrimitiveTopology(vk::PrimitiveTopology primitiveTopology) const;
+    // extended dynamic state 2
+    void setRasterizerDiscardEnable(bool enable) const;
+    void setDepthBiasEnable(bool enable) const;
+    void setPrimitiveRestartEnable(bool enable) const;
+    // extended dynamic state 3
+    void setPolygonMode(vk::PolygonMode polygonMode) const;
+
+    // compute, a compute pipeline has to be bound
+    void dispatch(uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1) const;
+    // enough workgroups of workgroupSize to cover threadCount, the last ones in each dimension may be partial so the shader has to bounds check
+    void dispatchThreads(const vk::Extent3D& threadCount, const vk::Extent3D& workgroupSize) const;
+    // reads a vk::DispatchIndirectCommand at offset, buffer needs the eIndirectBuffer usage
+    void dispatchIndirect(const Buffer& buffer, vk::DeviceSize offset = 0) const;
+    // number of workgroups of workgroupSize needed to cover threadCount
+    static uint32_t getGroupCount(uint32_t threadCount, uint32_t workgroupSize) { return (threadCount + workgroupSize - 1) / workgroupSize; }
+
+    CommandBuffer() : m_commandBuffer(VK_NULL_HANDLE), m_dispatchLoaderDynamic(nullptr), m_boundDescriptorBuffers(nullptr) {}
     ~CommandBuffer();
 
     CommandBuffer(CommandBuffer&& commandPool);
     CommandBuffer(const CommandBuffer&) = default;
+    CommandBuffer& operator=(const CommandBuffer&) = default;
 
     vk::CommandBuffer get() const { return m_commandBuffer; }
 
+private:
+    const vk::DispatchLoaderDynamic& getDispatchLoaderDynamic() const;
+    void bindDescriptorBuffers(const vk::DeviceAddress *addresses, uint32_t addressCount, const vk::DispatchLoaderDynamic& dispatchLoaderDynamic) const;
+
 private:
     vk::CommandBuffer m_commandBuffer;
+    const vk::DispatchLoaderDynamic *m_dispatchLoaderDynamic;
+    // addresses of the descriptor buffers bound in the current recording, by binding index, cleared by begin
+    // shared so every copy of the command buffer sees the same bindings
+    std::shared_ptr<std::vector<vk::DeviceAddress>> m_boundDescriptorBuffers;
 };
 
 class CommandPool {
@@ -45,7 +105,9 @@ public:
 
     CommandPool& operator=(CommandPool&& commandPool);
 
-    std::vector<CommandBuffer> createCommandBuffer(uint32_t commandBufferCount);
+    std::vector<CommandBuffer> createCommandBuffer(uint32_t commandBufferCount, vk::CommandBufferLevel commandBufferLevel = vk::CommandBufferLevel::ePrimary);
+    // recycles every command buffer allocated from the pool at once, none of them may still be pending execution
+    void reset(vk::CommandPoolResetFlags resetFlags = {});
 
     vk::CommandPool get() const { return m_commandPool; }
 
@@ -57,6 +119,30 @@ private:
     vk::CommandPool m_commandPool;
 };
 
+// transient pool handing its command buffers out linearly, all of them are recycled at once with vkResetCommandPool
+// meant to be owned by one frame in flight (and one thread), it is not thread safe
+class LinearCommandPool {
+public:
+    LinearCommandPool() : m_commandBufferLevel(vk::CommandBufferLevel::ePrimary), m_acquiredCommandBuffers(0) {}
+    LinearCommandPool(std::shared_ptr<Device> device, uint32_t queueFamilyIndex, vk::CommandBufferLevel commandBufferLevel = vk::CommandBufferLevel::ePrimary);
+
+    LinearCommandPool(LinearCommandPool&&) = default;
+    LinearCommandPool(const LinearCommandPool&) = delete;
+
+    // the next buffer in the pool, only allocated when more are needed than in any frame before, already reset
+    CommandBuffer acquire();
+    // none of the buffers acquired since the last reset may still be pending execution
+    void reset();
+
+    uint32_t getAcquiredCount() const { return m_acquiredCommandBuffers; }
+
+private:
+    CommandPool m_commandPool;
+    vk::CommandBufferLevel m_commandBufferLevel;
+    std::vector<CommandBuffer> m_commandBuffers;
+    uint32_t m_acquiredCommandBuffers;
+};
+
 } // namespace gfx
 
 #endif
\ No newline at end of file
@@ -1,5 +1,10 @@
 #include "descriptors.hpp"
 
+#include "../core/hash.hpp"
+
+#include <algorithm>
+#include <cstring>
+
 namespace gfx {
     
 // **********DescriptorSetLayout::Builder**********
@@ -18,12 +23,62 @@ DescriptorSetLayout::Builder& DescriptorSetLayout::Builder::setFlags(vk::Descrip
     return *this;  
 }
 
+DescriptorSetLayout::Builder& DescriptorSetLayout::Builder::setPushDescriptor(bool enable) {
+    if (enable) {
+        m_descriptorSetLayoutCreateInfo.flags |= vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptorKHR;
+    } else {
+        m_descriptorSetLayoutCreateInfo.flags &= ~vk::DescriptorSetLayoutCreateFlags(vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptorKHR);
+    }
+    return *this;
+}
+
+static bool isDynamicDescriptorType(vk::DescriptorType descriptorType) {
+    return descriptorType == vk::DescriptorType::eUniformBufferDynamic || descriptorType == vk::DescriptorType::eStorageBufferDynamic;
+}
+
+static DescriptorSet::Update::InfoType descriptorInfoType(vk::DescriptorType descriptorType) {
+    switch (descriptorType) {
+        case vk::DescriptorType::eSampler:
+        case vk::DescriptorType::eCombinedImageSampler:
+        case vk::DescriptorType::eSampledImage:
+        case vk::DescriptorType::eStorageImage:
+        case vk::DescriptorType::eInputAttachment:
+            return DescriptorSet::Update::InfoType::eImage;
+        case vk::DescriptorType::eUniformTexelBuffer:
+        case vk::DescriptorType::eStorageTexelBuffer:
+            return DescriptorSet::Update::InfoType::eTexelBuffer;
+        case vk::DescriptorType::eUniformBuffer:
+        case vk::DescriptorType::eStorageBuffer:
+        case vk::DescriptorType::eUniformBufferDynamic:
+        case vk::DescriptorType::eStorageBufferDynamic:
+            return DescriptorSet::Update::InfoType::eBuffer;
+        default:
+            // inline uniform blocks and acceleration structures need their own write structs, which the writes do not carry
+            throw std::runtime_error("Descriptor type " + vk::to_string(descriptorType) + " is not supported by DescriptorSet::Update!");
+    }
+}
+
 DescriptorSetLayout DescriptorSetLayout::Builder::build(std::shared_ptr<Device> device) {
+    bool pushDescriptor = bool(m_descriptorSetLayoutCreateInfo.flags & vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptorKHR);
+    if (pushDescriptor && !device->isPushDescriptorSupported()) {
+        throw std::runtime_error("Push descriptor layout requested but VK_KHR_push_descriptor is not supported!");
+    }
     std::vector<vk::DescriptorSetLayoutBinding> descriptorSetLayoutBindings;
     descriptorSetLayoutBindings.reserve(m_descriptorBindingDescriptions.size());
     for (auto& [binding, descriptorSetLayoutBinding] : m_descriptorBindingDescriptions) {
+        if (device->getDescriptorBackend() == Device::DescriptorBackend::eDescriptorBuffer && isDynamicDescriptorType(descriptorSetLayoutBinding.descriptorType)) {
+            throw std::runtime_error("Dynamic buffer descriptors are not supported by the descriptor buffer backend!");
+        }
+        if (pushDescriptor && isDynamicDescriptorType(descriptorSetLayoutBinding.descriptorType)) {
+            throw std::runtime_error("Dynamic buffer descriptors cannot be pushed!");
+        }
+        // rejects the types no set of this layout could be updated with, rather than failing on the first update
+        descriptorInfoType(descriptorSetLayoutBinding.descriptorType);
         descriptorSetLayoutBindings.push_back(descriptorSetLayoutBinding);
     }
+    if (device->getDescriptorBackend() == Device::DescriptorBackend::eDescriptorBuffer) {
+        m_descriptorSetLayoutCreateInfo.flags |= vk::DescriptorSetLayoutCreateFlagBits::eDescriptorBufferEXT;
+    }
     m_descriptorSetLayoutCreateInfo.setBindingCount(descriptorSetLayoutBindings.size())
                                    .setPBindings(descriptorSetLayoutBindings.data());
     vk::DescriptorSetLayout descriptorSetLayout;
@@ -31,20 +86,37 @@ DescriptorSetLayout DescriptorSetLayout::Builder::build(std::shared_ptr<Device>
     if (res != vk::Result::eSuccess) {
         throw std::runtime_error("Failed to create Descriptor Set Layout!");
     }
-    return {device, descriptorSetLayout, m_descriptorBindingDescriptions};
+    return {device, descriptorSetLayout, m_descriptorBindingDescriptions, m_descriptorSetLayoutCreateInfo.flags};
 }
 
 // **********DescriptorSetLayout**********
-DescriptorSetLayout::DescriptorSetLayout(std::shared_ptr<Device> device, vk::DescriptorSetLayout descriptorSetLayout, const DescriptorBindingDescriptions& descriptorBindingDescriptions) 
-  : m_device(device), m_descriptorSetLayout(descriptorSetLayout), m_descriptorBindingDescriptions(descriptorBindingDescriptions) {
+DescriptorSetLayout::DescriptorSetLayout(std::shared_ptr<Device> device, vk::DescriptorSetLayout descriptorSetLayout, const DescriptorBindingDescriptions& descriptorBindingDescriptions, vk::DescriptorSetLayoutCreateFlags flags) 
+  : m_device(device), m_descriptorSetLayout(descriptorSetLayout), m_descriptorBindingDescriptions(descriptorBindingDescriptions), m_flags(flags), m_dynamicOffsetCount(0), m_descriptorBufferSize(0) {
+    for (auto& [binding, descriptorSetLayoutBinding] : m_descriptorBindingDescriptions) {
+        if (isDynamicDescriptorType(descriptorSetLayoutBinding.descriptorType)) {
+            m_dynamicOffsetCount += descriptorSetLayoutBinding.descriptorCount;
+        }
+    }
+    // push descriptors never live in a descriptor buffer
+    if (m_device->getDescriptorBackend() == Device::DescriptorBackend::eDescriptorBuffer && !isPushDescriptor()) {
+        auto& dispatchLoaderDynamic = m_device->getDispatchLoaderDynamic();
+        vk::DeviceSize alignment = m_device->getDescriptorBufferProperties().descriptorBufferOffsetAlignment;
+        vk::DeviceSize size = m_device->get().getDescriptorSetLayoutSizeEXT(m_descriptorSetLayout, dispatchLoaderDynamic);
+        m_descriptorBufferSize = (size + alignment - 1) & ~(alignment - 1);
+        for (auto& [binding, descriptorSetLayoutBinding] : m_descriptorBindingDescriptions) {
+            m_descriptorBufferBindingOffsets[binding] = m_device->get().getDescriptorSetLayoutBindingOffsetEXT(m_descriptorSetLayout, binding, dispatchLoaderDynamic);
+        }
+    }
     INFO("Created Descriptor Set Layout!");
 }
 
 DescriptorSetLayout::DescriptorSetLayout(DescriptorSetLayout&& descriptorSetLayout) 
-  : m_device(descriptorSetLayout.m_device), m_descriptorSetLayout(descriptorSetLayout.m_descriptorSetLayout), m_descriptorBindingDescriptions(descriptorSetLayout.m_descriptorBindingDescriptions) {
+  : m_device(descriptorSetLayout.m_device), m_descriptorSetLayout(descriptorSetLayout.m_descriptorSetLayout), m_descriptorBindingDescriptions(std::move(descriptorSetLayout.m_descriptorBindingDescriptions)), m_flags(descriptorSetLayout.m_flags),
+    m_dynamicOffsetCount(descriptorSetLayout.m_dynamicOffsetCount), m_descriptorBufferSize(descriptorSetLayout.m_descriptorBufferSize), m_descriptorBufferBindingOffsets(std::move(descriptorSetLayout.m_descriptorBufferBindingOffsets)) {
     descriptorSetLayout.m_device = nullptr;
     descriptorSetLayout.m_descriptorSetLayout = VK_NULL_HANDLE;
     descriptorSetLayout.m_descriptorBindingDescriptions.clear();
+    descriptorSetLayout.m_descriptorBufferBindingOffsets.clear();
 }
 
 DescriptorSetLayout::~DescriptorSetLayout() {
@@ -57,37 +129,347 @@ DescriptorSetLayout::~DescriptorSetLayout() {
 DescriptorSetLayout& DescriptorSetLayout::operator=(DescriptorSetLayout&& descriptorSetLayout) {
     m_device = descriptorSetLayout.m_device;
     m_descriptorSetLayout = descriptorSetLayout.m_descriptorSetLayout;
-    m_descriptorBindingDescriptions = descriptorSetLayout.m_descriptorBindingDescriptions;
+    m_descriptorBindingDescriptions = std::move(descriptorSetLayout.m_descriptorBindingDescriptions);
+    m_flags = descriptorSetLayout.m_flags;
+    m_dynamicOffsetCount = descriptorSetLayout.m_dynamicOffsetCount;
+    m_descriptorBufferSize = descriptorSetLayout.m_descriptorBufferSize;
+    m_descriptorBufferBindingOffsets = std::move(descriptorSetLayout.m_descriptorBufferBindingOffsets);
     descriptorSetLayout.m_device = nullptr;
     descriptorSetLayout.m_descriptorSetLayout = VK_NULL_HANDLE;
     descriptorSetLayout.m_descriptorBindingDescriptions.clear();
+    descriptorSetLayout.m_descriptorBufferBindingOffsets.clear();
     return *this;
 }
 
+// **********DescriptorSetLayoutCache**********
+DescriptorSetLayoutCache::DescriptorSetLayoutCache(std::shared_ptr<Device> device) : m_device(device) {}
+
+static bool isSameDescriptorSetLayoutBinding(const vk::DescriptorSetLayoutBinding& a, const vk::DescriptorSetLayoutBinding& b) {
+    return a.binding == b.binding && a.descriptorType == b.descriptorType && a.descriptorCount == b.descriptorCount && a.stageFlags == b.stageFlags;
+}
+
+const DescriptorSetLayout& DescriptorSetLayoutCache::get(const DescriptorSetLayout::Builder& builder) {
+    core::Hasher hasher;
+    hasher.add(static_cast<uint32_t>(builder.m_descriptorSetLayoutCreateInfo.flags));
+    for (auto& [binding, descriptorSetLayoutBinding] : builder.m_descriptorBindingDescriptions) {
+        hasher.add(binding)
+              .add(static_cast<uint32_t>(descriptorSetLayoutBinding.descriptorType))
+              .add(descriptorSetLayoutBinding.descriptorCount)
+              .add(static_cast<uint32_t>(descriptorSetLayoutBinding.stageFlags));
+    }
+    const uint64_t key = hasher.get();
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    auto& descriptorSetLayouts = m_descriptorSetLayouts[key];
+    for (auto& descriptorSetLayout : descriptorSetLayouts) {
+        // the flags are what the builder asked for, the descriptor buffer flag is only added on build
+        const auto& descriptorBindingDescriptions = descriptorSetLayout->getDescriptorBindingDescriptions();
+        bool same = descriptorBindingDescriptions.size() == builder.m_descriptorBindingDescriptions.size() && 
+                    std::equal(descriptorBindingDescriptions.begin(), descriptorBindingDescriptions.end(), builder.m_descriptorBindingDescriptions.begin(), 
+                        [](auto& a, auto& b) { return a.first == b.first && isSameDescriptorSetLayoutBinding(a.second, b.second); });
+        if (same && descriptorSetLayout->isPushDescriptor() == bool(builder.m_descriptorSetLayoutCreateInfo.flags & vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptorKHR)) {
+            return *descriptorSetLayout;
+        }
+    }
+    DescriptorSetLayout::Builder copy = builder;
+    descriptorSetLayouts.push_back(std::make_unique<DescriptorSetLayout>(copy.build(m_device)));
+    return *descriptorSetLayouts.back();
+}
+
+size_t DescriptorSetLayoutCache::size() const {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    size_t size = 0;
+    for (auto& [key, descriptorSetLayouts] : m_descriptorSetLayouts) {
+        size += descriptorSetLayouts.size();
+    }
+    return size;
+}
+
 // **********DescriptorSet**********
 DescriptorSet::DescriptorSet(std::shared_ptr<Device> device, vk::DescriptorSet descriptorSet, const DescriptorSetLayout& descriptorSetLayout) 
-  : m_device(device), m_descriptorSet(descriptorSet), m_descriptorSetLayout(descriptorSetLayout) {
+  : m_device(device), m_descriptorSet(descriptorSet), m_descriptorSetLayout(descriptorSetLayout), m_descriptorBufferMapped(nullptr), m_descriptorBufferAddress(0), m_descriptorBufferOffset(0) {
+
+}
 
+DescriptorSet::DescriptorSet(std::shared_ptr<Device> device, const DescriptorSetLayout& descriptorSetLayout, std::byte *descriptorBufferMapped, vk::DeviceAddress descriptorBufferAddress, vk::DeviceSize descriptorBufferOffset)
+  : m_device(device), m_descriptorSet(VK_NULL_HANDLE), m_descriptorSetLayout(descriptorSetLayout), m_descriptorBufferMapped(descriptorBufferMapped), m_descriptorBufferAddress(descriptorBufferAddress), m_descriptorBufferOffset(descriptorBufferOffset) {
+
+}
+
+// returns the descriptor type of the binding the write targets
+static vk::DescriptorType validateWrite(const DescriptorSetLayout& descriptorSetLayout, const DescriptorSet::Update::Write& write) {
+    auto& descriptorBindingDescriptions = descriptorSetLayout.getDescriptorBindingDescriptions();
+    auto descriptorBindingDescription = descriptorBindingDescriptions.find(write.binding);
+    if (descriptorBindingDescription == descriptorBindingDescriptions.end()) {
+        throw std::runtime_error("Descriptor write to binding " + std::to_string(write.binding) + " which is not in the layout!");
+    }
+    vk::DescriptorType descriptorType = descriptorBindingDescription->second.descriptorType;
+    if (descriptorInfoType(descriptorType) != write.infoType) {
+        throw std::runtime_error("Descriptor write to binding " + std::to_string(write.binding) + " does not match its type " + vk::to_string(descriptorType) + "!");
+    }
+    // the descriptor buffer backend writes at the element's offset into mapped memory, out of range would hit the neighbouring sets
+    if (write.arrayElement >= descriptorBindingDescription->second.descriptorCount) {
+        throw std::runtime_error("Descriptor write to element " + std::to_string(write.arrayElement) + " of binding " + std::to_string(write.binding) + " which only has " + std::to_string(descriptorBindingDescription->second.descriptorCount) + "!");
+    }
+    return descriptorType;
+}
+
+DescriptorSet::Update::Write& DescriptorSet::Update::addWrite(uint32_t binding, uint32_t arrayElement, InfoType infoType) {
+    if (m_writeCount == MAX_WRITES) {
+        throw std::runtime_error("Too many writes in a single DescriptorSet::Update!");
+    }
+    Write& write = m_writes[m_writeCount++];
+    write.binding = binding;
+    write.arrayElement = arrayElement;
+    write.infoType = infoType;
+    return write;
+}
+
+DescriptorSet::Update& DescriptorSet::Update::addBuffer(uint32_t binding, const vk::DescriptorBufferInfo& descriptorBufferInfo, uint32_t arrayElement) {
+    addWrite(binding, arrayElement, InfoType::eBuffer).descriptorBufferInfo = descriptorBufferInfo;
+    return *this;
+}
+
+DescriptorSet::Update& DescriptorSet::Update::addImage(uint32_t binding, const vk::DescriptorImageInfo& descriptorImageInfo, uint32_t arrayElement) {
+    addWrite(binding, arrayElement, InfoType::eImage).descriptorImageInfo = descriptorImageInfo;
+    return *this;
+}
+
+DescriptorSet::Update& DescriptorSet::Update::addSampler(uint32_t binding, vk::Sampler sampler, uint32_t arrayElement) {
+    addWrite(binding, arrayElement, InfoType::eImage).descriptorImageInfo = vk::DescriptorImageInfo{}.setSampler(sampler);
+    return *this;
+}
+
+DescriptorSet::Update& DescriptorSet::Update::addTexelBuffer(uint32_t binding, vk::BufferView bufferView, uint32_t arrayElement) {
+    addWrite(binding, arrayElement, InfoType::eTexelBuffer).bufferView = bufferView;
+    return *this;
 }
 
-DescriptorSet::Update& DescriptorSet::Update::addBuffer(uint32_t binding, const vk::DescriptorBufferInfo& descriptorBufferInfo) {
+vk::WriteDescriptorSet DescriptorSet::Update::Write::resolve(const DescriptorSetLayout& descriptorSetLayout, vk::DescriptorSet descriptorSet) const {
     vk::WriteDescriptorSet writeDescriptorSet = vk::WriteDescriptorSet{}
-        .setPBufferInfo(&descriptorBufferInfo)
+        .setDstSet(descriptorSet)
+        .setDstBinding(binding)
+        .setDstArrayElement(arrayElement)
         .setDescriptorCount(1)
-        .setDescriptorType(vk::DescriptorType::eUniformBuffer)
-        .setDstArrayElement(0)
-        .setDstBinding(binding);
-        // .setDstSet();
-    m_writeDescriptorSets.push_back(writeDescriptorSet);
+        .setDescriptorType(validateWrite(descriptorSetLayout, *this));
+    switch (infoType) {
+        case InfoType::eBuffer:
+            writeDescriptorSet.setPBufferInfo(&descriptorBufferInfo);
+            break;
+        case InfoType::eImage:
+            writeDescriptorSet.setPImageInfo(&descriptorImageInfo);
+            break;
+        case InfoType::eTexelBuffer:
+            writeDescriptorSet.setPTexelBufferView(&bufferView);
+            break;
+    }
+    return writeDescriptorSet;
+}
+
+void DescriptorSet::update(const Update& update) {
+    if (isDescriptorBufferBacked()) {
+        writeDescriptors(update);
+        return;
+    }
+    std::array<vk::WriteDescriptorSet, Update::MAX_WRITES> writeDescriptorSets;
+    for (uint32_t i = 0; i < update.m_writeCount; i++) {
+        writeDescriptorSets[i] = update.m_writes[i].resolve(m_descriptorSetLayout, m_descriptorSet);
+    }
+    m_device->get().updateDescriptorSets(update.m_writeCount, writeDescriptorSets.data(), 0, nullptr);
+}
+
+void DescriptorSet::writeDescriptors(const Update& update) const {
+    // validated up front, the writes go straight to memory and a throw halfway would leave the set half updated
+    for (uint32_t i = 0; i < update.m_writeCount; i++) {
+        validateWrite(m_descriptorSetLayout, update.m_writes[i]);
+    }
+    for (uint32_t i = 0; i < update.m_writeCount; i++) {
+        writeDescriptor(update.m_writes[i]);
+    }
+}
+
+void DescriptorSet::writeDescriptor(const Update::Write& write) const {
+    vk::DescriptorType descriptorType = validateWrite(m_descriptorSetLayout, write);
+    size_t descriptorSize = m_device->getDescriptorBufferDescriptorSize(descriptorType);
+
+    vk::DescriptorAddressInfoEXT descriptorAddressInfo{};
+    if (write.infoType == Update::InfoType::eBuffer) {
+        descriptorAddressInfo.setAddress(m_device->get().getBufferAddress(vk::BufferDeviceAddressInfo{}.setBuffer(write.descriptorBufferInfo.buffer)) + write.descriptorBufferInfo.offset)
+                             .setRange(write.descriptorBufferInfo.range);
+    }
+
+    vk::DescriptorDataEXT descriptorData{};
+    switch (descriptorType) {
+        case vk::DescriptorType::eSampler:              descriptorData.setPSampler(&write.descriptorImageInfo.sampler); break;
+        case vk::DescriptorType::eCombinedImageSampler: descriptorData.setPCombinedImageSampler(&write.descriptorImageInfo); break;
+        case vk::DescriptorType::eSampledImage:         descriptorData.setPSampledImage(&write.descriptorImageInfo); break;
+        case vk::DescriptorType::eStorageImage:         descriptorData.setPStorageImage(&write.descriptorImageInfo); break;
+        case vk::DescriptorType::eInputAttachment:      descriptorData.setPInputAttachmentImage(&write.descriptorImageInfo); break;
+        case vk::DescriptorType::eUniformBuffer:        descriptorData.setPUniformBuffer(&descriptorAddressInfo); break;
+        case vk::DescriptorType::eStorageBuffer:        descriptorData.setPStorageBuffer(&descriptorAddressInfo); break;
+        default:
+            // texel buffers would need the address and format the view was created with, which a vk::BufferView does not expose
+            throw std::runtime_error("Descriptor type " + vk::to_string(descriptorType) + " is not supported by the descriptor buffer backend!");
+    }
+
+    vk::DescriptorGetInfoEXT descriptorGetInfo = vk::DescriptorGetInfoEXT{}
+        .setType(descriptorType)
+        .setData(descriptorData);
+    std::byte *descriptor = m_descriptorBufferMapped + m_descriptorSetLayout.getDescriptorBufferBindingOffset(write.binding) + write.arrayElement * descriptorSize;
+    m_device->get().getDescriptorEXT(&descriptorGetInfo, descriptorSize, descriptor, m_device->getDispatchLoaderDynamic());
+}
+
+// **********DescriptorSet::Batch**********
+DescriptorSet::Batch::Batch(std::shared_ptr<Device> device) : m_device(device) {}
+
+DescriptorSet::Batch::~Batch() {
+    flush();
+}
+
+DescriptorSet::Batch& DescriptorSet::Batch::add(const DescriptorSet& descriptorSet, const Update& update) {
+    // nothing to batch, the writes are plain memory writes
+    if (descriptorSet.isDescriptorBufferBacked()) {
+        descriptorSet.writeDescriptors(update);
+        return *this;
+    }
+    if (m_writeCount + update.m_writeCount > MAX_WRITES) {
+        flush();
+    }
+    // resolved into the free slots first, the update only counts once all of its writes are valid,
+    // so a throwing write never leaves part of the update queued for the next flush
+    uint32_t writeCount = m_writeCount;
+    for (uint32_t i = 0; i < update.m_writeCount; i++) {
+        m_writes[writeCount] = update.m_writes[i];
+        m_writeDescriptorSets[writeCount] = m_writes[writeCount].resolve(descriptorSet.m_descriptorSetLayout, descriptorSet.m_descriptorSet);
+        writeCount++;
+    }
+    m_writeCount = writeCount;
+    return *this;
+}
+
+void DescriptorSet::Batch::flush() {
+    if (m_writeCount == 0) return;
+    m_device->get().updateDescriptorSets(m_writeCount, m_writeDescriptorSets.data(), 0, nullptr);
+    m_writeCount = 0;
+}
+
+// **********DescriptorUpdateTemplate::Builder**********
+DescriptorUpdateTemplate::Builder& DescriptorUpdateTemplate::Builder::setDescriptorSetLayout(const DescriptorSetLayout& descriptorSetLayout) {
+    m_descriptorSetLayout = &descriptorSetLayout;
     return *this;
 }
 
-void DescriptorSet::update(Update update) {
-    for (auto& writeDescriptorSet : update.m_writeDescriptorSets) {
-        assert(m_descriptorSetLayout.getDescriptorBindingDescriptions().contains(writeDescriptorSet.dstBinding));
-        writeDescriptorSet.setDstSet(m_descriptorSet);
+DescriptorUpdateTemplate::Builder& DescriptorUpdateTemplate::Builder::addEntry(uint32_t binding, size_t offset, uint32_t arrayElement, uint32_t count, size_t stride) {
+    m_descriptorUpdateTemplateEntries.push_back(vk::DescriptorUpdateTemplateEntry{}
+        .setDstBinding(binding)
+        .setDstArrayElement(arrayElement)
+        .setDescriptorCount(count)
+        .setOffset(offset)
+        .setStride(stride));
+    return *this;
+}
+
+static size_t descriptorInfoSize(vk::DescriptorType descriptorType) {
+    switch (descriptorInfoType(descriptorType)) {
+        case DescriptorSet::Update::InfoType::eImage:
+            return sizeof(vk::DescriptorImageInfo);
+        case DescriptorSet::Update::InfoType::eTexelBuffer:
+            return sizeof(vk::BufferView);
+        default:
+            return sizeof(vk::DescriptorBufferInfo);
+    }
+}
+
+DescriptorUpdateTemplate DescriptorUpdateTemplate::Builder::build(std::shared_ptr<Device> device) {
+    assert(m_descriptorSetLayout && "Didnt call .setDescriptorSetLayout(DescriptorSetLayout)");
+    auto& descriptorBindingDescriptions = m_descriptorSetLayout->getDescriptorBindingDescriptions();
+    for (auto& descriptorUpdateTemplateEntry : m_descriptorUpdateTemplateEntries) {
+        auto binding = descriptorBindingDescriptions.find(descriptorUpdateTemplateEntry.dstBinding);
+        if (binding == descriptorBindingDescriptions.end()) {
+            throw std::runtime_error("Descriptor Update Template entry refers to a binding not in the layout!");
+        }
+        descriptorUpdateTemplateEntry.setDescriptorType(binding->second.descriptorType);
+        if (descriptorUpdateTemplateEntry.stride == 0) {
+            descriptorUpdateTemplateEntry.setStride(descriptorInfoSize(binding->second.descriptorType));
+        }
+    }
+    if (device->getDescriptorBackend() == Device::DescriptorBackend::eDescriptorBuffer) {
+        return {device, VK_NULL_HANDLE, m_descriptorSetLayout->get(), m_descriptorUpdateTemplateEntries};
+    }
+    vk::DescriptorUpdateTemplateCreateInfo descriptorUpdateTemplateCreateInfo = vk::DescriptorUpdateTemplateCreateInfo{}
+        .setDescriptorUpdateEntryCount(m_descriptorUpdateTemplateEntries.size())
+        .setPDescriptorUpdateEntries(m_descriptorUpdateTemplateEntries.data())
+        .setTemplateType(vk::DescriptorUpdateTemplateType::eDescriptorSet)
+        .setDescriptorSetLayout(m_descriptorSetLayout->get());
+    vk::DescriptorUpdateTemplate descriptorUpdateTemplate;
+    auto res = device->get().createDescriptorUpdateTemplate(&descriptorUpdateTemplateCreateInfo, nullptr, &descriptorUpdateTemplate);
+    if (res != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create Descriptor Update Template!");
+    }
+    return {device, descriptorUpdateTemplate, m_descriptorSetLayout->get(), {}};
+}
+
+// **********DescriptorUpdateTemplate**********
+DescriptorUpdateTemplate::DescriptorUpdateTemplate(std::shared_ptr<Device> device, vk::DescriptorUpdateTemplate descriptorUpdateTemplate, vk::DescriptorSetLayout descriptorSetLayout, const std::vector<vk::DescriptorUpdateTemplateEntry>& descriptorUpdateTemplateEntries)
+  : m_device(device), m_descriptorUpdateTemplate(descriptorUpdateTemplate), m_descriptorSetLayout(descriptorSetLayout), m_descriptorUpdateTemplateEntries(descriptorUpdateTemplateEntries) {
+    INFO("Created Descriptor Update Template!");
+}
+
+DescriptorUpdateTemplate::DescriptorUpdateTemplate(DescriptorUpdateTemplate&& descriptorUpdateTemplate)
+  : m_device(descriptorUpdateTemplate.m_device), m_descriptorUpdateTemplate(descriptorUpdateTemplate.m_descriptorUpdateTemplate), m_descriptorSetLayout(descriptorUpdateTemplate.m_descriptorSetLayout), 
+    m_descriptorUpdateTemplateEntries(std::move(descriptorUpdateTemplate.m_descriptorUpdateTemplateEntries)) {
+    descriptorUpdateTemplate.m_device = nullptr;
+    descriptorUpdateTemplate.m_descriptorUpdateTemplate = VK_NULL_HANDLE;
+    descriptorUpdateTemplate.m_descriptorSetLayout = VK_NULL_HANDLE;
+}
+
+DescriptorUpdateTemplate::~DescriptorUpdateTemplate() {
+    if (m_descriptorUpdateTemplate) m_device->get().destroyDescriptorUpdateTemplate(m_descriptorUpdateTemplate);
+    m_device = nullptr;
+    m_descriptorUpdateTemplate = VK_NULL_HANDLE;
+    m_descriptorSetLayout = VK_NULL_HANDLE;
+}
+
+DescriptorUpdateTemplate& DescriptorUpdateTemplate::operator=(DescriptorUpdateTemplate&& descriptorUpdateTemplate) {
+    if (m_descriptorUpdateTemplate) m_device->get().destroyDescriptorUpdateTemplate(m_descriptorUpdateTemplate);
+    m_device = descriptorUpdateTemplate.m_device;
+    m_descriptorUpdateTemplate = descriptorUpdateTemplate.m_descriptorUpdateTemplate;
+    m_descriptorSetLayout = descriptorUpdateTemplate.m_descriptorSetLayout;
+    m_descriptorUpdateTemplateEntries = std::move(descriptorUpdateTemplate.m_descriptorUpdateTemplateEntries);
+    descriptorUpdateTemplate.m_device = nullptr;
+    descriptorUpdateTemplate.m_descriptorUpdateTemplate = VK_NULL_HANDLE;
+    descriptorUpdateTemplate.m_descriptorSetLayout = VK_NULL_HANDLE;
+    return *this;
+}
+
+void DescriptorUpdateTemplate::updateData(const DescriptorSet& descriptorSet, const void *data) const {
+    assert(descriptorSet.m_descriptorSetLayout.get() == m_descriptorSetLayout && "Descriptor Set was not allocated with the template's layout!");
+    if (!descriptorSet.isDescriptorBufferBacked()) {
+        m_device->get().updateDescriptorSetWithTemplate(descriptorSet.m_descriptorSet, m_descriptorUpdateTemplate, data);
+        return;
+    }
+    const std::byte *bytes = static_cast<const std::byte *>(data);
+    for (auto& descriptorUpdateTemplateEntry : m_descriptorUpdateTemplateEntries) {
+        for (uint32_t i = 0; i < descriptorUpdateTemplateEntry.descriptorCount; i++) {
+            const std::byte *info = bytes + descriptorUpdateTemplateEntry.offset + i * descriptorUpdateTemplateEntry.stride;
+            DescriptorSet::Update::Write write{};
+            write.binding = descriptorUpdateTemplateEntry.dstBinding;
+            write.arrayElement = descriptorUpdateTemplateEntry.dstArrayElement + i;
+            write.infoType = descriptorInfoType(descriptorUpdateTemplateEntry.descriptorType);
+            switch (write.infoType) {
+                case DescriptorSet::Update::InfoType::eBuffer:
+                    std::memcpy(&write.descriptorBufferInfo, info, sizeof(vk::DescriptorBufferInfo));
+                    break;
+                case DescriptorSet::Update::InfoType::eImage:
+                    std::memcpy(&write.descriptorImageInfo, info, sizeof(vk::DescriptorImageInfo));
+                    break;
+                case DescriptorSet::Update::InfoType::eTexelBuffer:
+                    std::memcpy(&write.bufferView, info, sizeof(vk::BufferView));
+                    break;
+            }
+            descriptorSet.writeDescriptor(write);
+        }
     }
-    m_device->get().updateDescriptorSets(update.m_writeDescriptorSets.size(), update.m_writeDescriptorSets.data(), 0, nullptr);
 }
 
 // **********DescriptorPool::Builder**********
@@ -107,6 +489,21 @@ DescriptorPool::Builder& DescriptorPool::Builder::setMaxSets(uint32_t maxSets) {
 }
 
 DescriptorPool DescriptorPool::Builder::build(std::shared_ptr<Device> device) {
+    if (device->getDescriptorBackend() == Device::DescriptorBackend::eDescriptorBuffer) {
+        vk::DeviceSize size = 0;
+        for (auto& descriptorPoolSize : m_descriptorPoolSizes) {
+            size += descriptorPoolSize.descriptorCount * device->getDescriptorBufferDescriptorSize(descriptorPoolSize.type);
+        }
+        // room for padding every set up to the offset alignment
+        size += m_descriptorPoolCreateInfo.maxSets * device->getDescriptorBufferProperties().descriptorBufferOffsetAlignment;
+        Buffer descriptorBuffer = Buffer::Builder{}
+            .setSize(size)
+            .setUsage(getDescriptorBufferUsage())
+            .setSharingMode(vk::SharingMode::eExclusive)
+            .setMemoryProperty(vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent)
+            .build(device);
+        return {device, std::move(descriptorBuffer)};
+    }
     m_descriptorPoolCreateInfo.setPoolSizeCount(m_descriptorPoolSizes.size())
                               .setPPoolSizes(m_descriptorPoolSizes.data());
     vk::DescriptorPool descriptorPool;
@@ -119,14 +516,24 @@ DescriptorPool DescriptorPool::Builder::build(std::shared_ptr<Device> device) {
 
 // **********DescriptorPool**********
 DescriptorPool::DescriptorPool(std::shared_ptr<Device> device, vk::DescriptorPool descriptorPool)
-  : m_device(device), m_descriptorPool(descriptorPool) {
+  : m_device(device), m_descriptorPool(descriptorPool), m_descriptorBufferAddress(0), m_descriptorBufferHead(0) {
     INFO("Created Descriptor Pool!");
 }
 
+DescriptorPool::DescriptorPool(std::shared_ptr<Device> device, Buffer&& descriptorBuffer)
+  : m_device(device), m_descriptorPool(VK_NULL_HANDLE), m_descriptorBuffer(std::move(descriptorBuffer)), m_descriptorBufferHead(0) {
+    m_descriptorBuffer.map();
+    m_descriptorBufferAddress = m_descriptorBuffer.getDeviceAddress();
+    INFO("Created Descriptor Pool! (Descriptor Buffer)");
+}
+
 DescriptorPool::DescriptorPool(DescriptorPool&& descriptorPool) 
-  : m_device(descriptorPool.m_device), m_descriptorPool(descriptorPool.m_descriptorPool) {
+  : m_device(descriptorPool.m_device), m_descriptorPool(descriptorPool.m_descriptorPool), m_descriptorBuffer(std::move(descriptorPool.m_descriptorBuffer)), 
+    m_descriptorBufferAddress(descriptorPool.m_descriptorBufferAddress), m_descriptorBufferHead(descriptorPool.m_descriptorBufferHead) {
     descriptorPool.m_device = nullptr;
     descriptorPool.m_descriptorPool = VK_NULL_HANDLE;
+    descriptorPool.m_descriptorBufferAddress = 0;
+    descriptorPool.m_descriptorBufferHead = 0;
 }
 
 DescriptorPool::~DescriptorPool() {
@@ -138,17 +545,42 @@ DescriptorPool::~DescriptorPool() {
 DescriptorPool& DescriptorPool::operator=(DescriptorPool&& descriptorPool) {
     m_device = descriptorPool.m_device;
     m_descriptorPool = descriptorPool.m_descriptorPool;
+    m_descriptorBuffer = std::move(descriptorPool.m_descriptorBuffer);
+    m_descriptorBufferAddress = descriptorPool.m_descriptorBufferAddress;
+    m_descriptorBufferHead = descriptorPool.m_descriptorBufferHead;
     descriptorPool.m_device = nullptr;
     descriptorPool.m_descriptorPool = VK_NULL_HANDLE;
+    descriptorPool.m_descriptorBufferAddress = 0;
+    descriptorPool.m_descriptorBufferHead = 0;
     return *this;
 }
 
+vk::BufferUsageFlags DescriptorPool::getDescriptorBufferUsage() {
+    return vk::BufferUsageFlagBits::eResourceDescriptorBufferEXT | vk::BufferUsageFlagBits::eSamplerDescriptorBufferEXT | vk::BufferUsageFlagBits::eShaderDeviceAddress;
+}
+
 DescriptorPool::SetAllocateInfo& DescriptorPool::SetAllocateInfo::addLayout(const DescriptorSetLayout& descriptorSetLayout) {
     m_descriptorSetLayoutPtrs.push_back(&descriptorSetLayout);
     return *this;
 }
 
 std::vector<DescriptorSet> DescriptorPool::allocate(const SetAllocateInfo& setAllocateInfo) {
+    for (auto descriptorSetLayoutPtr : setAllocateInfo.m_descriptorSetLayoutPtrs) {
+        assert(!descriptorSetLayoutPtr->isPushDescriptor() && "Push descriptor layouts cannot be allocated from a pool!");
+    }
+    if (m_descriptorBuffer.get()) {
+        std::vector<DescriptorSet> descriptorSets;
+        descriptorSets.reserve(setAllocateInfo.m_descriptorSetLayoutPtrs.size());
+        for (auto descriptorSetLayoutPtr : setAllocateInfo.m_descriptorSetLayoutPtrs) {
+            vk::DeviceSize size = descriptorSetLayoutPtr->getDescriptorBufferSize();
+            if (m_descriptorBufferHead + size > m_descriptorBuffer.getSize()) {
+                throw std::runtime_error("Failed to Allocate Descriptor Sets! Descriptor Buffer is full");
+            }
+            descriptorSets.emplace_back(m_device, *descriptorSetLayoutPtr, static_cast<std::byte *>(m_descriptorBuffer.getMapped()) + m_descriptorBufferHead, m_descriptorBufferAddress, m_descriptorBufferHead);
+            m_descriptorBufferHead += size;
+        }
+        return descriptorSets;
+    }
     std::vector<vk::DescriptorSetLayout> descriptorSetLayouts;
     descriptorSetLayouts.reserve(setAllocateInfo.m_descriptorSetLayoutPtrs.size());
     for (auto descriptorSetLayoutPtr : setAllocateInfo.m_descriptorSetLayoutPtrs) {
@@ -2,8 +2,14 @@
 #define GFX_DESCRIPTORS_HPP
 
 #include "device.hpp"
+#include "buffer.hpp"
 
 #include <map>
+#include <array>
+#include <type_traits>
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
 
 namespace gfx {
 
@@ -14,6 +20,8 @@ public:
     struct Builder {
         Builder& addBinding(uint32_t binding, vk::DescriptorType descriptorType, vk::ShaderStageFlags shaderStageFlags, uint32_t count);
         Builder& setFlags(vk::DescriptorSetLayoutCreateFlags flags);
+        // sets of this layout are never allocated, their descriptors are recorded with CommandBuffer::pushDescriptorSet
+        Builder& setPushDescriptor(bool enable);
 
         DescriptorSetLayout build(std::shared_ptr<Device> device);
 
@@ -22,7 +30,7 @@ public:
 
     };
 
-    DescriptorSetLayout() : m_device(nullptr), m_descriptorSetLayout(VK_NULL_HANDLE) {}
+    DescriptorSetLayout() : m_device(nullptr), m_descriptorSetLayout(VK_NULL_HANDLE), m_dynamicOffsetCount(0), m_descriptorBufferSize(0) {}
 
     ~DescriptorSetLayout();
 
@@ -33,45 +41,194 @@ public:
 
     vk::DescriptorSetLayout get() const { return m_descriptorSetLayout; }
     const DescriptorBindingDescriptions& getDescriptorBindingDescriptions() const { return m_descriptorBindingDescriptions; }
+    // number of offsets that have to be passed when binding a set of this layout (eUniformBufferDynamic / eStorageBufferDynamic descriptors)
+    uint32_t getDynamicOffsetCount() const { return m_dynamicOffsetCount; }
+    bool isPushDescriptor() const { return bool(m_flags & vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptorKHR); }
+    vk::DescriptorSetLayoutCreateFlags getFlags() const { return m_flags; }
+
+    // descriptor buffer backend only, size of one set (aligned for use as a set offset) and where each binding starts in it
+    vk::DeviceSize getDescriptorBufferSize() const { return m_descriptorBufferSize; }
+    vk::DeviceSize getDescriptorBufferBindingOffset(uint32_t binding) const { return m_descriptorBufferBindingOffsets.at(binding); }
 
 private:
-    DescriptorSetLayout(std::shared_ptr<Device> device, vk::DescriptorSetLayout descriptorSetLayout, const DescriptorBindingDescriptions& descriptorBindingDescriptions);
+    DescriptorSetLayout(std::shared_ptr<Device> device, vk::DescriptorSetLayout descriptorSetLayout, const DescriptorBindingDescriptions& descriptorBindingDescriptions, vk::DescriptorSetLayoutCreateFlags flags);
+
+    friend class CommandBuffer;
 
 private:
     std::shared_ptr<Device>      m_device;
     vk::DescriptorSetLayout      m_descriptorSetLayout;
     DescriptorBindingDescriptions m_descriptorBindingDescriptions;
+    vk::DescriptorSetLayoutCreateFlags m_flags;
+    uint32_t                     m_dynamicOffsetCount;
+    vk::DeviceSize               m_descriptorBufferSize;
+    std::map<uint32_t, vk::DeviceSize> m_descriptorBufferBindingOffsets;
+};
+
+// hands out one shared layout per distinct set of bindings, so pipelines built from reflection
+// (or anything else describing the same set) end up with compatible, deduplicated layouts
+class DescriptorSetLayoutCache {
+public:
+    DescriptorSetLayoutCache(std::shared_ptr<Device> device);
+
+    DescriptorSetLayoutCache(const DescriptorSetLayoutCache&) = delete;
+    DescriptorSetLayoutCache& operator=(const DescriptorSetLayoutCache&) = delete;
+
+    // builds the layout the first time these bindings and flags are seen, thread safe
+    // the reference stays valid for the lifetime of the cache
+    const DescriptorSetLayout& get(const DescriptorSetLayout::Builder& builder);
+
+    size_t size() const;
+
+private:
+    std::shared_ptr<Device> m_device;
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint64_t, std::vector<std::unique_ptr<DescriptorSetLayout>>> m_descriptorSetLayouts;
 };
 
 class DescriptorSet {
 public:
     DescriptorSet() = delete;
 
+    // VK_NULL_HANDLE with the descriptor buffer backend
     const vk::DescriptorSet& get() const { return m_descriptorSet; }
+    const DescriptorSetLayout& getDescriptorSetLayout() const { return m_descriptorSetLayout; }
 
+    // the descriptor type of every write is taken from the layout binding it targets,
+    // infos are copied into inline storage so temporaries can be passed and nothing is heap allocated
     struct Update {
-        
-        Update& addBuffer(uint32_t binding, const vk::DescriptorBufferInfo& descriptorBufferInfo);
+        static constexpr uint32_t MAX_WRITES = 16;
+
+        // uniform / storage buffers, dynamic or not
+        Update& addBuffer(uint32_t binding, const vk::DescriptorBufferInfo& descriptorBufferInfo, uint32_t arrayElement = 0);
+        // sampled / storage images, combined image samplers and input attachments
+        Update& addImage(uint32_t binding, const vk::DescriptorImageInfo& descriptorImageInfo, uint32_t arrayElement = 0);
+        Update& addSampler(uint32_t binding, vk::Sampler sampler, uint32_t arrayElement = 0);
+        // uniform / storage texel buffers
+        Update& addTexelBuffer(uint32_t binding, vk::BufferView bufferView, uint32_t arrayElement = 0);
+
+        enum class InfoType : uint8_t {
+            eBuffer,
+            eImage,
+            eTexelBuffer,
+        };
+
+        struct Write {
+            // validates against the layout binding, the returned write points into this Write
+            vk::WriteDescriptorSet resolve(const DescriptorSetLayout& descriptorSetLayout, vk::DescriptorSet descriptorSet) const;
+
+            uint32_t binding;
+            uint32_t arrayElement;
+            InfoType infoType;
+            vk::DescriptorBufferInfo descriptorBufferInfo;
+            vk::DescriptorImageInfo descriptorImageInfo;
+            vk::BufferView bufferView;
+        };
+
+        std::array<Write, MAX_WRITES> m_writes;
+        uint32_t m_writeCount = 0;
+
+    private:
+        Write& addWrite(uint32_t binding, uint32_t arrayElement, InfoType infoType);
+    }; 
 
-        std::vector<vk::WriteDescriptorSet> m_writeDescriptorSets; 
+    void update(const Update& update);
 
-    }; 
+    // collects the writes of many sets and submits them with a single updateDescriptorSets call,
+    // flushes on its own when full and on destruction
+    struct Batch {
+        static constexpr uint32_t MAX_WRITES = 128;
+
+        Batch(std::shared_ptr<Device> device);
+        ~Batch();
+
+        // writes point into the batch itself
+        Batch(const Batch&) = delete;
+        Batch& operator=(const Batch&) = delete;
 
-    void update(Update update);
+        Batch& add(const DescriptorSet& descriptorSet, const Update& update);
+        void flush();
+
+        std::shared_ptr<Device> m_device;
+        std::array<Update::Write, MAX_WRITES> m_writes;
+        std::array<vk::WriteDescriptorSet, MAX_WRITES> m_writeDescriptorSets;
+        uint32_t m_writeCount = 0;
+    };
+
+    bool isDescriptorBufferBacked() const { return m_descriptorBufferMapped != nullptr; }
 
 private:
     friend class DescriptorPool;
+    friend class DescriptorUpdateTemplate;
+    friend class CommandBuffer;
     friend class std::vector<DescriptorSet>;
 
+    // descriptor buffer backend, writes the descriptor straight into the set's slice of the pool buffer
+    void writeDescriptor(const Update::Write& write) const;
+    // all writes of the update or none of them
+    void writeDescriptors(const Update& update) const;
+
 public: // todo remove this
     DescriptorSet(std::shared_ptr<Device> device, vk::DescriptorSet descriptorSet, const DescriptorSetLayout& descriptorSetLayout);
+    DescriptorSet(std::shared_ptr<Device> device, const DescriptorSetLayout& descriptorSetLayout, std::byte *descriptorBufferMapped, vk::DeviceAddress descriptorBufferAddress, vk::DeviceSize descriptorBufferOffset);
 
 private:
     std::shared_ptr<Device> m_device;
     vk::DescriptorSet m_descriptorSet;
     const DescriptorSetLayout& m_descriptorSetLayout;
+    // descriptor buffer backend
+    std::byte *m_descriptorBufferMapped;
+    vk::DeviceAddress m_descriptorBufferAddress;
+    vk::DeviceSize m_descriptorBufferOffset;
+};
+
+// writes every descriptor of a set from one packed POD struct with a single vkUpdateDescriptorSetWithTemplate call
+class DescriptorUpdateTemplate {
+public:
+    struct Builder {
+        Builder& setDescriptorSetLayout(const DescriptorSetLayout& descriptorSetLayout);
+        // offset is the byte offset of the first descriptor info inside the packed struct, 
+        // stride of 0 uses the size of the info matching the binding's descriptor type
+        Builder& addEntry(uint32_t binding, size_t offset, uint32_t arrayElement = 0, uint32_t count = 1, size_t stride = 0);
+
+        DescriptorUpdateTemplate build(std::shared_ptr<Device> device);
+
+        const DescriptorSetLayout *m_descriptorSetLayout = nullptr;
+        std::vector<vk::DescriptorUpdateTemplateEntry> m_descriptorUpdateTemplateEntries;
+    };
+
+    DescriptorUpdateTemplate() : m_device(nullptr), m_descriptorUpdateTemplate(VK_NULL_HANDLE), m_descriptorSetLayout(VK_NULL_HANDLE) {}
+
+    ~DescriptorUpdateTemplate();
+
+    DescriptorUpdateTemplate(DescriptorUpdateTemplate&& descriptorUpdateTemplate);
+    DescriptorUpdateTemplate(const DescriptorUpdateTemplate&) = delete;
+
+    DescriptorUpdateTemplate& operator=(DescriptorUpdateTemplate&& descriptorUpdateTemplate);
+
+    vk::DescriptorUpdateTemplate get() const { return m_descriptorUpdateTemplate; }
+
+    // T is the packed struct of vk::DescriptorBufferInfo / vk::DescriptorImageInfo / vk::BufferView laid out as described by the entries
+    template <typename T>
+    void update(const DescriptorSet& descriptorSet, const T& data) const {
+        static_assert(std::is_trivially_copyable_v<T> && !std::is_pointer_v<T>, "update expects the packed descriptor struct itself");
+        updateData(descriptorSet, &data);
+    }
+
+private:
+    DescriptorUpdateTemplate(std::shared_ptr<Device> device, vk::DescriptorUpdateTemplate descriptorUpdateTemplate, vk::DescriptorSetLayout descriptorSetLayout, const std::vector<vk::DescriptorUpdateTemplateEntry>& descriptorUpdateTemplateEntries);
+
+    void updateData(const DescriptorSet& descriptorSet, const void *data) const;
+
+private:
+    std::shared_ptr<Device>      m_device;
+    vk::DescriptorUpdateTemplate m_descriptorUpdateTemplate;
+    vk::DescriptorSetLayout      m_descriptorSetLayout;
+    // the descriptor buffer backend has no vulkan template object, the entries are walked on the cpu instead
+    std::vector<vk::DescriptorUpdateTemplateEntry> m_descriptorUpdateTemplateEntries;
 };
 
+// with the descriptor buffer backend the pool is a host visible descriptor buffer that sets are linearly sub allocated from
 class DescriptorPool {
 public:
     struct Builder {
@@ -85,7 +242,7 @@ public:
         vk::DescriptorPoolCreateInfo m_descriptorPoolCreateInfo;
     };
 
-    DescriptorPool() : m_device(nullptr), m_descriptorPool(VK_NULL_HANDLE) {}
+    DescriptorPool() : m_device(nullptr), m_descriptorPool(VK_NULL_HANDLE), m_descriptorBufferAddress(0), m_descriptorBufferHead(0) {}
 
     ~DescriptorPool();
 
@@ -105,12 +262,22 @@ public:
 
     std::vector<DescriptorSet> allocate(const SetAllocateInfo& setAllocateInfo);
 
+    // usage of the buffers backing descriptor buffer pools, also what they are bound with
+    static vk::BufferUsageFlags getDescriptorBufferUsage();
+
 private:
+    friend class CommandBuffer;
+
     DescriptorPool(std::shared_ptr<Device> device, vk::DescriptorPool descriptorPool);
+    DescriptorPool(std::shared_ptr<Device> device, Buffer&& descriptorBuffer);
 
 private:
     std::shared_ptr<Device> m_device;
     vk::DescriptorPool      m_descriptorPool;
+    // descriptor buffer backend
+    Buffer                  m_descriptorBuffer;
+    vk::DeviceAddress       m_descriptorBufferAddress;
+    vk::DeviceSize          m_descriptorBufferHead;
 };
 
 // class DescriptorSet;
@@ -5,6 +5,7 @@
 #include "syncobjects.hpp"
 #include "commandbuffer.hpp"
 #include "swapchain.hpp"
+#include "pipelinemanifest.hpp"
 
 #include <iostream>
 #include <cassert>
@@ -15,15 +16,42 @@
 
 namespace gfx {
 
-Device::Device(core::Window& window, bool enableValidation) : m_window(window), m_validations(enableValidation) {
+Device::Config::Config() : m_preferDescriptorBuffer(false), m_pipelineCachePath("pipelinecache.bin"), m_pipelineManifestPath("pipelinemanifest.bin") {}
+
+Device::Config& Device::Config::setPreferDescriptorBuffer(bool enable) {
+    m_preferDescriptorBuffer = enable;
+    return *this;
+}
+
+Device::Config& Device::Config::setPipelineCachePath(const std::filesystem::path& path) {
+    m_pipelineCachePath = path;
+    return *this;
+}
+
+Device::Config& Device::Config::setPipelineManifestPath(const std::filesystem::path& path) {
+    m_pipelineManifestPath = path;
+    return *this;
+}
+
+Device::Device(core::Window& window, bool enableValidation) : Device(window, enableValidation, Config{}) {}
+
+Device::Device(core::Window& window, bool enableValidation, const Config& config) : m_window(window), m_validations(enableValidation), m_config(config) {
     createInstance();
     setupDebugMessenger();
     createSurface();
     pickPhysicalDevice();
+    selectOptionalFeatures();
     createLogicalDevice();
+    m_pipelineCache = PipelineCache{m_device, m_physicalDeviceProperties, m_config.m_pipelineCachePath};
+    m_shaderModuleCache = std::make_unique<ShaderModuleCache>(m_device);
+    m_pipelineManifest = std::make_unique<PipelineManifest>(m_config.m_pipelineManifestPath);
 }
 
 Device::~Device() {
+    m_pipelineCache.save();
+    m_pipelineCache = PipelineCache{};
+    m_pipelineManifest->save();
+    m_shaderModuleCache.reset();
     m_device.destroy();
     m_instance.destroySurfaceKHR(m_surface);
     if (m_validations) {
@@ -246,8 +274,100 @@ void Device::pickPhysicalDevice() {
         throw std::runtime_error("Vulkan: Failed to find a suitable GPU!");
     }
 
-    auto pickedPhysicalDeviceProperties = m_physicalDevice.getProperties();
-    INFO("Picked Physical device {} of type {}", pickedPhysicalDeviceProperties.deviceName, vk::to_string(pickedPhysicalDeviceProperties.deviceType));
+    m_physicalDeviceProperties = m_physicalDevice.getProperties();
+    INFO("Picked Physical device {} of type {}", m_physicalDeviceProperties.deviceName, vk::to_string(m_physicalDeviceProperties.deviceType));
+}
+
+void Device::selectOptionalFeatures() {
+    for (auto& extension : m_physicalDevice.enumerateDeviceExtensionProperties()) {
+        m_availableDeviceExtensions.emplace(extension.extensionName);
+    }
+
+    bool isVulkan12 = m_physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_2;
+    bool isVulkan13 = m_physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_3;
+
+    // VK_EXT_descriptor_buffer depends on VK_KHR_synchronization2, which is only core from 1.3 on
+    bool synchronization2Available = isVulkan13 || isDeviceExtensionAvailable(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+    if (m_config.m_preferDescriptorBuffer && isVulkan12 && synchronization2Available && isDeviceExtensionAvailable(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME)) {
+        auto features = m_physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features, vk::PhysicalDeviceDescriptorBufferFeaturesEXT, vk::PhysicalDeviceSynchronization2FeaturesKHR>();
+        bool synchronization2 = isVulkan13 || features.get<vk::PhysicalDeviceSynchronization2FeaturesKHR>().synchronization2;
+        if (features.get<vk::PhysicalDeviceVulkan12Features>().bufferDeviceAddress && features.get<vk::PhysicalDeviceDescriptorBufferFeaturesEXT>().descriptorBuffer && synchronization2) {
+            m_descriptorBackend = DescriptorBackend::eDescriptorBuffer;
+            m_requiredDeviceExtensions.push_back(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME);
+            if (!isVulkan13) {
+                m_requiredDeviceExtensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+                m_enabledSynchronization2Features.setSynchronization2(true);
+            }
+            m_enabledVulkan12Features.setBufferDeviceAddress(true);
+            m_enabledDescriptorBufferFeatures.setDescriptorBuffer(true);
+            auto properties = m_physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorBufferPropertiesEXT>();
+            m_descriptorBufferProperties = properties.get<vk::PhysicalDeviceDescriptorBufferPropertiesEXT>();
+            m_descriptorBufferProperties.setPNext(nullptr);
+            m_enabledDescriptorBufferFeatures.setDescriptorBufferPushDescriptors(features.get<vk::PhysicalDeviceDescriptorBufferFeaturesEXT>().descriptorBufferPushDescriptors);
+        }
+    }
+
+    if (isDeviceExtensionAvailable(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME)) {
+        // push descriptors mixed with descriptor buffers would need an extra buffer binding unless the device is bufferless
+        m_pushDescriptorSupported = m_descriptorBackend == DescriptorBackend::ePool || 
+                                    (m_enabledDescriptorBufferFeatures.descriptorBufferPushDescriptors && m_descriptorBufferProperties.bufferlessPushDescriptors);
+        if (m_pushDescriptorSupported) {
+            m_requiredDeviceExtensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+        }
+    }
+
+    if (isVulkan13) {
+        m_pipelineCreationFeedbackSupported = true;
+    } else if (isDeviceExtensionAvailable(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME)) {
+        m_pipelineCreationFeedbackSupported = true;
+        m_requiredDeviceExtensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+    }
+
+    if (isVulkan13) {
+        // the states themselves are core, only the extended dynamic state 2 logic op and patch control points need features
+        m_extendedDynamicStateSupported = true;
+        m_extendedDynamicState2Supported = true;
+    } else {
+        if (isDeviceExtensionAvailable(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)) {
+            auto features = m_physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>();
+            if (features.get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>().extendedDynamicState) {
+                m_extendedDynamicStateSupported = true;
+                m_enabledExtendedDynamicStateFeatures.setExtendedDynamicState(true);
+                m_requiredDeviceExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+            }
+        }
+        if (isDeviceExtensionAvailable(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME)) {
+            auto features = m_physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceExtendedDynamicState2FeaturesEXT>();
+            if (features.get<vk::PhysicalDeviceExtendedDynamicState2FeaturesEXT>().extendedDynamicState2) {
+                m_extendedDynamicState2Supported = true;
+                m_enabledExtendedDynamicState2Features.setExtendedDynamicState2(true);
+                m_requiredDeviceExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+            }
+        }
+    }
+
+    if (isDeviceExtensionAvailable(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME)) {
+        auto features = m_physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT>();
+        auto& extendedDynamicState3Features = features.get<vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT>();
+        m_enabledExtendedDynamicState3Features.setExtendedDynamicState3PolygonMode(extendedDynamicState3Features.extendedDynamicState3PolygonMode);
+        if (m_enabledExtendedDynamicState3Features.extendedDynamicState3PolygonMode) {
+            m_requiredDeviceExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+        }
+    }
+
+    if (isDeviceExtensionAvailable(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) && isDeviceExtensionAvailable(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME)) {
+        auto features = m_physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>();
+        if (features.get<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>().graphicsPipelineLibrary) {
+            m_enabledGraphicsPipelineLibraryFeatures.setGraphicsPipelineLibrary(true);
+            m_requiredDeviceExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+            m_requiredDeviceExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+            auto properties = m_physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceGraphicsPipelineLibraryPropertiesEXT>();
+            m_graphicsPipelineLibraryProperties = properties.get<vk::PhysicalDeviceGraphicsPipelineLibraryPropertiesEXT>();
+            m_graphicsPipelineLibraryProperties.setPNext(nullptr);
+        }
+    }
+
+    INFO("Vulkan: Descriptor Backend: {}", m_descriptorBackend == DescriptorBackend::eDescriptorBuffer ? "Descriptor Buffer" : "Descriptor Pool");
 }
 
 void Device::createLogicalDevice() {
@@ -265,11 +385,24 @@ void Device::createLogicalDevice() {
         deviceQueueCreateInfos.push_back(deviceQueueCreateInfo);        
     }
 
-    vk::PhysicalDeviceFeatures deviceFeatures{};    
+    // optional feature structs are pushed to the front of the chain
+    vk::PhysicalDeviceFeatures2 physicalDeviceFeatures2{};
+    auto chainFeatures = [&](auto& features) {
+        features.setPNext(physicalDeviceFeatures2.pNext);
+        physicalDeviceFeatures2.setPNext(&features);
+    };
+    if (m_enabledVulkan12Features.bufferDeviceAddress) chainFeatures(m_enabledVulkan12Features);
+    if (m_enabledDescriptorBufferFeatures.descriptorBuffer) chainFeatures(m_enabledDescriptorBufferFeatures);
+    if (m_enabledSynchronization2Features.synchronization2) chainFeatures(m_enabledSynchronization2Features);
+    if (m_enabledExtendedDynamicStateFeatures.extendedDynamicState) chainFeatures(m_enabledExtendedDynamicStateFeatures);
+    if (m_enabledExtendedDynamicState2Features.extendedDynamicState2) chainFeatures(m_enabledExtendedDynamicState2Features);
+    if (m_enabledExtendedDynamicState3Features.extendedDynamicState3PolygonMode) chainFeatures(m_enabledExtendedDynamicState3Features);
+    if (m_enabledGraphicsPipelineLibraryFeatures.graphicsPipelineLibrary) chainFeatures(m_enabledGraphicsPipelineLibraryFeatures);
+
     vk::DeviceCreateInfo deviceCreateInfo = vk::DeviceCreateInfo{}
+        .setPNext(&physicalDeviceFeatures2)
         .setPQueueCreateInfos(deviceQueueCreateInfos.data())
         .setQueueCreateInfoCount(static_cast<uint32_t>(deviceQueueCreateInfos.size()))
-        .setPEnabledFeatures(&deviceFeatures)
         .setPpEnabledExtensionNames(m_requiredDeviceExtensions.data())
         .setEnabledExtensionCount(m_requiredDeviceExtensions.size());
 
@@ -282,6 +415,8 @@ void Device::createLogicalDevice() {
         throw std::runtime_error("Vulkan: Failed to create logical device!");
     }
 
+    m_dispatchLoaderDynamic.init(m_device);
+
     m_graphicsQueue = m_device.getQueue(queueFamilyIndices.graphicsFamily.value(), 0);
     m_presentQueue = m_device.getQueue(queueFamilyIndices.presentFamily.value(), 0);
 
@@ -298,6 +433,35 @@ uint32_t Device::findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags mem
     throw std::runtime_error("Failed to find suitable memory type!");
 }
 
+static vk::DeviceSize alignUp(vk::DeviceSize size, vk::DeviceSize alignment) {
+    if (alignment == 0) return size;
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+vk::DeviceSize Device::alignUniformBufferSize(vk::DeviceSize size) const {
+    return alignUp(size, m_physicalDeviceProperties.limits.minUniformBufferOffsetAlignment);
+}
+
+vk::DeviceSize Device::alignStorageBufferSize(vk::DeviceSize size) const {
+    return alignUp(size, m_physicalDeviceProperties.limits.minStorageBufferOffsetAlignment);
+}
+
+size_t Device::getDescriptorBufferDescriptorSize(vk::DescriptorType descriptorType) const {
+    switch (descriptorType) {
+        case vk::DescriptorType::eSampler:              return m_descriptorBufferProperties.samplerDescriptorSize;
+        case vk::DescriptorType::eCombinedImageSampler: return m_descriptorBufferProperties.combinedImageSamplerDescriptorSize;
+        case vk::DescriptorType::eSampledImage:         return m_descriptorBufferProperties.sampledImageDescriptorSize;
+        case vk::DescriptorType::eStorageImage:         return m_descriptorBufferProperties.storageImageDescriptorSize;
+        case vk::DescriptorType::eUniformTexelBuffer:   return m_descriptorBufferProperties.uniformTexelBufferDescriptorSize;
+        case vk::DescriptorType::eStorageTexelBuffer:   return m_descriptorBufferProperties.storageTexelBufferDescriptorSize;
+        case vk::DescriptorType::eUniformBuffer:        return m_descriptorBufferProperties.uniformBufferDescriptorSize;
+        case vk::DescriptorType::eStorageBuffer:        return m_descriptorBufferProperties.storageBufferDescriptorSize;
+        case vk::DescriptorType::eInputAttachment:      return m_descriptorBufferProperties.inputAttachmentDescriptorSize;
+        default:
+            throw std::runtime_error("Descriptor type " + vk::to_string(descriptorType) + " is not supported by the descriptor buffer backend!");
+    }
+}
+
 Device::QueueSubmitInfo::QueueSubmitInfo() {}
 
 Device::QueueSubmitInfo& Device::QueueSubmitInfo::addWaitSemaphore(const Semaphore& semaphore) {
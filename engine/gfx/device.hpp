@@ -3,9 +3,15 @@
 
 #include "../core/window.hpp"
 #include "../core/log.hpp"
+#include "pipelinecache.hpp"
+#include "shadermodule.hpp"
 
 #include <vector>
 #include <optional>
+#include <set>
+#include <filesystem>
+#include <memory>
+#include <string>
 
 namespace gfx {
 
@@ -13,6 +19,7 @@ class Semaphore;
 class CommandBuffer;
 class Fence;
 class SwapChain;
+class PipelineManifest;
 
 class Device {
 public:
@@ -31,8 +38,29 @@ public:
         std::vector<vk::PresentModeKHR> presentModes;
     };
 
+    enum class DescriptorBackend {
+        ePool,              // descriptor pools and vkUpdateDescriptorSets
+        eDescriptorBuffer,  // VK_EXT_descriptor_buffer, descriptors are plain writes into mapped buffers bound by offset
+    };
+
+    struct Config {
+        Config();
+
+        // only taken when the device supports VK_EXT_descriptor_buffer, falls back to the pool backend otherwise
+        // note: the descriptor buffer backend does not support dynamic buffer descriptors
+        Config& setPreferDescriptorBuffer(bool enable);
+        // where the pipeline cache blob is loaded from and saved to, defaults to "pipelinecache.bin", empty disables persistence
+        Config& setPipelineCachePath(const std::filesystem::path& path);
+        // where the pipelines built are recorded to for prewarming the next run, defaults to "pipelinemanifest.bin", empty keeps the record in memory only
+        Config& setPipelineManifestPath(const std::filesystem::path& path);
+
+        bool m_preferDescriptorBuffer;
+        std::filesystem::path m_pipelineCachePath;
+        std::filesystem::path m_pipelineManifestPath;
+    };
 
     Device(core::Window& window, bool enableValidation);
+    Device(core::Window& window, bool enableValidation, const Config& config);
     ~Device();
 
     Device(const Device&) = delete;
@@ -45,8 +73,40 @@ public:
     QueueFamilyIndices getQueueFamilyIndices() const { return findQueueFamilies(m_physicalDevice); }
     const vk::SurfaceKHR& getSurface() const { return m_surface; }
     const vk::Device& get() const { return m_device; }
+    const vk::PhysicalDeviceProperties& getPhysicalDeviceProperties() const { return m_physicalDeviceProperties; }
+    const vk::PhysicalDevice& getPhysicalDevice() const { return m_physicalDevice; }
+    // device level extension entry points
+    const vk::DispatchLoaderDynamic& getDispatchLoaderDynamic() const { return m_dispatchLoaderDynamic; }
+    bool isDeviceExtensionAvailable(const char *extensionName) const { return m_availableDeviceExtensions.contains(extensionName); }
+
+    DescriptorBackend getDescriptorBackend() const { return m_descriptorBackend; }
+    const vk::PhysicalDeviceDescriptorBufferPropertiesEXT& getDescriptorBufferProperties() const { return m_descriptorBufferProperties; }
+    size_t getDescriptorBufferDescriptorSize(vk::DescriptorType descriptorType) const;
+    // VK_KHR_push_descriptor, enabled when the device has it and, with the descriptor buffer backend,
+    // also supports descriptorBufferPushDescriptors and bufferlessPushDescriptors
+    bool isPushDescriptorSupported() const { return m_pushDescriptorSupported; }
+    // core in 1.3, VK_EXT_pipeline_creation_feedback before that
+    bool isPipelineCreationFeedbackSupported() const { return m_pipelineCreationFeedbackSupported; }
+    // core in 1.3, VK_EXT_extended_dynamic_state / VK_EXT_extended_dynamic_state2 before that
+    bool isExtendedDynamicStateSupported() const { return m_extendedDynamicStateSupported; }
+    bool isExtendedDynamicState2Supported() const { return m_extendedDynamicState2Supported; }
+    // VK_EXT_extended_dynamic_state3, only the states the engine makes use of are enabled (when supported)
+    const vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT& getExtendedDynamicState3Features() const { return m_enabledExtendedDynamicState3Features; }
+    // VK_EXT_graphics_pipeline_library, enabled whenever the device has it
+    bool isGraphicsPipelineLibrarySupported() const { return m_enabledGraphicsPipelineLibraryFeatures.graphicsPipelineLibrary; }
+    const vk::PhysicalDeviceGraphicsPipelineLibraryPropertiesEXT& getGraphicsPipelineLibraryProperties() const { return m_graphicsPipelineLibraryProperties; }
+    // pass to every pipeline creation, saved on destruction, call save() on it to persist earlier
+    const PipelineCache& getPipelineCache() const { return m_pipelineCache; }
+    // shared by every pipeline, so a shader used by many of them is only one module
+    const ShaderModuleCache& getShaderModuleCache() const { return *m_shaderModuleCache; }
+    // every graphics pipeline built on this device is recorded in it, saved on destruction
+    PipelineManifest& getPipelineManifest() const { return *m_pipelineManifest; }
     uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags memoryPropertyFlags) const;
 
+    // rounds size up to the min offset alignment, so consecutive ranges of that size can be used as dynamic offsets
+    vk::DeviceSize alignUniformBufferSize(vk::DeviceSize size) const;
+    vk::DeviceSize alignStorageBufferSize(vk::DeviceSize size) const;
+
 
     // might change in future, might relocate!
     struct QueueSubmitInfo {
@@ -85,6 +145,7 @@ private:
     void setupDebugMessenger();
     void createSurface();
     void pickPhysicalDevice();
+    void selectOptionalFeatures();
     void createLogicalDevice();
 
 private:
@@ -101,21 +162,43 @@ private:
 private:
     const core::Window& m_window;
     bool m_validations;
+    Config m_config;
 
     std::vector<const char *> m_requiredLayers{};
     std::vector<const char *> m_requiredExtensions{};
     std::vector<const char *> m_requiredDeviceExtensions{};
+    std::set<std::string>     m_availableDeviceExtensions{};
     
     vk::Instance                           m_instance;
     vk::DispatchLoaderDynamic              m_dispatchLoaderDynamic;
     vk::DebugUtilsMessengerEXT             m_debugUtilsMessenger; 
     vk::SurfaceKHR                         m_surface;
     vk::PhysicalDevice                     m_physicalDevice;
+    vk::PhysicalDeviceProperties           m_physicalDeviceProperties;
+    DescriptorBackend                      m_descriptorBackend{DescriptorBackend::ePool};
+    vk::PhysicalDeviceDescriptorBufferPropertiesEXT m_descriptorBufferProperties{};
+    bool                                   m_pushDescriptorSupported{false};
+    bool                                   m_pipelineCreationFeedbackSupported{false};
+    bool                                   m_extendedDynamicStateSupported{false};
+    bool                                   m_extendedDynamicState2Supported{false};
+    // optional features that get chained into device creation
+    vk::PhysicalDeviceVulkan12Features     m_enabledVulkan12Features{};
+    vk::PhysicalDeviceDescriptorBufferFeaturesEXT m_enabledDescriptorBufferFeatures{};
+    // only below 1.3, where VK_KHR_synchronization2 is enabled for the descriptor buffer backend
+    vk::PhysicalDeviceSynchronization2FeaturesKHR m_enabledSynchronization2Features{};
+    vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT m_enabledExtendedDynamicStateFeatures{};
+    vk::PhysicalDeviceExtendedDynamicState2FeaturesEXT m_enabledExtendedDynamicState2Features{};
+    vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT m_enabledExtendedDynamicState3Features{};
+    vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT m_enabledGraphicsPipelineLibraryFeatures{};
+    vk::PhysicalDeviceGraphicsPipelineLibraryPropertiesEXT m_graphicsPipelineLibraryProperties{};
     vk::Device                             m_device;
     vk::Queue                              m_graphicsQueue;
     vk::Queue                              m_presentQueue;
     vk::CommandPool                        m_commandPool;
     std::vector<vk::CommandBuffer>         m_commandBuffers;
+    PipelineCache                          m_pipelineCache;
+    std::unique_ptr<ShaderModuleCache>     m_shaderModuleCache;
+    std::unique_ptr<PipelineManifest>      m_pipelineManifest;
 };
 
 } // namespace gfx
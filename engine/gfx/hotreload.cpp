@@ -0,0 +1,195 @@
+#include "hotreload.hpp"
+
+#include "../core/log.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace gfx {
+
+static std::filesystem::path normalizePath(const std::filesystem::path& path) {
+    std::error_code errorCode;
+    auto normalized = std::filesystem::weakly_canonical(path, errorCode);
+    return errorCode ? path.lexically_normal() : normalized;
+}
+
+// the main sources and, for the shaders that were compiled already, everything they include
+static std::set<std::filesystem::path> getShaderPaths(const GraphicsPipeline::Builder& builder) {
+    std::set<std::filesystem::path> shaderPaths;
+    for (auto& shaderCompileInfo : builder.m_shaderCompileInfos) {
+        // offline compiled spirv has no source
+        if (shaderCompileInfo.m_path.empty()) continue;
+        shaderPaths.insert(normalizePath(shaderCompileInfo.m_path));
+    }
+    for (auto& compiledShader : builder.m_compiledShaders) {
+        if (!compiledShader.valid() || compiledShader.wait_for(std::chrono::seconds(0)) != std::future_status::ready) continue;
+        try {
+            for (auto& dependency : compiledShader.get().m_dependencies) {
+                shaderPaths.insert(normalizePath(dependency.path));
+            }
+        } catch (const std::exception&) {
+            // a failed compile has nothing to add
+        }
+    }
+    return shaderPaths;
+}
+
+HotReloader::HotReloader(std::shared_ptr<Device> device, uint32_t framesInFlight) 
+  : m_device(device), m_framesInFlight(framesInFlight), m_frame(0), m_inotifyFd(-1), m_stop(false) {
+#ifdef __linux__
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd < 0) {
+        WARN("inotify unavailable, falling back to polling shader modification times");
+    }
+#endif
+    m_thread = std::thread(&HotReloader::watcherThread, this);
+    INFO("Created Hot Reloader!");
+}
+
+HotReloader::~HotReloader() {
+    m_stop = true;
+    m_thread.join();
+#ifdef __linux__
+    if (m_inotifyFd >= 0) close(m_inotifyFd);
+#endif
+}
+
+void HotReloader::watch(GraphicsPipeline& pipeline, const GraphicsPipeline::Builder& builder) {
+    Entry entry{&pipeline, builder, getShaderPaths(builder)};
+    // the copy may carry the results of the first build, they must not be reused, except for offline compiled spirv
+    entry.builder.m_compiledShaders.clear();
+    std::erase_if(entry.builder.m_requestedShaders, [&](const auto& requestedShader) {
+        return !entry.builder.m_shaderCompileInfos[requestedShader.first].m_path.empty();
+    });
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    addWatches(entry.shaderPaths);
+    m_entries.push_back(std::move(entry));
+}
+
+void HotReloader::addWatches(const std::set<std::filesystem::path>& shaderPaths) {
+    for (auto& shaderPath : shaderPaths) {
+        addWatch(shaderPath.parent_path());
+        if (!m_writeTimes.contains(shaderPath)) {
+            std::error_code errorCode;
+            m_writeTimes[shaderPath] = std::filesystem::last_write_time(shaderPath, errorCode);
+        }
+    }
+}
+
+void HotReloader::unwatch(GraphicsPipeline& pipeline) {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    std::erase_if(m_entries, [&](const Entry& entry) { return entry.pipeline == &pipeline; });
+    std::erase_if(m_rebuilt, [&](const auto& rebuilt) { return rebuilt.first == &pipeline; });
+}
+
+void HotReloader::addWatch(const std::filesystem::path& directory) {
+#ifdef __linux__
+    if (m_inotifyFd < 0 || m_watchedDirectories.contains(directory)) return;
+    // editors often save by writing a new file and renaming it over the old one, so watch the directory
+    int watchDescriptor = inotify_add_watch(m_inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (watchDescriptor < 0) {
+        WARN("Failed to watch {} for shader changes", directory.string());
+        return;
+    }
+    m_watchedDirectories[directory] = watchDescriptor;
+#endif
+}
+
+void HotReloader::update() {
+    std::vector<std::pair<GraphicsPipeline *, GraphicsPipeline>> rebuilt;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        rebuilt.swap(m_rebuilt);
+    }
+    for (auto& [pipeline, rebuiltPipeline] : rebuilt) {
+        // frames still in flight may reference the old pipeline
+        m_retired.push_back(Retired{m_frame, std::move(*pipeline)});
+        *pipeline = std::move(rebuiltPipeline);
+    }
+    while (!m_retired.empty() && m_frame - m_retired.front().frame >= m_framesInFlight) {
+        m_retired.pop_front();
+    }
+    m_frame++;
+}
+
+void HotReloader::rebuild(const std::set<std::filesystem::path>& changedPaths) {
+    std::vector<std::pair<GraphicsPipeline *, GraphicsPipeline::Builder>> affected;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        for (auto& entry : m_entries) {
+            bool changed = std::any_of(changedPaths.begin(), changedPaths.end(), [&](auto& path) { return entry.shaderPaths.contains(path); });
+            if (changed) affected.emplace_back(entry.pipeline, entry.builder);
+        }
+    }
+    // built without holding the lock so update never waits on a compile
+    for (auto& [pipeline, builder] : affected) {
+        try {
+            GraphicsPipeline rebuiltPipeline = builder.build(m_device);
+            INFO("Hot reloaded a Graphics Pipeline!");
+            // the edit may have added or removed includes
+            auto shaderPaths = getShaderPaths(builder);
+            std::lock_guard<std::mutex> lock{m_mutex};
+            // it might have been unwatched in the meantime
+            auto entry = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry& entry) { return entry.pipeline == pipeline; });
+            if (entry != m_entries.end()) {
+                addWatches(shaderPaths);
+                entry->shaderPaths = std::move(shaderPaths);
+                m_rebuilt.emplace_back(pipeline, std::move(rebuiltPipeline));
+            }
+        } catch (const std::exception& e) {
+            ERROR("Hot reload failed, keeping the old pipeline: {}", e.what());
+        }
+    }
+}
+
+void HotReloader::watcherThread() {
+    while (!m_stop) {
+        std::set<std::filesystem::path> changedPaths;
+#ifdef __linux__
+        if (m_inotifyFd >= 0) {
+            pollfd pollFd{m_inotifyFd, POLLIN, 0};
+            if (poll(&pollFd, 1, 100) <= 0) continue;
+            // a save is often several events in a row, let them settle before rebuilding
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            alignas(inotify_event) char buffer[4096];
+            ssize_t length;
+            while ((length = read(m_inotifyFd, buffer, sizeof(buffer))) > 0) {
+                for (char *ptr = buffer; ptr < buffer + length; ) {
+                    auto event = reinterpret_cast<const inotify_event *>(ptr);
+                    if (event->len > 0) {
+                        std::lock_guard<std::mutex> lock{m_mutex};
+                        for (auto& [directory, watchDescriptor] : m_watchedDirectories) {
+                            if (watchDescriptor == event->wd) changedPaths.insert(normalizePath(directory / event->name));
+                        }
+                    }
+                    ptr += sizeof(inotify_event) + event->len;
+                }
+            }
+        } else 
+#endif
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            std::lock_guard<std::mutex> lock{m_mutex};
+            for (auto& [path, writeTime] : m_writeTimes) {
+                std::error_code errorCode;
+                auto currentWriteTime = std::filesystem::last_write_time(path, errorCode);
+                if (!errorCode && currentWriteTime != writeTime) {
+                    writeTime = currentWriteTime;
+                    changedPaths.insert(path);
+                }
+            }
+        }
+        if (!changedPaths.empty()) {
+            rebuild(changedPaths);
+        }
+    }
+}
+
+} // namespace gfx
@@ -0,0 +1,74 @@
+#ifndef GFX_HOTRELOAD_HPP
+#define GFX_HOTRELOAD_HPP
+
+#include "pipeline.hpp"
+
+#include <atomic>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace gfx {
+
+// watches the shader files (and everything they include) of registered pipelines (inotify on linux, modification times elsewhere),
+// rebuilds the affected pipelines on a background thread and swaps them in at a frame boundary
+// a shader that fails to compile keeps the old pipeline and logs the error
+class HotReloader {
+public:
+    // retired pipelines are destroyed once framesInFlight frames have passed through update
+    HotReloader(std::shared_ptr<Device> device, uint32_t framesInFlight);
+    // wait for the device to be idle before destroying, retired pipelines are destroyed right away
+    ~HotReloader();
+
+    HotReloader(const HotReloader&) = delete;
+    HotReloader& operator=(const HotReloader&) = delete;
+
+    // pipeline has to stay at the same address until unwatch, builder is what it gets rebuilt from
+    void watch(GraphicsPipeline& pipeline, const GraphicsPipeline::Builder& builder);
+    void unwatch(GraphicsPipeline& pipeline);
+
+    // call once per frame before recording, swaps in rebuilt pipelines and destroys the ones no frame can use anymore
+    void update();
+
+private:
+    struct Entry {
+        GraphicsPipeline *pipeline;
+        GraphicsPipeline::Builder builder;
+        std::set<std::filesystem::path> shaderPaths;
+    };
+
+    struct Retired {
+        uint64_t frame;
+        GraphicsPipeline pipeline;
+    };
+
+    void watcherThread();
+    void addWatch(const std::filesystem::path& directory);
+    // shader sources and the headers they include, m_mutex has to be held
+    void addWatches(const std::set<std::filesystem::path>& shaderPaths);
+    void rebuild(const std::set<std::filesystem::path>& changedPaths);
+
+private:
+    std::shared_ptr<Device> m_device;
+    uint32_t m_framesInFlight;
+    uint64_t m_frame;
+
+    std::mutex m_mutex;
+    std::vector<Entry> m_entries;
+    std::map<std::filesystem::path, int> m_watchedDirectories;                   // directory -> inotify watch descriptor
+    std::map<std::filesystem::path, std::filesystem::file_time_type> m_writeTimes;  // used when inotify is not available
+    std::vector<std::pair<GraphicsPipeline *, GraphicsPipeline>> m_rebuilt;
+    std::deque<Retired> m_retired;
+
+    int m_inotifyFd;
+    std::atomic<bool> m_stop;
+    std::thread m_thread;
+};
+
+} // namespace gfx
+
+#endif
@@ -1,34 +1,122 @@
 #include "pipeline.hpp"
+#include "pipelinemanifest.hpp"
 
 #include "../core/log.hpp"
 
-// #include <shaderc/libshaderc_util/include/libshaderc_util/file_finder.h>
-// #include <shaderc/glslc/src/file_includer.h>
-#include <shaderc/shaderc.hpp>
-
-#include <fstream>
+#include <algorithm>
+#include <array>
+#include <cstring>
 
 namespace gfx {
 
-namespace utils {
-
-static std::string readFile(const std::filesystem::path& path) {
-    std::ifstream file{path};
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to read file: " + path.string());
+// **********SpecializationConstants**********
+void SpecializationConstants::set(uint32_t constantId, const void *data, size_t size) {
+    auto mapEntry = std::find_if(m_mapEntries.begin(), m_mapEntries.end(), [&](auto& entry) { return entry.constantID == constantId; });
+    if (mapEntry != m_mapEntries.end() && mapEntry->size == size) {
+        std::memcpy(m_data.data() + mapEntry->offset, data, size);
+        return;
+    }
+    if (mapEntry != m_mapEntries.end()) {
+        // the type changed, the old bytes are dropped so they do not end up in the data (and the cache keys)
+        uint32_t offset = mapEntry->offset;
+        size_t oldSize = mapEntry->size;
+        m_data.erase(m_data.begin() + offset, m_data.begin() + offset + oldSize);
+        m_mapEntries.erase(mapEntry);
+        for (auto& entry : m_mapEntries) {
+            if (entry.offset > offset) entry.offset -= static_cast<uint32_t>(oldSize);
+        }
     }
-    INFO("Read file {}", path.string());
+    m_mapEntries.push_back(vk::SpecializationMapEntry{}
+        .setConstantID(constantId)
+        .setOffset(static_cast<uint32_t>(m_data.size()))
+        .setSize(size));
+    auto bytes = static_cast<const uint8_t *>(data);
+    m_data.insert(m_data.end(), bytes, bytes + size);
+}
 
-    return std::string((std::istreambuf_iterator<char>(file)), (std::istreambuf_iterator<char>()));
+bool SpecializationConstants::get(uint32_t constantId, void *data, size_t size) const {
+    auto mapEntry = std::find_if(m_mapEntries.begin(), m_mapEntries.end(), [&](auto& entry) { return entry.constantID == constantId; });
+    if (mapEntry == m_mapEntries.end() || mapEntry->size != size) return false;
+    std::memcpy(data, m_data.data() + mapEntry->offset, size);
+    return true;
 }
 
-} // namespace utils
+vk::SpecializationInfo SpecializationConstants::getSpecializationInfo() const {
+    return vk::SpecializationInfo{}
+        .setMapEntryCount(m_mapEntries.size())
+        .setPMapEntries(m_mapEntries.data())
+        .setDataSize(m_data.size())
+        .setPData(m_data.data());
+}
 
 // **********************GraphicsPipeline::Builder*****************************
 GraphicsPipeline::Builder::Builder() {}
 
 GraphicsPipeline::Builder& GraphicsPipeline::Builder::addShaderFromPath(const std::filesystem::path& shaderPath) {
-    m_shaderPaths.emplace(shaderPath);
+    assert(m_compiledShaders.empty() && "Shaders added after compileShadersAsync!");
+    // adding the same file again is a no-op
+    for (auto& shaderCompileInfo : m_shaderCompileInfos) {
+        if (shaderCompileInfo.m_path == shaderPath) return *this;
+    }
+    auto shaderCompileInfo = ShaderCompiler::CompileInfo{}.setPath(shaderPath);
+    assert(!hasShaderStage(shaderCompileInfo.m_stage) && "Shader stage added twice!");
+    m_shaderCompileInfos.push_back(shaderCompileInfo);
+    return *this;
+}
+
+GraphicsPipeline::Builder& GraphicsPipeline::Builder::addShader(const ShaderCompiler::CompileInfo& compileInfo) {
+    assert(m_compiledShaders.empty() && "Shaders added after compileShadersAsync!");
+    assert(!hasShaderStage(compileInfo.m_stage) && "Shader stage added twice!");
+    m_shaderCompileInfos.push_back(compileInfo);
+    return *this;
+}
+
+GraphicsPipeline::Builder& GraphicsPipeline::Builder::addShader(ShaderPermutations& shaderPermutations, ShaderPermutations::VariantMask variantMask) {
+    assert(m_compiledShaders.empty() && "Shaders added after compileShadersAsync!");
+    // the compile info is kept as well, the state cache and hot reload go by it
+    auto shaderCompileInfo = shaderPermutations.getCompileInfo(variantMask);
+    assert(!hasShaderStage(shaderCompileInfo.m_stage) && "Shader stage added twice!");
+    m_requestedShaders[m_shaderCompileInfos.size()] = shaderPermutations.getVariant(variantMask);
+    m_shaderCompileInfos.push_back(shaderCompileInfo);
+    return *this;
+}
+
+GraphicsPipeline::Builder& GraphicsPipeline::Builder::addShaderFromSpirv(std::span<const uint32_t> code, vk::ShaderStageFlagBits stage) {
+    assert(m_compiledShaders.empty() && "Shaders added after compileShadersAsync!");
+    assert(!hasShaderStage(stage) && "Shader stage added twice!");
+    m_requestedShaders[m_shaderCompileInfos.size()] = ShaderCompiler::fromSpirv(code, stage);
+    m_shaderCompileInfos.push_back(ShaderCompiler::CompileInfo{}.setStage(stage));
+    return *this;
+}
+
+bool GraphicsPipeline::Builder::hasShaderStage(vk::ShaderStageFlagBits stage) const {
+    for (auto& shaderCompileInfo : m_shaderCompileInfos) {
+        if (shaderCompileInfo.m_stage == stage) return true;
+    }
+    return false;
+}
+
+GraphicsPipeline::Builder& GraphicsPipeline::Builder::setShaderOptimizationLevel(ShaderCompiler::OptimizationLevel optimizationLevel) {
+    assert(m_compiledShaders.empty() && "Optimization level set after compileShadersAsync!");
+    m_shaderOptimizationLevel = optimizationLevel;
+    return *this;
+}
+
+GraphicsPipeline::Builder& GraphicsPipeline::Builder::compileShadersAsync() {
+    if (!m_compiledShaders.empty()) return *this;
+    m_compiledShaders.reserve(m_shaderCompileInfos.size());
+    for (size_t i = 0; i < m_shaderCompileInfos.size(); i++) {
+        auto requestedShader = m_requestedShaders.find(i);
+        if (requestedShader != m_requestedShaders.end()) {
+            m_compiledShaders.push_back(requestedShader->second);
+            continue;
+        }
+        auto shaderCompileInfo = m_shaderCompileInfos[i];
+        if (!shaderCompileInfo.m_optimizationLevel && m_shaderOptimizationLevel) {
+            shaderCompileInfo.setOptimizationLevel(*m_shaderOptimizationLevel);
+        }
+        m_compiledShaders.push_back(ShaderCompiler::compileAsync(shaderCompileInfo));
+    }
     return *this;
 }
 
@@ -37,6 +125,45 @@ GraphicsPipeline::Builder& GraphicsPipeline::Builder::addDynamicState(vk::Dynami
     return *this;
 }
 
+GraphicsPipeline::Builder& GraphicsPipeline::Builder::setDynamicViewportScissor(bool enable) {
+    m_dynamicViewportScissor = enable;
+    return *this;
+}
+
+GraphicsPipeline::Builder& GraphicsPipeline::Builder::setExtendedDynamicState(bool enable) {
+    m_extendedDynamicState = enable;
+    return *this;
+}
+
+std::vector<vk::DynamicState> GraphicsPipeline::Builder::getDynamicStates(const Device& device) const {
+    std::vector<vk::DynamicState> dynamicStates = m_dynamicStates;
+    auto add = [&](vk::DynamicState dynamicState) {
+        if (std::find(dynamicStates.begin(), dynamicStates.end(), dynamicState) == dynamicStates.end()) {
+            dynamicStates.push_back(dynamicState);
+        }
+    };
+    if (m_dynamicViewportScissor) {
+        add(vk::DynamicState::eViewport);
+        add(vk::DynamicState::eScissor);
+    }
+    if (m_extendedDynamicState) {
+        if (device.isExtendedDynamicStateSupported()) {
+            add(vk::DynamicState::eCullMode);
+            add(vk::DynamicState::eFrontFace);
+            add(vk::DynamicState::ePrimitiveTopology);
+        }
+        if (device.isExtendedDynamicState2Supported()) {
+            add(vk::DynamicState::eRasterizerDiscardEnable);
+            add(vk::DynamicState::eDepthBiasEnable);
+            add(vk::DynamicState::ePrimitiveRestartEnable);
+        }
+        if (device.getExtendedDynamicState3Features().extendedDynamicState3PolygonMode) {
+            add(vk::DynamicState::ePolygonModeEXT);
+        }
+    }
+    return dynamicStates;
+}
+
 GraphicsPipeline::Builder& GraphicsPipeline::Builder::setInputAssemblyTopology(vk::PrimitiveTopology topology) {
     m_pipelineInputAssemblyStateCreateInfo.setTopology(topology);
     return *this;
@@ -182,6 +309,15 @@ GraphicsPipeline::Builder& GraphicsPipeline::Builder::addPushConstantRangeLayout
 
 GraphicsPipeline::Builder& GraphicsPipeline::Builder::addDescriptorSetLayout(const DescriptorSetLayout& descriptorSetLayout) {
     m_descriptorSetLayout.push_back(descriptorSetLayout.get());
+    DescriptorSetLayout::Builder descriptorSetLayoutBuilder;
+    descriptorSetLayoutBuilder.setFlags(descriptorSetLayout.getFlags());
+    descriptorSetLayoutBuilder.m_descriptorBindingDescriptions = descriptorSetLayout.getDescriptorBindingDescriptions();
+    m_explicitDescriptorSetLayouts.push_back(std::move(descriptorSetLayoutBuilder));
+    return *this;
+}
+
+GraphicsPipeline::Builder& GraphicsPipeline::Builder::setReflection(DescriptorSetLayoutCache& descriptorSetLayoutCache) {
+    m_descriptorSetLayoutCache = &descriptorSetLayoutCache;
     return *this;
 }
 
@@ -197,163 +333,424 @@ GraphicsPipeline::Builder& GraphicsPipeline::Builder::addVertexInputAttributeDes
 
 GraphicsPipeline::Builder& GraphicsPipeline::Builder::setRenderPass(const RenderPass& renderPass) {
     m_renderPass = renderPass.get();
+    m_renderPassCompatibilityHash = renderPass.getCompatibilityHash();
     return *this;
 }
 
-GraphicsPipeline GraphicsPipeline::Builder::build(std::shared_ptr<Device> device) {
-    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
-    pipelineLayoutCreateInfo.setPushConstantRangeCount(m_pushConstantRanges.size())
-                            .setPPushConstantRanges(m_pushConstantRanges.data())
-                            .setSetLayoutCount(m_descriptorSetLayout.size())
-                            .setPSetLayouts(m_descriptorSetLayout.data());
+void GraphicsPipeline::Builder::prepare(std::shared_ptr<Device> device, Prepared& prepared) {
+    compileShadersAsync();
 
-    vk::PipelineLayout pipelineLayout;
-    if (device->get().createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &pipelineLayout) != vk::Result::eSuccess) {
-        throw std::runtime_error("Failed to create pipeline layout!");
+    std::vector<const ShaderCompiler::Result *> compiledShaders;
+    compiledShaders.reserve(m_compiledShaders.size());
+    for (auto& compiledShader : m_compiledShaders) {
+        compiledShaders.push_back(&compiledShader.get());
     }
 
-    // static shaderc_util::FileFinder fileFinder;
-    static shaderc::Compiler compiler;
-    static shaderc::CompileOptions options;
-    // static bool once = []() { options.SetIncluder(std::make_unique<glslc::FileIncluder>(&fileFinder));  return true; }();
-
-    std::vector<vk::ShaderModule> shaderModules;
-    std::vector<vk::PipelineShaderStageCreateInfo> pipelineShaderStageCreateInfos;
-
-    shaderModules.reserve(m_shaderPaths.size());
-    pipelineShaderStageCreateInfos.reserve(m_shaderPaths.size());
-
-    for (auto& shaderPath : m_shaderPaths) {
-
-        const auto source = utils::readFile(shaderPath);
-        const auto name = shaderPath.filename().string().c_str();
-
-        // TODO: potentially add options for setting optimization levels
-        options.SetOptimizationLevel(shaderc_optimization_level_zero);
-
-        shaderc_shader_kind kind;
-        vk::ShaderStageFlagBits shaderStage;
-        if (shaderPath.extension().string() == ".vert") {
-            kind = shaderc_shader_kind::shaderc_glsl_vertex_shader;
-            shaderStage = vk::ShaderStageFlagBits::eVertex;
+    const std::vector<vk::DescriptorSetLayout> *descriptorSetLayouts = &m_descriptorSetLayout;
+    const std::vector<vk::PushConstantRange> *pushConstantRanges = &m_pushConstantRanges;
+    const std::vector<vk::VertexInputBindingDescription> *vertexInputBindingDescriptions = &m_vertexInputBindingDescriptions;
+    const std::vector<vk::VertexInputAttributeDescription> *vertexInputAttributeDescriptions = &m_vertexInputAttributeDescriptions;
+
+    // only what was not set explicitly is taken from reflection
+    std::vector<vk::DescriptorSetLayout> reflectedDescriptorSetLayouts;
+    std::vector<vk::PushConstantRange> reflectedPushConstantRanges;
+    if (m_descriptorSetLayoutCache) {
+        ShaderReflection shaderReflection;
+        for (auto compiledShader : compiledShaders) {
+            shaderReflection.merge(ShaderReflection::reflect(compiledShader->m_code, compiledShader->m_stage));
         }
-        if (shaderPath.extension().string() == ".frag") {
-            kind = shaderc_shader_kind::shaderc_glsl_fragment_shader;
-            shaderStage = vk::ShaderStageFlagBits::eFragment;
+        if (m_descriptorSetLayout.empty()) {
+            for (auto& descriptorSetLayoutBuilder : shaderReflection.getDescriptorSetLayoutBuilders()) {
+                const DescriptorSetLayout& descriptorSetLayout = m_descriptorSetLayoutCache->get(descriptorSetLayoutBuilder);
+                prepared.descriptorSetLayouts.push_back(&descriptorSetLayout);
+                reflectedDescriptorSetLayouts.push_back(descriptorSetLayout.get());
+            }
+            descriptorSetLayouts = &reflectedDescriptorSetLayouts;
         }
-        if (shaderPath.extension().string() == ".geom") {
-            kind = shaderc_shader_kind::shaderc_glsl_geometry_shader;
-            shaderStage = vk::ShaderStageFlagBits::eGeometry;
+        if (m_pushConstantRanges.empty()) {
+            reflectedPushConstantRanges = shaderReflection.m_pushConstantRanges;
+            pushConstantRanges = &reflectedPushConstantRanges;
         }
-        if (shaderPath.extension().string() == ".comp") {
-            kind = shaderc_shader_kind::shaderc_glsl_compute_shader;
-            shaderStage = vk::ShaderStageFlagBits::eCompute;
-        }
-
-        shaderc::SpvCompilationResult module = compiler.CompileGlslToSpv(source, kind, name, options);
-
-        if (module.GetCompilationStatus() != shaderc_compilation_status_success) {
-            throw std::runtime_error("Failed to compile shader: " + shaderPath.string() + "\n\t" + module.GetErrorMessage());
+        if (m_vertexInputBindingDescriptions.empty() && m_vertexInputAttributeDescriptions.empty() && !shaderReflection.m_vertexAttributes.empty()) {
+            prepared.vertexInputBindingDescriptions.push_back(shaderReflection.getVertexInputBindingDescription());
+            prepared.vertexInputAttributeDescriptions = shaderReflection.getVertexInputAttributeDescriptions();
+            vertexInputBindingDescriptions = &prepared.vertexInputBindingDescriptions;
+            vertexInputAttributeDescriptions = &prepared.vertexInputAttributeDescriptions;
         }
+    }
 
-        INFO("Successfully compiled shader {}", shaderPath.filename().string());
-
-        std::vector<uint32_t> code{ module.cbegin(), module.cend() };
-
-        // std::string codeToBeSaved { reinterpret_cast<const char*>(code.data()), code.size() * sizeof(uint32_t) };
-        // std::fstream file{"../../../assets/shader/" + shaderPath.filename().string() + ".spv", std::fstream::out | std::fstream::trunc | std::fstream::binary };
-        // file.write(codeToBeSaved.c_str(), codeToBeSaved.size());
-        // file.close();
+    prepared.setLayouts = *descriptorSetLayouts;
+    prepared.pushConstantRanges = *pushConstantRanges;
 
-        vk::ShaderModuleCreateInfo shaderModuleCreateInfo = vk::ShaderModuleCreateInfo{}
-            .setCodeSize(code.size() * sizeof(uint32_t))
-            .setPCode(code.data());
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+    pipelineLayoutCreateInfo.setPushConstantRangeCount(prepared.pushConstantRanges.size())
+                            .setPPushConstantRanges(prepared.pushConstantRanges.data())
+                            .setSetLayoutCount(prepared.setLayouts.size())
+                            .setPSetLayouts(prepared.setLayouts.data());
 
-        vk::ShaderModule shaderModule;
+    if (device->get().createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &prepared.pipelineLayout) != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create pipeline layout!");
+    }
 
-        if (device->get().createShaderModule(&shaderModuleCreateInfo, nullptr, &shaderModule) != vk::Result::eSuccess) {
-            throw std::runtime_error("Failed to create shader module!");
+    prepared.shaderModules.reserve(compiledShaders.size());
+    prepared.pipelineShaderStageCreateInfos.reserve(compiledShaders.size());
+    // reserved up front, the stage create infos point into it
+    prepared.specializationInfos.reserve(compiledShaders.size());
+
+    for (auto compiledShader : compiledShaders) {
+        try {
+            prepared.shaderModules.push_back(device->getShaderModuleCache().get(compiledShader->m_code));
+        } catch (...) {
+            prepared.destroy(*device);
+            throw;
         }
-        shaderModules.push_back(shaderModule);
 
         vk::PipelineShaderStageCreateInfo pipelineShaderStageCreateInfo = vk::PipelineShaderStageCreateInfo{}
-            .setModule(shaderModules.back())
+            .setModule(prepared.shaderModules.back()->get())
             .setPName("main")
-            .setStage(shaderStage);
+            .setStage(compiledShader->m_stage);
+        auto specializationConstants = m_specializationConstants.find(compiledShader->m_stage);
+        if (specializationConstants != m_specializationConstants.end()) {
+            prepared.specializationInfos.push_back(specializationConstants->second.getSpecializationInfo());
+            pipelineShaderStageCreateInfo.setPSpecializationInfo(&prepared.specializationInfos.back());
+        }
         
-        pipelineShaderStageCreateInfos.push_back(pipelineShaderStageCreateInfo);
+        prepared.pipelineShaderStageCreateInfos.push_back(pipelineShaderStageCreateInfo);
     }
 
     // TODO: Do this correctly
     // hack
-    vk::PipelineVertexInputStateCreateInfo vertexInput = vk::PipelineVertexInputStateCreateInfo{}
-        .setVertexBindingDescriptionCount(m_vertexInputBindingDescriptions.size())
-        .setPVertexBindingDescriptions(m_vertexInputBindingDescriptions.data())
-        .setVertexAttributeDescriptionCount(m_vertexInputAttributeDescriptions.size())
-        .setPVertexAttributeDescriptions(m_vertexInputAttributeDescriptions.data());
-
-    vk::PipelineViewportStateCreateInfo viewportState = vk::PipelineViewportStateCreateInfo{}
-        .setViewportCount(m_viewports.size())
-        .setPViewports(m_viewports.data())
-        .setScissorCount(m_scissors.size())
-        .setPScissors(m_scissors.data());
+    prepared.vertexInput = vk::PipelineVertexInputStateCreateInfo{}
+        .setVertexBindingDescriptionCount(vertexInputBindingDescriptions->size())
+        .setPVertexBindingDescriptions(vertexInputBindingDescriptions->data())
+        .setVertexAttributeDescriptionCount(vertexInputAttributeDescriptions->size())
+        .setPVertexAttributeDescriptions(vertexInputAttributeDescriptions->data());
+
+    prepared.dynamicStates = getDynamicStates(*device);
+
+    if (m_dynamicViewportScissor) {
+        // the pointers are ignored, only the counts matter
+        prepared.viewportState = vk::PipelineViewportStateCreateInfo{}
+            .setViewportCount(std::max<uint32_t>(1, m_viewports.size()))
+            .setScissorCount(std::max<uint32_t>(1, m_scissors.size()));
+    } else {
+        prepared.viewportState = vk::PipelineViewportStateCreateInfo{}
+            .setViewportCount(m_viewports.size())
+            .setPViewports(m_viewports.data())
+            .setScissorCount(m_scissors.size())
+            .setPScissors(m_scissors.data());
+    }
 
     m_pipelineColorBlendStateCreateInfo.setAttachmentCount(m_pipelineColorBlendAttachmentStates.size())
                                        .setPAttachments(m_pipelineColorBlendAttachmentStates.data());
 
-    vk::PipelineDynamicStateCreateInfo dynamicStateCreateInfo = vk::PipelineDynamicStateCreateInfo{}
-        .setDynamicStateCount(m_dynamicStates.size())
-        .setPDynamicStates(m_dynamicStates.data());
+    prepared.dynamicState = vk::PipelineDynamicStateCreateInfo{}
+        .setDynamicStateCount(prepared.dynamicStates.size())
+        .setPDynamicStates(prepared.dynamicStates.data());
 
     m_pipelineMultisampleStateCreateInfo.setPSampleMask(nullptr);
 
-    vk::GraphicsPipelineCreateInfo graphicsPipelineCreateInfo = vk::GraphicsPipelineCreateInfo{}
-        .setStageCount(pipelineShaderStageCreateInfos.size())
-        .setPStages(pipelineShaderStageCreateInfos.data())
-        .setPVertexInputState(&vertexInput)
+    prepared.graphicsPipelineCreateInfo = vk::GraphicsPipelineCreateInfo{}
+        .setStageCount(prepared.pipelineShaderStageCreateInfos.size())
+        .setPStages(prepared.pipelineShaderStageCreateInfos.data())
+        .setPVertexInputState(&prepared.vertexInput)
         .setPInputAssemblyState(&m_pipelineInputAssemblyStateCreateInfo)
-        .setPViewportState(&viewportState)
+        .setPViewportState(&prepared.viewportState)
         .setPRasterizationState(&m_pipelineRasterizationStateCreateInfo)
         .setPMultisampleState(&m_pipelineMultisampleStateCreateInfo)
         .setPDepthStencilState(nullptr)
         .setPColorBlendState(&m_pipelineColorBlendStateCreateInfo)
-        .setPDynamicState(&dynamicStateCreateInfo)
-        .setLayout(pipelineLayout)
+        .setPDynamicState(&prepared.dynamicState)
+        .setLayout(prepared.pipelineLayout)
         .setRenderPass(m_renderPass)
         .setSubpass(0)
         .setBasePipelineHandle(vk::Pipeline{ VK_NULL_HANDLE })
         .setBasePipelineIndex(-1);
+    if (device->getDescriptorBackend() == Device::DescriptorBackend::eDescriptorBuffer) {
+        prepared.graphicsPipelineCreateInfo.flags |= vk::PipelineCreateFlagBits::eDescriptorBufferEXT;
+    }
+}
+
+void GraphicsPipeline::Builder::Prepared::destroy(const Device& device) {
+    shaderModules.clear();
+    if (pipelineLayout) device.get().destroyPipelineLayout(pipelineLayout);
+    pipelineLayout = VK_NULL_HANDLE;
+}
+
+GraphicsPipeline GraphicsPipeline::Builder::build(std::shared_ptr<Device> device) {
+    Prepared prepared;
+    prepare(device, prepared);
 
     vk::Pipeline graphicsPipline;
 
-    auto graphicsPipelineResult = device->get().createGraphicsPipeline(VK_NULL_HANDLE, graphicsPipelineCreateInfo);
+    auto res = device->get().createGraphicsPipelines(device->getPipelineCache().get(), 1, &prepared.graphicsPipelineCreateInfo, nullptr, &graphicsPipline);
 
-    if (graphicsPipelineResult.result != vk::Result::eSuccess) {
+    if (res != vk::Result::eSuccess) {
+        prepared.destroy(*device);
         throw std::runtime_error("Failed to create graphics pipeline!");
     }
 
-    graphicsPipline = graphicsPipelineResult.value;
-
     INFO("Created a Graphics Pipeline!");
+    device->getPipelineManifest().record(*this);
 
-    return {device, graphicsPipline, pipelineLayout, shaderModules};
+    return {device, graphicsPipline, prepared};
 }
 
 // **********************GRAPHICSPROGRAM*********************
-GraphicsPipeline::GraphicsPipeline(std::shared_ptr<Device> device, const vk::Pipeline& pipeline, const vk::PipelineLayout& pipelineLayout, const std::vector<vk::ShaderModule>& shaderModules) : m_device(device), m_pipeline(pipeline), m_pipelineLayout(pipelineLayout), m_shaderModules(shaderModules) {
+GraphicsPipeline::GraphicsPipeline(std::shared_ptr<Device> device, const vk::Pipeline& pipeline, const Builder::Prepared& prepared) 
+  : m_device(device), m_pipeline(pipeline), m_pipelineLayout(prepared.pipelineLayout), m_shaderModules(prepared.shaderModules), m_descriptorSetLayouts(prepared.descriptorSetLayouts), 
+    m_dynamicStates(prepared.dynamicStates) {
+
+}
 
+GraphicsPipeline::GraphicsPipeline(GraphicsPipeline&& graphicsPipeline) 
+  : m_device(graphicsPipeline.m_device), m_pipeline(graphicsPipeline.m_pipeline), m_pipelineLayout(graphicsPipeline.m_pipelineLayout), m_shaderModules(std::move(graphicsPipeline.m_shaderModules)), 
+    m_descriptorSetLayouts(std::move(graphicsPipeline.m_descriptorSetLayouts)), m_dynamicStates(std::move(graphicsPipeline.m_dynamicStates)) {
+    graphicsPipeline.m_device = nullptr;
+    graphicsPipeline.m_pipeline = VK_NULL_HANDLE;
+    graphicsPipeline.m_pipelineLayout = VK_NULL_HANDLE;
+    graphicsPipeline.m_shaderModules.clear();
 }
 
 GraphicsPipeline::~GraphicsPipeline() {
-    for (auto& shaderModule : m_shaderModules) {
-        m_device->get().destroyShaderModule(shaderModule);
-    }
-    m_device->get().destroyPipelineLayout(m_pipelineLayout);
-    m_device->get().destroyPipeline(m_pipeline);
+    destroy();
+}
+
+GraphicsPipeline& GraphicsPipeline::operator=(GraphicsPipeline&& graphicsPipeline) {
+    destroy();
+    m_device = graphicsPipeline.m_device;
+    m_pipeline = graphicsPipeline.m_pipeline;
+    m_pipelineLayout = graphicsPipeline.m_pipelineLayout;
+    m_shaderModules = std::move(graphicsPipeline.m_shaderModules);
+    m_descriptorSetLayouts = std::move(graphicsPipeline.m_descriptorSetLayouts);
+    m_dynamicStates = std::move(graphicsPipeline.m_dynamicStates);
+    graphicsPipeline.m_device = nullptr;
+    graphicsPipeline.m_pipeline = VK_NULL_HANDLE;
+    graphicsPipeline.m_pipelineLayout = VK_NULL_HANDLE;
+    graphicsPipeline.m_shaderModules.clear();
+    return *this;
+}
+
+void GraphicsPipeline::destroy() {
+    if (!m_device) return;
+    if (m_pipelineLayout) m_device->get().destroyPipelineLayout(m_pipelineLayout);
+    if (m_pipeline) m_device->get().destroyPipeline(m_pipeline);
+    m_shaderModules.clear();
+    m_pipelineLayout = VK_NULL_HANDLE;
+    m_pipeline = VK_NULL_HANDLE;
+    m_device = nullptr;
+}
+
+const DescriptorSetLayout& GraphicsPipeline::getDescriptorSetLayout(uint32_t set) const {
+    assert(set < m_descriptorSetLayouts.size() && "Pipeline was not built with reflection or does not use this set!");
+    return *m_descriptorSetLayouts[set];
+}
+
+bool GraphicsPipeline::hasDynamicState(vk::DynamicState dynamicState) const {
+    return std::find(m_dynamicStates.begin(), m_dynamicStates.end(), dynamicState) != m_dynamicStates.end();
 }
 
 void GraphicsPipeline::bind(const CommandBuffer& commandBuffer) {
     commandBuffer.get().bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipeline);
 }
 
+// **********ComputePipeline::Builder**********
+ComputePipeline::Builder::Builder() {}
+
+ComputePipeline::Builder& ComputePipeline::Builder::setShaderFromPath(const std::filesystem::path& shaderPath) {
+    return setShader(ShaderCompiler::CompileInfo{}.setPath(shaderPath));
+}
+
+ComputePipeline::Builder& ComputePipeline::Builder::setShader(const ShaderCompiler::CompileInfo& compileInfo) {
+    assert(!m_compiledShader.valid() && "Shader set after compileShaderAsync!");
+    assert(compileInfo.m_stage == vk::ShaderStageFlagBits::eCompute && "Compute pipelines take a compute shader!");
+    m_shaderCompileInfo = compileInfo;
+    return *this;
+}
+
+ComputePipeline::Builder& ComputePipeline::Builder::setShaderFromSpirv(std::span<const uint32_t> code) {
+    assert(!m_compiledShader.valid() && "Shader set after compileShaderAsync!");
+    m_shaderCompileInfo = ShaderCompiler::CompileInfo{}.setStage(vk::ShaderStageFlagBits::eCompute);
+    m_compiledShader = ShaderCompiler::fromSpirv(code, vk::ShaderStageFlagBits::eCompute);
+    return *this;
+}
+
+ComputePipeline::Builder& ComputePipeline::Builder::setShaderOptimizationLevel(ShaderCompiler::OptimizationLevel optimizationLevel) {
+    assert(!m_compiledShader.valid() && "Optimization level set after compileShaderAsync!");
+    m_shaderOptimizationLevel = optimizationLevel;
+    return *this;
+}
+
+ComputePipeline::Builder& ComputePipeline::Builder::setWorkgroupSize(const vk::Extent3D& workgroupSize) {
+    m_workgroupSize = workgroupSize;
+    return *this;
+}
+
+ComputePipeline::Builder& ComputePipeline::Builder::addPushConstantRangeLayout(const vk::PushConstantRange& pushConstantRange) {
+    m_pushConstantRanges.push_back(pushConstantRange);
+    return *this;
+}
+
+ComputePipeline::Builder& ComputePipeline::Builder::addDescriptorSetLayout(const DescriptorSetLayout& descriptorSetLayout) {
+    m_descriptorSetLayout.push_back(descriptorSetLayout.get());
+    return *this;
+}
+
+ComputePipeline::Builder& ComputePipeline::Builder::setReflection(DescriptorSetLayoutCache& descriptorSetLayoutCache) {
+    m_descriptorSetLayoutCache = &descriptorSetLayoutCache;
+    return *this;
+}
+
+ComputePipeline::Builder& ComputePipeline::Builder::compileShaderAsync() {
+    if (m_compiledShader.valid()) return *this;
+    if (!m_shaderCompileInfo) {
+        throw std::runtime_error("Compute pipeline has no shader!");
+    }
+    auto shaderCompileInfo = *m_shaderCompileInfo;
+    if (!shaderCompileInfo.m_optimizationLevel && m_shaderOptimizationLevel) {
+        shaderCompileInfo.setOptimizationLevel(*m_shaderOptimizationLevel);
+    }
+    m_compiledShader = ShaderCompiler::compileAsync(shaderCompileInfo);
+    return *this;
+}
+
+ComputePipeline ComputePipeline::Builder::build(std::shared_ptr<Device> device) {
+    compileShaderAsync();
+    const ShaderCompiler::Result& compiledShader = m_compiledShader.get();
+
+    // always reflected, the workgroup size is needed for dispatch
+    ShaderReflection shaderReflection = ShaderReflection::reflect(compiledShader.m_code, compiledShader.m_stage);
+
+    vk::Extent3D workgroupSize = m_workgroupSize.value_or(shaderReflection.m_workgroupSize);
+    if (!m_workgroupSize) {
+        // the dimensions given by local_size_*_id are what this builder specialized them to, or the shader's defaults
+        std::array<uint32_t *, 3> dimensions{&workgroupSize.width, &workgroupSize.height, &workgroupSize.depth};
+        for (uint32_t i = 0; i < 3; i++) {
+            auto& constantId = shaderReflection.m_workgroupSizeConstantIds[i];
+            if (!constantId) continue;
+            if (auto value = m_specializationConstants.get<uint32_t>(*constantId)) {
+                *dimensions[i] = *value;
+            }
+        }
+    }
+    if (workgroupSize.width == 0 || workgroupSize.height == 0 || workgroupSize.depth == 0) {
+        throw std::runtime_error("Compute shader declares no local size!");
+    }
+
+    std::vector<vk::DescriptorSetLayout> descriptorSetLayouts = m_descriptorSetLayout;
+    std::vector<vk::PushConstantRange> pushConstantRanges = m_pushConstantRanges;
+    std::vector<const DescriptorSetLayout *> reflectedDescriptorSetLayouts;
+    if (m_descriptorSetLayoutCache) {
+        if (descriptorSetLayouts.empty()) {
+            for (auto& descriptorSetLayoutBuilder : shaderReflection.getDescriptorSetLayoutBuilders()) {
+                const DescriptorSetLayout& descriptorSetLayout = m_descriptorSetLayoutCache->get(descriptorSetLayoutBuilder);
+                reflectedDescriptorSetLayouts.push_back(&descriptorSetLayout);
+                descriptorSetLayouts.push_back(descriptorSetLayout.get());
+            }
+        }
+        if (pushConstantRanges.empty()) {
+            pushConstantRanges = shaderReflection.m_pushConstantRanges;
+        }
+    }
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+    pipelineLayoutCreateInfo.setPushConstantRangeCount(pushConstantRanges.size())
+                            .setPPushConstantRanges(pushConstantRanges.data())
+                            .setSetLayoutCount(descriptorSetLayouts.size())
+                            .setPSetLayouts(descriptorSetLayouts.data());
+
+    vk::PipelineLayout pipelineLayout;
+    if (device->get().createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &pipelineLayout) != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create pipeline layout!");
+    }
+
+    // only held for creation, the cache keeps it around while another pipeline still uses the same shader
+    std::shared_ptr<const ShaderModule> shaderModule;
+    try {
+        shaderModule = device->getShaderModuleCache().get(compiledShader.m_code);
+    } catch (...) {
+        device->get().destroyPipelineLayout(pipelineLayout);
+        throw;
+    }
+
+    vk::SpecializationInfo specializationInfo = m_specializationConstants.getSpecializationInfo();
+    vk::ComputePipelineCreateInfo computePipelineCreateInfo = vk::ComputePipelineCreateInfo{}
+        .setStage(vk::PipelineShaderStageCreateInfo{}
+            .setModule(shaderModule->get())
+            .setPName("main")
+            .setStage(vk::ShaderStageFlagBits::eCompute)
+            .setPSpecializationInfo(m_specializationConstants.m_mapEntries.empty() ? nullptr : &specializationInfo))
+        .setLayout(pipelineLayout)
+        .setBasePipelineHandle(vk::Pipeline{ VK_NULL_HANDLE })
+        .setBasePipelineIndex(-1);
+    if (device->getDescriptorBackend() == Device::DescriptorBackend::eDescriptorBuffer) {
+        computePipelineCreateInfo.flags |= vk::PipelineCreateFlagBits::eDescriptorBufferEXT;
+    }
+
+    vk::Pipeline computePipeline;
+    auto res = device->get().createComputePipelines(device->getPipelineCache().get(), 1, &computePipelineCreateInfo, nullptr, &computePipeline);
+
+    if (res != vk::Result::eSuccess) {
+        device->get().destroyPipelineLayout(pipelineLayout);
+        throw std::runtime_error("Failed to create compute pipeline!");
+    }
+
+    INFO("Created a Compute Pipeline!");
+
+    return {device, computePipeline, pipelineLayout, reflectedDescriptorSetLayouts, workgroupSize};
+}
+
+// **********ComputePipeline**********
+ComputePipeline::ComputePipeline(std::shared_ptr<Device> device, const vk::Pipeline& pipeline, const vk::PipelineLayout& pipelineLayout, const std::vector<const DescriptorSetLayout *>& descriptorSetLayouts, const vk::Extent3D& workgroupSize) 
+  : m_device(device), m_pipeline(pipeline), m_pipelineLayout(pipelineLayout), m_descriptorSetLayouts(descriptorSetLayouts), m_workgroupSize(workgroupSize) {
+
+}
+
+ComputePipeline::ComputePipeline(ComputePipeline&& computePipeline) 
+  : m_device(computePipeline.m_device), m_pipeline(computePipeline.m_pipeline), m_pipelineLayout(computePipeline.m_pipelineLayout), 
+    m_descriptorSetLayouts(std::move(computePipeline.m_descriptorSetLayouts)), m_workgroupSize(computePipeline.m_workgroupSize) {
+    computePipeline.m_device = nullptr;
+    computePipeline.m_pipeline = VK_NULL_HANDLE;
+    computePipeline.m_pipelineLayout = VK_NULL_HANDLE;
+}
+
+ComputePipeline::~ComputePipeline() {
+    destroy();
+}
+
+ComputePipeline& ComputePipeline::operator=(ComputePipeline&& computePipeline) {
+    destroy();
+    m_device = computePipeline.m_device;
+    m_pipeline = computePipeline.m_pipeline;
+    m_pipelineLayout = computePipeline.m_pipelineLayout;
+    m_descriptorSetLayouts = std::move(computePipeline.m_descriptorSetLayouts);
+    m_workgroupSize = computePipeline.m_workgroupSize;
+    computePipeline.m_device = nullptr;
+    computePipeline.m_pipeline = VK_NULL_HANDLE;
+    computePipeline.m_pipelineLayout = VK_NULL_HANDLE;
+    return *this;
+}
+
+void ComputePipeline::destroy() {
+    if (!m_device) return;
+    if (m_pipelineLayout) m_device->get().destroyPipelineLayout(m_pipelineLayout);
+    if (m_pipeline) m_device->get().destroyPipeline(m_pipeline);
+    m_pipelineLayout = VK_NULL_HANDLE;
+    m_pipeline = VK_NULL_HANDLE;
+    m_device = nullptr;
+}
+
+const DescriptorSetLayout& ComputePipeline::getDescriptorSetLayout(uint32_t set) const {
+    assert(set < m_descriptorSetLayouts.size() && "Pipeline was not built with reflection or does not use this set!");
+    return *m_descriptorSetLayouts[set];
+}
+
+void ComputePipeline::bind(const CommandBuffer& commandBuffer) const {
+    commandBuffer.get().bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline);
+}
+
+void ComputePipeline::dispatch(const CommandBuffer& commandBuffer, uint32_t threadCountX, uint32_t threadCountY, uint32_t threadCountZ) const {
+    commandBuffer.dispatchThreads(vk::Extent3D{threadCountX, threadCountY, threadCountZ}, m_workgroupSize);
+}
+
 } // namespace gfx
@@ -5,21 +5,85 @@
 #include "renderpass.hpp"
 #include "commandbuffer.hpp"
 #include "descriptors.hpp"
+#include "shader.hpp"
+#include "shaderpermutations.hpp"
+#include "reflection.hpp"
 
 #include <filesystem>
+#include <map>
+#include <optional>
+#include <type_traits>
 #include <set>
 #include <string>
 
 namespace gfx {
 
+// the specialization constant values of one shader stage, laid out the way vk::SpecializationInfo wants them
+struct SpecializationConstants {
+    // bools become VkBool32, setting the same id again overwrites it
+    template <typename T>
+    void set(uint32_t constantId, const T& value) {
+        if constexpr (std::is_same_v<T, bool>) {
+            set(constantId, static_cast<vk::Bool32>(value));
+        } else {
+            static_assert(std::is_arithmetic_v<T> && (sizeof(T) == 4 || sizeof(T) == 8), "Specialization constants are 32 or 64 bit scalars!");
+            set(constantId, &value, sizeof(T));
+        }
+    }
+    void set(uint32_t constantId, const void *data, size_t size);
+
+    // nullopt when the constant was not set or was set with a different size
+    template <typename T>
+    std::optional<T> get(uint32_t constantId) const {
+        static_assert(std::is_trivially_copyable_v<T>, "Specialization constants are read as raw bytes!");
+        T value;
+        if (!get(constantId, &value, sizeof(T))) return std::nullopt;
+        return value;
+    }
+    bool get(uint32_t constantId, void *data, size_t size) const;
+
+    // points into this, keep it alive and unchanged while the info is in use
+    vk::SpecializationInfo getSpecializationInfo() const;
+
+    std::vector<vk::SpecializationMapEntry> m_mapEntries;
+    std::vector<uint8_t> m_data;
+};
+
 class GraphicsPipeline {
 public:
     struct Builder {
         Builder();
         Builder& addShaderFromPath(const std::filesystem::path& shaderPath);
+        // for shaders that need defines or a stage not implied by the extension
+        Builder& addShader(const ShaderCompiler::CompileInfo& compileInfo);
+        // a variant of a permuted shader, shares the compilation with every other request for the same variant
+        // note: compiled with the settings of the permutations' base compile info, setShaderOptimizationLevel does not apply
+        Builder& addShader(ShaderPermutations& shaderPermutations, ShaderPermutations::VariantMask variantMask);
+        // spirv compiled offline (see engine_embed_shaders), the code is copied
+        // note: there is no source to go back to, hot reload leaves these shaders as they are
+        Builder& addShaderFromSpirv(std::span<const uint32_t> code, vk::ShaderStageFlagBits stage);
+        // for the shaders of this pipeline that do not set their own, instead of the ShaderCompiler default
+        Builder& setShaderOptimizationLevel(ShaderCompiler::OptimizationLevel optimizationLevel);
+
+        // the value of the constant declared with layout(constant_id = constantId) in the shader of stage
+        template <typename T>
+        Builder& setSpecializationConstant(vk::ShaderStageFlagBits stage, uint32_t constantId, const T& value) {
+            m_specializationConstants[stage].set(constantId, value);
+            return *this;
+        }
         
         // dynamic states
         Builder& addDynamicState(vk::DynamicState dynamicState);
+        // on by default, viewport and scissor are set on the command buffer instead of baked in so a resize needs no rebuild
+        // the viewports and scissors added only decide the count then
+        Builder& setDynamicViewportScissor(bool enable);
+        // makes the cull mode, front face and topology (extended dynamic state), rasterizer discard, depth bias enable and
+        // primitive restart (extended dynamic state 2) and polygon mode (extended dynamic state 3) dynamic where the device supports it,
+        // so pipelines that only differ in those collapse into one; set them on the command buffer after binding
+        // note: without dynamicPrimitiveTopologyUnrestricted the topology can only change within its class (points, lines, triangles)
+        Builder& setExtendedDynamicState(bool enable);
+        // the explicit ones plus everything made dynamic above that the device supports
+        std::vector<vk::DynamicState> getDynamicStates(const Device& device) const;
         
         // pipeline input assembly
         Builder& setInputAssemblyTopology(vk::PrimitiveTopology topology);
@@ -64,6 +128,11 @@ public:
         Builder& addPushConstantRangeLayout(const vk::PushConstantRange& pushConstantRange);
         Builder& addDescriptorSetLayout(const DescriptorSetLayout& descriptorSetLayout);
 
+        // reflect the compiled shaders for whatever was not set explicitly: descriptor set layouts (taken from the cache),
+        // push constant ranges and a single interleaved vertex input binding
+        // note: uniform / storage buffers reflect as non dynamic, add the layouts explicitly for dynamic ones
+        Builder& setReflection(DescriptorSetLayoutCache& descriptorSetLayoutCache);
+
         // TODO: add setVertexInput 
         Builder& addVertexInputBindingDescription(const vk::VertexInputBindingDescription& vertexInputBindingDescription);
         Builder& addVertexInputAttributeDescription(const vk::VertexInputAttributeDescription& vertexInputAttributeDescription);
@@ -72,13 +141,59 @@ public:
         Builder& setRenderPass(const RenderPass& renderPass);
 
 
+        // starts compiling the shaders on the ShaderCompiler worker pool and returns right away,
+        // call it on every builder before building any of them so stages of different pipelines compile in parallel
+        // build calls it itself if it was not called
+        Builder& compileShadersAsync();
+
+        // everything a vk::GraphicsPipelineCreateInfo points at besides the builder itself,
+        // fill in place and keep it and the builder alive until the pipeline is created
+        struct Prepared {
+            Prepared() = default;
+            Prepared(const Prepared&) = delete;
+            Prepared& operator=(const Prepared&) = delete;
+
+            // for when pipeline creation fails, on success ownership passes to the GraphicsPipeline
+            void destroy(const Device& device);
+
+            vk::PipelineLayout pipelineLayout;
+            // what pipelineLayout was created from
+            std::vector<vk::DescriptorSetLayout> setLayouts;
+            std::vector<vk::PushConstantRange> pushConstantRanges;
+            // shared through the device's ShaderModuleCache
+            std::vector<std::shared_ptr<const ShaderModule>> shaderModules;
+            // only filled by reflection
+            std::vector<const DescriptorSetLayout *> descriptorSetLayouts;
+            std::vector<vk::VertexInputBindingDescription> vertexInputBindingDescriptions;
+            std::vector<vk::VertexInputAttributeDescription> vertexInputAttributeDescriptions;
+            std::vector<vk::SpecializationInfo> specializationInfos;
+            std::vector<vk::PipelineShaderStageCreateInfo> pipelineShaderStageCreateInfos;
+            vk::PipelineVertexInputStateCreateInfo vertexInput;
+            vk::PipelineViewportStateCreateInfo viewportState;
+            std::vector<vk::DynamicState> dynamicStates;
+            vk::PipelineDynamicStateCreateInfo dynamicState;
+            vk::GraphicsPipelineCreateInfo graphicsPipelineCreateInfo;
+        };
+        // creates the layout and shader modules, waits for the shaders if they are still compiling
+        // whoever creates the pipeline from prepared records the builder into the device's manifest once that succeeded
+        void prepare(std::shared_ptr<Device> device, Prepared& prepared);
+
         GraphicsPipeline build(std::shared_ptr<Device> device);
-        // GraphicsProgram buildComputeProgram(const Context *device);
+
+        // a pipeline takes one shader per stage
+        bool hasShaderStage(vk::ShaderStageFlagBits stage) const;
 
         // TODO: add depth stencil state
 
-        std::set<std::filesystem::path> m_shaderPaths;
+        std::vector<ShaderCompiler::CompileInfo> m_shaderCompileInfos;
+        std::optional<ShaderCompiler::OptimizationLevel> m_shaderOptimizationLevel;
+        std::map<vk::ShaderStageFlagBits, SpecializationConstants> m_specializationConstants;
+        // compilations started elsewhere (shader permutations) or offline (spirv, the compile info has no path then), by index into m_shaderCompileInfos
+        std::map<size_t, std::shared_future<ShaderCompiler::Result>> m_requestedShaders;
+        std::vector<std::shared_future<ShaderCompiler::Result>> m_compiledShaders;
         std::vector<vk::DynamicState> m_dynamicStates;
+        bool m_dynamicViewportScissor = true;
+        bool m_extendedDynamicState = false;
         vk::PipelineInputAssemblyStateCreateInfo m_pipelineInputAssemblyStateCreateInfo;
         std::vector<vk::Viewport> m_viewports;
         std::vector<vk::Rect2D> m_scissors;
@@ -89,33 +204,137 @@ public:
         vk::PipelineColorBlendStateCreateInfo m_pipelineColorBlendStateCreateInfo;
         std::vector<vk::PushConstantRange> m_pushConstantRanges;
         std::vector<vk::DescriptorSetLayout> m_descriptorSetLayout;
+        // bindings and flags of what m_descriptorSetLayout was added from, for the pipeline manifest
+        // copied since the layouts may be gone by the time a kept builder is rebuilt
+        std::vector<DescriptorSetLayout::Builder> m_explicitDescriptorSetLayouts;
         std::vector<vk::SubpassDescription> m_subpassDescriptions;
         std::vector<vk::AttachmentDescription> m_attachmentDescriptions;
         std::vector<vk::VertexInputBindingDescription> m_vertexInputBindingDescriptions;
         std::vector<vk::VertexInputAttributeDescription> m_vertexInputAttributeDescriptions;
 
         vk::RenderPass m_renderPass;
+        uint64_t m_renderPassCompatibilityHash = 0;
+        DescriptorSetLayoutCache *m_descriptorSetLayoutCache = nullptr;
     };
 
-    GraphicsPipeline() : m_device(nullptr), m_pipeline(VK_NULL_HANDLE), m_pipelineLayout(VK_NULL_HANDLE), m_shaderModules{} {}
+    GraphicsPipeline() : m_device(nullptr), m_pipeline(VK_NULL_HANDLE), m_pipelineLayout(VK_NULL_HANDLE), m_shaderModules{}, m_descriptorSetLayouts{}, m_dynamicStates{} {}
 
     ~GraphicsPipeline();
 
+    GraphicsPipeline(GraphicsPipeline&& graphicsPipeline);
+    GraphicsPipeline(const GraphicsPipeline&) = delete;
+
+    GraphicsPipeline& operator=(GraphicsPipeline&& graphicsPipeline);
+
     // TODO: add direct shader string compilation
     // void addShader(const std::string& shaderName, const std::string& shaderSource);
 
     void bind(const CommandBuffer& commandBuffer);
 
     vk::PipelineLayout getPipelineLayout() const { return m_pipelineLayout; }
+    vk::Pipeline get() const { return m_pipeline; }
+    // only for pipelines built with reflection, the layout to allocate sets for this pipeline from
+    const DescriptorSetLayout& getDescriptorSetLayout(uint32_t set) const;
+    // whether the state has to be set on the command buffer after binding
+    bool hasDynamicState(vk::DynamicState dynamicState) const;
+
+private:
+    friend class PipelineBatch;
+    friend class PipelineLibrary;
+
+    // takes ownership of the layout of prepared and shares its shader modules
+    GraphicsPipeline(std::shared_ptr<Device> device, const vk::Pipeline& pipeline, const Builder::Prepared& prepared);
+
+    void destroy();
 
 private:
-    GraphicsPipeline(std::shared_ptr<Device> device, const vk::Pipeline& pipeline, const vk::PipelineLayout& pipelineLayout, const std::vector<vk::ShaderModule>& shaderModules);
+    std::shared_ptr<Device> m_device;
+    vk::Pipeline m_pipeline;
+    vk::PipelineLayout m_pipelineLayout;
+    std::vector<std::shared_ptr<const ShaderModule>> m_shaderModules;
+    std::vector<const DescriptorSetLayout *> m_descriptorSetLayouts;
+    std::vector<vk::DynamicState> m_dynamicStates;
+};
+
+class ComputePipeline {
+public:
+    struct Builder {
+        Builder();
+        Builder& setShaderFromPath(const std::filesystem::path& shaderPath);
+        Builder& setShader(const ShaderCompiler::CompileInfo& compileInfo);
+        // spirv compiled offline (see engine_embed_shaders), the code is copied
+        Builder& setShaderFromSpirv(std::span<const uint32_t> code);
+        // when the shader does not set its own, instead of the ShaderCompiler default
+        Builder& setShaderOptimizationLevel(ShaderCompiler::OptimizationLevel optimizationLevel);
+
+        // the value of the constant declared with layout(constant_id = constantId) in the shader
+        template <typename T>
+        Builder& setSpecializationConstant(uint32_t constantId, const T& value) {
+            m_specializationConstants.set(constantId, value);
+            return *this;
+        }
+        // overrides the workgroup size dispatch rounds by, otherwise it is reflected from the shader
+        // with the specialization constants of this builder applied to the local_size_*_id dimensions
+        Builder& setWorkgroupSize(const vk::Extent3D& workgroupSize);
+
+        // pipeline layout create info
+        Builder& addPushConstantRangeLayout(const vk::PushConstantRange& pushConstantRange);
+        Builder& addDescriptorSetLayout(const DescriptorSetLayout& descriptorSetLayout);
+
+        // reflect the shader for the descriptor set layouts (taken from the cache) and push constant ranges that were not set explicitly
+        Builder& setReflection(DescriptorSetLayoutCache& descriptorSetLayoutCache);
+
+        // starts compiling the shader on the ShaderCompiler worker pool, build calls it itself if it was not called
+        Builder& compileShaderAsync();
+
+        ComputePipeline build(std::shared_ptr<Device> device);
+
+        std::optional<ShaderCompiler::CompileInfo> m_shaderCompileInfo;
+        std::optional<ShaderCompiler::OptimizationLevel> m_shaderOptimizationLevel;
+        std::shared_future<ShaderCompiler::Result> m_compiledShader;
+        SpecializationConstants m_specializationConstants;
+        std::optional<vk::Extent3D> m_workgroupSize;
+        std::vector<vk::PushConstantRange> m_pushConstantRanges;
+        std::vector<vk::DescriptorSetLayout> m_descriptorSetLayout;
+        DescriptorSetLayoutCache *m_descriptorSetLayoutCache = nullptr;
+    };
+
+    ComputePipeline() : m_device(nullptr), m_pipeline(VK_NULL_HANDLE), m_pipelineLayout(VK_NULL_HANDLE), m_descriptorSetLayouts{}, m_workgroupSize{1, 1, 1} {}
+
+    ~ComputePipeline();
+
+    ComputePipeline(ComputePipeline&& computePipeline);
+    ComputePipeline(const ComputePipeline&) = delete;
+
+    ComputePipeline& operator=(ComputePipeline&& computePipeline);
+
+    void bind(const CommandBuffer& commandBuffer) const;
+    // dispatches enough workgroups to cover threadCount threads, the shader has to bounds check the partial ones
+    void dispatch(const CommandBuffer& commandBuffer, uint32_t threadCountX, uint32_t threadCountY = 1, uint32_t threadCountZ = 1) const;
+
+    template <typename T>
+    void pushConstants(const CommandBuffer& commandBuffer, const T& value, uint32_t offset = 0) const {
+        commandBuffer.pushConstants(m_pipelineLayout, vk::ShaderStageFlagBits::eCompute, value, offset);
+    }
+
+    vk::PipelineLayout getPipelineLayout() const { return m_pipelineLayout; }
+    vk::Pipeline get() const { return m_pipeline; }
+    // only for pipelines built with reflection, the layout to allocate sets for this pipeline from
+    const DescriptorSetLayout& getDescriptorSetLayout(uint32_t set) const;
+    // the local size declared by the shader or set on the builder, 1 x 1 x 1 when neither is known
+    const vk::Extent3D& getWorkgroupSize() const { return m_workgroupSize; }
+
+private:
+    ComputePipeline(std::shared_ptr<Device> device, const vk::Pipeline& pipeline, const vk::PipelineLayout& pipelineLayout, const std::vector<const DescriptorSetLayout *>& descriptorSetLayouts, const vk::Extent3D& workgroupSize);
+
+    void destroy();
 
 private:
     std::shared_ptr<Device> m_device;
     vk::Pipeline m_pipeline;
     vk::PipelineLayout m_pipelineLayout;
-    std::vector<vk::ShaderModule> m_shaderModules;
+    std::vector<const DescriptorSetLayout *> m_descriptorSetLayouts;
+    vk::Extent3D m_workgroupSize;
 };
 
 } // namespace gfx
@@ -0,0 +1,155 @@
+#include "pipelinebatch.hpp"
+#include "pipelinemanifest.hpp"
+
+#include "../core/log.hpp"
+#include "../core/threadpool.hpp"
+
+#include <chrono>
+#include <exception>
+
+namespace gfx {
+
+PipelineBatch::PipelineBatch() : m_mode(Mode::eSingleCall), m_threadCount(0) {}
+
+PipelineBatch& PipelineBatch::add(const GraphicsPipeline::Builder& builder) {
+    m_builders.push_back(builder);
+    m_builders.back().compileShadersAsync();
+    return *this;
+}
+
+PipelineBatch& PipelineBatch::setMode(Mode mode) {
+    m_mode = mode;
+    return *this;
+}
+
+PipelineBatch& PipelineBatch::setThreadCount(uint32_t threadCount) {
+    m_threadCount = threadCount;
+    return *this;
+}
+
+// prefers the driver's numbers over the cpu measurement
+static void applyFeedback(PipelineBatch::Result& result, const vk::PipelineCreationFeedback& pipelineCreationFeedback) {
+    if (pipelineCreationFeedback.flags & vk::PipelineCreationFeedbackFlagBits::eValid) {
+        result.milliseconds = double(pipelineCreationFeedback.duration) / 1e6;
+        result.pipelineCacheHit = bool(pipelineCreationFeedback.flags & vk::PipelineCreationFeedbackFlagBits::eApplicationPipelineCacheHit);
+    }
+}
+
+std::vector<PipelineBatch::Result> PipelineBatch::build(std::shared_ptr<Device> device) {
+    if (m_builders.empty()) return {};
+
+    auto start = std::chrono::high_resolution_clock::now();
+    auto results = m_mode == Mode::eSingleCall ? buildSingleCall(device) : buildThreaded(device);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    INFO("Created {} Graphics Pipelines in {:.3f} ms", results.size(), std::chrono::duration<double, std::milli>(end - start).count());
+    return results;
+}
+
+std::vector<PipelineBatch::Result> PipelineBatch::buildSingleCall(std::shared_ptr<Device> device) {
+    const size_t count = m_builders.size();
+
+    // filled in place, the create infos point into them
+    std::vector<GraphicsPipeline::Builder::Prepared> prepared(count);
+    auto destroyPrepared = [&]() {
+        for (auto& preparedPipeline : prepared) {
+            preparedPipeline.destroy(*device);
+        }
+    };
+    try {
+        for (size_t i = 0; i < count; i++) {
+            m_builders[i].prepare(device, prepared[i]);
+        }
+    } catch (...) {
+        destroyPrepared();
+        throw;
+    }
+
+    std::vector<vk::GraphicsPipelineCreateInfo> graphicsPipelineCreateInfos(count);
+    std::vector<vk::PipelineCreationFeedback> pipelineCreationFeedbacks(count);
+    std::vector<vk::PipelineCreationFeedbackCreateInfo> pipelineCreationFeedbackCreateInfos(count);
+    for (size_t i = 0; i < count; i++) {
+        graphicsPipelineCreateInfos[i] = prepared[i].graphicsPipelineCreateInfo;
+        if (device->isPipelineCreationFeedbackSupported()) {
+            pipelineCreationFeedbackCreateInfos[i].setPPipelineCreationFeedback(&pipelineCreationFeedbacks[i]);
+            graphicsPipelineCreateInfos[i].setPNext(&pipelineCreationFeedbackCreateInfos[i]);
+        }
+    }
+
+    std::vector<vk::Pipeline> pipelines(count);
+    auto start = std::chrono::high_resolution_clock::now();
+    auto res = device->get().createGraphicsPipelines(device->getPipelineCache().get(), count, graphicsPipelineCreateInfos.data(), nullptr, pipelines.data());
+    auto end = std::chrono::high_resolution_clock::now();
+
+    if (res != vk::Result::eSuccess) {
+        // some of them may still have been created
+        for (auto pipeline : pipelines) {
+            if (pipeline) device->get().destroyPipeline(pipeline);
+        }
+        destroyPrepared();
+        throw std::runtime_error("Failed to create graphics pipelines!");
+    }
+
+    const double averageMilliseconds = std::chrono::duration<double, std::milli>(end - start).count() / count;
+    std::vector<Result> results;
+    results.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        results.push_back(Result{GraphicsPipeline{device, pipelines[i], prepared[i]}, averageMilliseconds, false});
+        applyFeedback(results.back(), pipelineCreationFeedbacks[i]);
+        device->getPipelineManifest().record(m_builders[i]);
+    }
+    return results;
+}
+
+std::vector<PipelineBatch::Result> PipelineBatch::buildThreaded(std::shared_ptr<Device> device) {
+    core::ThreadPool threadPool{m_threadCount};
+
+    std::vector<std::future<Result>> futures;
+    futures.reserve(m_builders.size());
+    for (auto& builder : m_builders) {
+        futures.push_back(threadPool.submit([&device, &builder]() {
+            GraphicsPipeline::Builder::Prepared prepared;
+            builder.prepare(device, prepared);
+
+            vk::PipelineCreationFeedback pipelineCreationFeedback{};
+            vk::PipelineCreationFeedbackCreateInfo pipelineCreationFeedbackCreateInfo = vk::PipelineCreationFeedbackCreateInfo{}
+                .setPPipelineCreationFeedback(&pipelineCreationFeedback);
+            if (device->isPipelineCreationFeedbackSupported()) {
+                prepared.graphicsPipelineCreateInfo.setPNext(&pipelineCreationFeedbackCreateInfo);
+            }
+
+            vk::Pipeline pipeline;
+            auto start = std::chrono::high_resolution_clock::now();
+            auto res = device->get().createGraphicsPipelines(device->getPipelineCache().get(), 1, &prepared.graphicsPipelineCreateInfo, nullptr, &pipeline);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            if (res != vk::Result::eSuccess) {
+                prepared.destroy(*device);
+                throw std::runtime_error("Failed to create graphics pipeline!");
+            }
+
+            Result result{GraphicsPipeline{device, pipeline, prepared}, std::chrono::duration<double, std::milli>(end - start).count(), false};
+            applyFeedback(result, pipelineCreationFeedback);
+            device->getPipelineManifest().record(builder);
+            return result;
+        }));
+    }
+
+    // every job has to finish before unwinding, they reference the builders and the device
+    std::vector<Result> results;
+    results.reserve(futures.size());
+    std::exception_ptr exception;
+    for (auto& future : futures) {
+        try {
+            results.push_back(future.get());
+        } catch (...) {
+            if (!exception) exception = std::current_exception();
+        }
+    }
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+    return results;
+}
+
+} // namespace gfx
@@ -0,0 +1,48 @@
+#ifndef GFX_PIPELINEBATCH_HPP
+#define GFX_PIPELINEBATCH_HPP
+
+#include "pipeline.hpp"
+
+#include <vector>
+
+namespace gfx {
+
+// creates a whole set of pipelines (eg. everything a level needs) as one operation, all through the device's pipeline cache
+class PipelineBatch {
+public:
+    enum class Mode {
+        eSingleCall,  // one vkCreateGraphicsPipelines call with every create info, the driver may parallelize internally
+        eThreaded,    // every pipeline is created by its own job on a worker pool
+    };
+
+    struct Result {
+        GraphicsPipeline pipeline;
+        // driver reported when pipeline creation feedback is supported, otherwise measured on the cpu
+        // (in eSingleCall mode the total is split evenly since the call cannot be timed per pipeline)
+        double milliseconds;
+        bool pipelineCacheHit;  // only known with pipeline creation feedback
+    };
+
+    PipelineBatch();
+
+    // the builder is copied, shader compilation for it starts right away
+    PipelineBatch& add(const GraphicsPipeline::Builder& builder);
+    PipelineBatch& setMode(Mode mode);
+    // eThreaded only, 0 picks one thread per core
+    PipelineBatch& setThreadCount(uint32_t threadCount);
+
+    // results are in the order the builders were added, throws if any pipeline fails (the others are destroyed)
+    std::vector<Result> build(std::shared_ptr<Device> device);
+
+    std::vector<GraphicsPipeline::Builder> m_builders;
+    Mode m_mode;
+    uint32_t m_threadCount;
+
+private:
+    std::vector<Result> buildSingleCall(std::shared_ptr<Device> device);
+    std::vector<Result> buildThreaded(std::shared_ptr<Device> device);
+};
+
+} // namespace gfx
+
+#endif
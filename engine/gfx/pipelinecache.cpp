@@ -0,0 +1,103 @@
+#include "pipelinecache.hpp"
+
+#include "../core/log.hpp"
+#include "../core/file.hpp"
+
+#include <cstring>
+
+namespace gfx {
+
+PipelineCache::PipelineCache(vk::Device device, const vk::PhysicalDeviceProperties& physicalDeviceProperties, const std::filesystem::path& path) 
+  : m_device(device), m_pipelineCache(VK_NULL_HANDLE), m_vendorID(physicalDeviceProperties.vendorID), m_deviceID(physicalDeviceProperties.deviceID), m_path(path) {
+    std::memcpy(m_pipelineCacheUUID.data(), physicalDeviceProperties.pipelineCacheUUID.data(), VK_UUID_SIZE);
+
+    std::optional<std::string> data;
+    if (!m_path.empty()) {
+        data = core::tryReadFile(m_path);
+        if (data && !isCompatible(*data)) {
+            INFO("Discarding pipeline cache {}, it was written by a different device or driver", m_path.string());
+            data.reset();
+        }
+    }
+
+    vk::PipelineCacheCreateInfo pipelineCacheCreateInfo = vk::PipelineCacheCreateInfo{};
+    if (data) {
+        pipelineCacheCreateInfo.setInitialDataSize(data->size())
+                               .setPInitialData(data->data());
+    }
+    auto res = m_device.createPipelineCache(&pipelineCacheCreateInfo, nullptr, &m_pipelineCache);
+    if (res != vk::Result::eSuccess && data) {
+        // the header looked fine but the driver rejected the blob, start over empty
+        pipelineCacheCreateInfo.setInitialDataSize(0)
+                               .setPInitialData(nullptr);
+        res = m_device.createPipelineCache(&pipelineCacheCreateInfo, nullptr, &m_pipelineCache);
+        data.reset();
+    }
+    if (res != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create Pipeline Cache!");
+    }
+    INFO("Created Pipeline Cache! ({})", data ? "loaded " + std::to_string(data->size()) + " bytes from " + m_path.string() : "empty");
+}
+
+PipelineCache::PipelineCache(PipelineCache&& pipelineCache) 
+  : m_device(pipelineCache.m_device), m_pipelineCache(pipelineCache.m_pipelineCache), m_vendorID(pipelineCache.m_vendorID), m_deviceID(pipelineCache.m_deviceID), 
+    m_pipelineCacheUUID(pipelineCache.m_pipelineCacheUUID), m_path(std::move(pipelineCache.m_path)) {
+    pipelineCache.m_device = VK_NULL_HANDLE;
+    pipelineCache.m_pipelineCache = VK_NULL_HANDLE;
+}
+
+PipelineCache::~PipelineCache() {
+    if (m_pipelineCache) m_device.destroyPipelineCache(m_pipelineCache);
+    m_device = VK_NULL_HANDLE;
+    m_pipelineCache = VK_NULL_HANDLE;
+}
+
+PipelineCache& PipelineCache::operator=(PipelineCache&& pipelineCache) {
+    if (m_pipelineCache) m_device.destroyPipelineCache(m_pipelineCache);
+    m_device = pipelineCache.m_device;
+    m_pipelineCache = pipelineCache.m_pipelineCache;
+    m_vendorID = pipelineCache.m_vendorID;
+    m_deviceID = pipelineCache.m_deviceID;
+    m_pipelineCacheUUID = pipelineCache.m_pipelineCacheUUID;
+    m_path = std::move(pipelineCache.m_path);
+    pipelineCache.m_device = VK_NULL_HANDLE;
+    pipelineCache.m_pipelineCache = VK_NULL_HANDLE;
+    return *this;
+}
+
+bool PipelineCache::isCompatible(const std::string& data) const {
+    vk::PipelineCacheHeaderVersionOne header;
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    return header.headerSize >= sizeof(header) &&
+           header.headerVersion == vk::PipelineCacheHeaderVersion::eOne &&
+           header.vendorID == m_vendorID &&
+           header.deviceID == m_deviceID &&
+           std::memcmp(header.pipelineCacheUUID.data(), m_pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+}
+
+bool PipelineCache::save() const {
+    if (!m_pipelineCache || m_path.empty()) {
+        return false;
+    }
+    size_t size = 0;
+    if (m_device.getPipelineCacheData(m_pipelineCache, &size, nullptr) != vk::Result::eSuccess) {
+        WARN("Failed to query Pipeline Cache size!");
+        return false;
+    }
+    std::string data(size, '\0');
+    if (m_device.getPipelineCacheData(m_pipelineCache, &size, data.data()) != vk::Result::eSuccess) {
+        WARN("Failed to get Pipeline Cache data!");
+        return false;
+    }
+    data.resize(size);
+    if (!core::writeFileAtomic(m_path, data)) {
+        return false;
+    }
+    INFO("Saved Pipeline Cache to {} ({} bytes)", m_path.string(), size);
+    return true;
+}
+
+} // namespace gfx
@@ -0,0 +1,46 @@
+#ifndef GFX_PIPELINECACHE_HPP
+#define GFX_PIPELINECACHE_HPP
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <filesystem>
+#include <string>
+
+namespace gfx {
+
+// vk::PipelineCache persisted to disk, owned by Device and passed to every pipeline creation
+// created from a vk::Device rather than through a Builder since Device itself creates it
+class PipelineCache {
+public:
+    PipelineCache() : m_device(VK_NULL_HANDLE), m_pipelineCache(VK_NULL_HANDLE) {}
+    // loads the blob at path if it was written by the same driver and device, an empty path keeps the cache in memory only
+    PipelineCache(vk::Device device, const vk::PhysicalDeviceProperties& physicalDeviceProperties, const std::filesystem::path& path);
+
+    ~PipelineCache();
+
+    PipelineCache(PipelineCache&& pipelineCache);
+    PipelineCache(const PipelineCache&) = delete;
+
+    PipelineCache& operator=(PipelineCache&& pipelineCache);
+
+    vk::PipelineCache get() const { return m_pipelineCache; }
+
+    // writes the blob atomically, cheap enough to call periodically (eg. after a loading screen), not only at shutdown
+    bool save() const;
+
+private:
+    bool isCompatible(const std::string& data) const;
+
+private:
+    vk::Device m_device;
+    vk::PipelineCache m_pipelineCache;
+    uint32_t m_vendorID = 0;
+    uint32_t m_deviceID = 0;
+    std::array<uint8_t, VK_UUID_SIZE> m_pipelineCacheUUID{};
+    std::filesystem::path m_path;
+};
+
+} // namespace gfx
+
+#endif
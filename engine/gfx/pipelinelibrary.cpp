@@ -0,0 +1,294 @@
+#include "pipelinelibrary.hpp"
+#include "pipelinemanifest.hpp"
+
+#include "../core/hash.hpp"
+
+namespace gfx {
+
+static void addShaderStage(core::KeyWriter& key, const GraphicsPipeline::Builder& builder, size_t index) {
+    const ShaderCompiler::Result& compiledShader = builder.m_compiledShaders[index].get();
+    // the code itself rather than a hash of it, the parts are shared so a collision would not be caught
+    key.add(compiledShader.m_stage).addVector(compiledShader.m_code);
+    auto specializationConstants = builder.m_specializationConstants.find(compiledShader.m_stage);
+    if (specializationConstants != builder.m_specializationConstants.end()) {
+        key.addVector(specializationConstants->second.m_mapEntries).addVector(specializationConstants->second.m_data);
+    } else {
+        key.add(uint64_t{0});
+    }
+}
+
+static void addPipelineLayout(core::KeyWriter& key, const GraphicsPipeline::Builder::Prepared& prepared) {
+    key.addVector(prepared.setLayouts).addVector(prepared.pushConstantRanges);
+}
+
+static void addMultisample(core::KeyWriter& key, const GraphicsPipeline::Builder& builder) {
+    auto& multisample = builder.m_pipelineMultisampleStateCreateInfo;
+    key.add(multisample.rasterizationSamples)
+       .add(multisample.sampleShadingEnable)
+       .add(multisample.minSampleShading)
+       .add(multisample.alphaToCoverageEnable)
+       .add(multisample.alphaToOneEnable);
+}
+
+PipelineLibrary::PipelineLibrary(std::shared_ptr<Device> device)
+  : m_device(device), m_statistics{}, m_threadPool(std::make_unique<core::ThreadPool>(1)) {
+    if (!isSupported()) {
+        WARN("VK_EXT_graphics_pipeline_library not supported, pipelines are built whole");
+    }
+}
+
+PipelineLibrary::~PipelineLibrary() {
+    m_threadPool.reset();
+    for (auto& [key, part] : m_parts) {
+        m_device->get().destroyPipeline(part);
+    }
+    for (auto& [key, pipelineLayout] : m_pipelineLayouts) {
+        m_device->get().destroyPipelineLayout(pipelineLayout);
+    }
+}
+
+PipelineLibrary::Result PipelineLibrary::link(GraphicsPipeline::Builder& builder, bool optimize) {
+    if (!isSupported()) {
+        return {builder.build(m_device), {}};
+    }
+
+    GraphicsPipeline::Builder::Prepared prepared;
+    builder.prepare(m_device, prepared);
+
+    // every part gets every dynamic state, the ones that do not concern a part are ignored by it
+    std::array<core::KeyWriter, 4> keys;
+    for (size_t i = 0; i < keys.size(); i++) {
+        keys[i].add(static_cast<uint32_t>(i)).addVector(prepared.dynamicStates);
+    }
+
+    auto& vertexInputKey = keys[static_cast<size_t>(Part::eVertexInput)];
+    vertexInputKey.add(static_cast<uint64_t>(prepared.vertexInput.vertexBindingDescriptionCount));
+    for (uint32_t i = 0; i < prepared.vertexInput.vertexBindingDescriptionCount; i++) {
+        vertexInputKey.add(prepared.vertexInput.pVertexBindingDescriptions[i]);
+    }
+    vertexInputKey.add(static_cast<uint64_t>(prepared.vertexInput.vertexAttributeDescriptionCount));
+    for (uint32_t i = 0; i < prepared.vertexInput.vertexAttributeDescriptionCount; i++) {
+        vertexInputKey.add(prepared.vertexInput.pVertexAttributeDescriptions[i]);
+    }
+    vertexInputKey.add(builder.m_pipelineInputAssemblyStateCreateInfo.topology)
+                  .add(builder.m_pipelineInputAssemblyStateCreateInfo.primitiveRestartEnable);
+
+    auto& preRasterizationKey = keys[static_cast<size_t>(Part::ePreRasterizationShaders)];
+    auto& fragmentShaderKey = keys[static_cast<size_t>(Part::eFragmentShader)];
+    for (size_t i = 0; i < builder.m_compiledShaders.size(); i++) {
+        bool fragment = builder.m_compiledShaders[i].get().m_stage == vk::ShaderStageFlagBits::eFragment;
+        addShaderStage(fragment ? fragmentShaderKey : preRasterizationKey, builder, i);
+    }
+    if (builder.m_dynamicViewportScissor) {
+        preRasterizationKey.add(prepared.viewportState.viewportCount).add(prepared.viewportState.scissorCount);
+    } else {
+        preRasterizationKey.addVector(builder.m_viewports).addVector(builder.m_scissors);
+    }
+    auto& rasterization = builder.m_pipelineRasterizationStateCreateInfo;
+    preRasterizationKey.add(rasterization.depthClampEnable)
+                       .add(rasterization.rasterizerDiscardEnable)
+                       .add(rasterization.polygonMode)
+                       .add(rasterization.cullMode)
+                       .add(rasterization.frontFace)
+                       .add(rasterization.depthBiasEnable)
+                       .add(rasterization.depthBiasConstantFactor)
+                       .add(rasterization.depthBiasClamp)
+                       .add(rasterization.depthBiasSlopeFactor)
+                       .add(rasterization.lineWidth);
+    addPipelineLayout(preRasterizationKey, prepared);
+    preRasterizationKey.add(builder.m_renderPassCompatibilityHash);
+
+    addMultisample(fragmentShaderKey, builder);
+    addPipelineLayout(fragmentShaderKey, prepared);
+    fragmentShaderKey.add(builder.m_renderPassCompatibilityHash);
+
+    auto& fragmentOutputKey = keys[static_cast<size_t>(Part::eFragmentOutputInterface)];
+    auto& colorBlend = builder.m_pipelineColorBlendStateCreateInfo;
+    fragmentOutputKey.addVector(builder.m_pipelineColorBlendAttachmentStates)
+                     .add(colorBlend.logicOpEnable)
+                     .add(colorBlend.logicOp)
+                     .add(colorBlend.blendConstants);
+    addMultisample(fragmentOutputKey, builder);
+    fragmentOutputKey.add(builder.m_renderPassCompatibilityHash);
+
+    std::array<vk::Pipeline, 4> parts;
+    vk::Pipeline pipeline;
+    try {
+        for (size_t i = 0; i < parts.size(); i++) {
+            parts[i] = getPart(static_cast<Part>(i), keys[i].get(), builder, prepared);
+        }
+        pipeline = linkParts(parts, prepared.pipelineLayout, false);
+    } catch (...) {
+        prepared.destroy(*m_device);
+        throw;
+    }
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_statistics.links++;
+    }
+
+    Result result{GraphicsPipeline{m_device, pipeline, prepared}, {}};
+    m_device->getPipelineManifest().record(builder);
+
+    if (optimize) {
+        result.optimized = m_threadPool->submit([this, parts, setLayouts = prepared.setLayouts, pushConstantRanges = prepared.pushConstantRanges,
+                                                 descriptorSetLayouts = prepared.descriptorSetLayouts, dynamicStates = prepared.dynamicStates]() {
+            // the optimized pipeline owns a layout of its own, the fast linked one may be gone by the time this is swapped in
+            GraphicsPipeline::Builder::Prepared optimizedPrepared;
+            optimizedPrepared.setLayouts = setLayouts;
+            optimizedPrepared.pushConstantRanges = pushConstantRanges;
+            optimizedPrepared.descriptorSetLayouts = descriptorSetLayouts;
+            optimizedPrepared.dynamicStates = dynamicStates;
+
+            vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo = vk::PipelineLayoutCreateInfo{}
+                .setSetLayoutCount(optimizedPrepared.setLayouts.size())
+                .setPSetLayouts(optimizedPrepared.setLayouts.data())
+                .setPushConstantRangeCount(optimizedPrepared.pushConstantRanges.size())
+                .setPPushConstantRanges(optimizedPrepared.pushConstantRanges.data());
+            if (m_device->get().createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &optimizedPrepared.pipelineLayout) != vk::Result::eSuccess) {
+                throw std::runtime_error("Failed to create pipeline layout!");
+            }
+
+            vk::Pipeline optimizedPipeline;
+            try {
+                optimizedPipeline = linkParts(parts, optimizedPrepared.pipelineLayout, true);
+            } catch (...) {
+                optimizedPrepared.destroy(*m_device);
+                throw;
+            }
+            return GraphicsPipeline{m_device, optimizedPipeline, optimizedPrepared};
+        });
+    }
+
+    return result;
+}
+
+PipelineLibrary::Statistics PipelineLibrary::getStatistics() const {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_statistics;
+}
+
+vk::Pipeline PipelineLibrary::getPart(Part part, const std::string& key, const GraphicsPipeline::Builder& builder, const GraphicsPipeline::Builder::Prepared& prepared) {
+    // parts are created under the lock, they are few and each is only ever created once
+    std::lock_guard<std::mutex> lock{m_mutex};
+    auto cachedPart = m_parts.find(key);
+    if (cachedPart != m_parts.end()) {
+        m_statistics.partHits++;
+        return cachedPart->second;
+    }
+    m_statistics.partMisses++;
+    vk::Pipeline pipeline = createPart(part, builder, prepared);
+    m_parts.emplace(key, pipeline);
+    return pipeline;
+}
+
+vk::Pipeline PipelineLibrary::createPart(Part part, const GraphicsPipeline::Builder& builder, const GraphicsPipeline::Builder::Prepared& prepared) {
+    vk::GraphicsPipelineLibraryCreateInfoEXT graphicsPipelineLibraryCreateInfo;
+    vk::GraphicsPipelineCreateInfo graphicsPipelineCreateInfo = vk::GraphicsPipelineCreateInfo{}
+        .setPNext(&graphicsPipelineLibraryCreateInfo)
+        .setFlags(vk::PipelineCreateFlagBits::eLibraryKHR | vk::PipelineCreateFlagBits::eRetainLinkTimeOptimizationInfoEXT)
+        .setPDynamicState(&prepared.dynamicState)
+        .setBasePipelineIndex(-1);
+    if (m_device->getDescriptorBackend() == Device::DescriptorBackend::eDescriptorBuffer) {
+        graphicsPipelineCreateInfo.flags |= vk::PipelineCreateFlagBits::eDescriptorBufferEXT;
+    }
+
+    std::vector<vk::PipelineShaderStageCreateInfo> pipelineShaderStageCreateInfos;
+    auto addStages = [&](bool fragment) {
+        for (auto& pipelineShaderStageCreateInfo : prepared.pipelineShaderStageCreateInfos) {
+            if ((pipelineShaderStageCreateInfo.stage == vk::ShaderStageFlagBits::eFragment) == fragment) {
+                pipelineShaderStageCreateInfos.push_back(pipelineShaderStageCreateInfo);
+            }
+        }
+        graphicsPipelineCreateInfo.setStageCount(pipelineShaderStageCreateInfos.size())
+                                  .setPStages(pipelineShaderStageCreateInfos.data());
+    };
+
+    switch (part) {
+        case Part::eVertexInput:
+            graphicsPipelineLibraryCreateInfo.setFlags(vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface);
+            graphicsPipelineCreateInfo.setPVertexInputState(&prepared.vertexInput)
+                                      .setPInputAssemblyState(&builder.m_pipelineInputAssemblyStateCreateInfo);
+            break;
+        case Part::ePreRasterizationShaders:
+            graphicsPipelineLibraryCreateInfo.setFlags(vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders);
+            addStages(false);
+            graphicsPipelineCreateInfo.setPViewportState(&prepared.viewportState)
+                                      .setPRasterizationState(&builder.m_pipelineRasterizationStateCreateInfo)
+                                      .setLayout(getPipelineLayout(prepared))
+                                      .setRenderPass(builder.m_renderPass)
+                                      .setSubpass(0);
+            break;
+        case Part::eFragmentShader:
+            graphicsPipelineLibraryCreateInfo.setFlags(vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader);
+            addStages(true);
+            graphicsPipelineCreateInfo.setPMultisampleState(&builder.m_pipelineMultisampleStateCreateInfo)
+                                      .setPDepthStencilState(nullptr)
+                                      .setLayout(getPipelineLayout(prepared))
+                                      .setRenderPass(builder.m_renderPass)
+                                      .setSubpass(0);
+            break;
+        case Part::eFragmentOutputInterface:
+            graphicsPipelineLibraryCreateInfo.setFlags(vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface);
+            graphicsPipelineCreateInfo.setPColorBlendState(&builder.m_pipelineColorBlendStateCreateInfo)
+                                      .setPMultisampleState(&builder.m_pipelineMultisampleStateCreateInfo)
+                                      .setRenderPass(builder.m_renderPass)
+                                      .setSubpass(0);
+            break;
+    }
+
+    vk::Pipeline pipeline;
+    if (m_device->get().createGraphicsPipelines(m_device->getPipelineCache().get(), 1, &graphicsPipelineCreateInfo, nullptr, &pipeline) != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create graphics pipeline library!");
+    }
+    return pipeline;
+}
+
+vk::PipelineLayout PipelineLibrary::getPipelineLayout(const GraphicsPipeline::Builder::Prepared& prepared) {
+    core::KeyWriter key;
+    addPipelineLayout(key, prepared);
+    std::string layoutKey = key.get();
+
+    auto cachedPipelineLayout = m_pipelineLayouts.find(layoutKey);
+    if (cachedPipelineLayout != m_pipelineLayouts.end()) {
+        return cachedPipelineLayout->second;
+    }
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo = vk::PipelineLayoutCreateInfo{}
+        .setSetLayoutCount(prepared.setLayouts.size())
+        .setPSetLayouts(prepared.setLayouts.data())
+        .setPushConstantRangeCount(prepared.pushConstantRanges.size())
+        .setPPushConstantRanges(prepared.pushConstantRanges.data());
+
+    vk::PipelineLayout pipelineLayout;
+    if (m_device->get().createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &pipelineLayout) != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create pipeline layout!");
+    }
+    m_pipelineLayouts.emplace(layoutKey, pipelineLayout);
+    return pipelineLayout;
+}
+
+vk::Pipeline PipelineLibrary::linkParts(const std::array<vk::Pipeline, 4>& parts, vk::PipelineLayout pipelineLayout, bool optimize) const {
+    vk::PipelineLibraryCreateInfoKHR pipelineLibraryCreateInfo = vk::PipelineLibraryCreateInfoKHR{}
+        .setLibraryCount(parts.size())
+        .setPLibraries(parts.data());
+
+    vk::GraphicsPipelineCreateInfo graphicsPipelineCreateInfo = vk::GraphicsPipelineCreateInfo{}
+        .setPNext(&pipelineLibraryCreateInfo)
+        .setLayout(pipelineLayout)
+        .setBasePipelineIndex(-1);
+    if (optimize) {
+        graphicsPipelineCreateInfo.flags |= vk::PipelineCreateFlagBits::eLinkTimeOptimizationEXT;
+    }
+    if (m_device->getDescriptorBackend() == Device::DescriptorBackend::eDescriptorBuffer) {
+        graphicsPipelineCreateInfo.flags |= vk::PipelineCreateFlagBits::eDescriptorBufferEXT;
+    }
+
+    vk::Pipeline pipeline;
+    if (m_device->get().createGraphicsPipelines(m_device->getPipelineCache().get(), 1, &graphicsPipelineCreateInfo, nullptr, &pipeline) != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to link graphics pipeline!");
+    }
+    return pipeline;
+}
+
+} // namespace gfx
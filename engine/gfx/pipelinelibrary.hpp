@@ -0,0 +1,76 @@
+#ifndef GFX_PIPELINELIBRARY_HPP
+#define GFX_PIPELINELIBRARY_HPP
+
+#include "pipeline.hpp"
+#include "../core/threadpool.hpp"
+
+#include <array>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace gfx {
+
+// builds graphics pipelines out of the four VK_EXT_graphics_pipeline_library parts (vertex input, pre-rasterization shaders,
+// fragment shader, fragment output), each created once per distinct state and shared between every pipeline using it
+// a new combination of already created parts is only a fast link, so pipelines that appear mid frame cost next to nothing
+// falls back to building the whole pipeline when the device does not support the extension
+class PipelineLibrary {
+public:
+    struct Result {
+        // usable right away
+        GraphicsPipeline pipeline;
+        // the same pipeline linked with link time optimization on a background thread, swap it in once it is ready
+        // not valid when the fallback path was taken, pipeline is already fully optimized then
+        std::future<GraphicsPipeline> optimized;
+    };
+
+    struct Statistics {
+        uint64_t partHits;
+        uint64_t partMisses;
+        uint64_t links;
+    };
+
+    PipelineLibrary(std::shared_ptr<Device> device);
+    // waits for the optimized links still in flight
+    ~PipelineLibrary();
+
+    PipelineLibrary(const PipelineLibrary&) = delete;
+    PipelineLibrary& operator=(const PipelineLibrary&) = delete;
+
+    // thread safe, parts missing for builder are created first
+    // with optimize the link time optimized pipeline is queued too, otherwise result.optimized is left invalid
+    Result link(GraphicsPipeline::Builder& builder, bool optimize = true);
+
+    bool isSupported() const { return m_device->isGraphicsPipelineLibrarySupported(); }
+    Statistics getStatistics() const;
+
+private:
+    enum class Part {
+        eVertexInput,
+        ePreRasterizationShaders,
+        eFragmentShader,
+        eFragmentOutputInterface,
+    };
+
+    vk::Pipeline getPart(Part part, const std::string& key, const GraphicsPipeline::Builder& builder, const GraphicsPipeline::Builder::Prepared& prepared);
+    vk::Pipeline createPart(Part part, const GraphicsPipeline::Builder& builder, const GraphicsPipeline::Builder::Prepared& prepared);
+    // identically defined to the layout of prepared, the parts cannot use that one as it is owned by the pipeline
+    vk::PipelineLayout getPipelineLayout(const GraphicsPipeline::Builder::Prepared& prepared);
+    vk::Pipeline linkParts(const std::array<vk::Pipeline, 4>& parts, vk::PipelineLayout pipelineLayout, bool optimize) const;
+
+private:
+    std::shared_ptr<Device> m_device;
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, vk::Pipeline> m_parts;
+    std::unordered_map<std::string, vk::PipelineLayout> m_pipelineLayouts;
+    Statistics m_statistics;
+    // a pointer so it can be drained in the destructor before the parts go away
+    std::unique_ptr<core::ThreadPool> m_threadPool;
+};
+
+} // namespace gfx
+
+#endif
@@ -0,0 +1,474 @@
+#include "pipelinemanifest.hpp"
+
+#include "../core/file.hpp"
+#include "../core/hash.hpp"
+#include "../core/threadpool.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <future>
+
+namespace gfx {
+
+// bump whenever the record layout changes, older manifests are then ignored
+static constexpr uint32_t MANIFEST_VERSION = 1;
+static constexpr uint32_t MANIFEST_MAGIC = 0x4d4f5350;  // "PSOM"
+
+// reads back what core::KeyWriter wrote, throws when the record is cut short
+class RecordReader {
+public:
+    RecordReader(std::string_view data) : m_data(data), m_offset(0) {}
+
+    template <typename T>
+    T read() {
+        static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be read by value");
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    // the file may be corrupt or stale, values vulkan would not accept make the record throw so it gets skipped
+    bool readBool() {
+        uint8_t value = read<uint8_t>();
+        if (value > 1) throw std::runtime_error("Invalid bool in pipeline manifest record!");
+        return value != 0;
+    }
+
+    vk::Bool32 readBool32() {
+        vk::Bool32 value = read<vk::Bool32>();
+        if (value > VK_TRUE) throw std::runtime_error("Invalid Bool32 in pipeline manifest record!");
+        return value;
+    }
+
+    template <typename T>
+    T readEnum() {
+        return checkEnum(read<T>());
+    }
+
+    template <typename BitType>
+    vk::Flags<BitType> readFlags() {
+        return checkFlags(read<vk::Flags<BitType>>());
+    }
+
+    // only values vulkan-hpp has a name for
+    template <typename T>
+    static T checkEnum(T value) {
+        if (vk::to_string(value).starts_with("invalid")) {
+            throw std::runtime_error("Invalid enum value in pipeline manifest record!");
+        }
+        return value;
+    }
+
+    template <typename BitType>
+    static vk::Flags<BitType> checkFlags(vk::Flags<BitType> value) {
+        if (value & ~vk::Flags<BitType>(vk::FlagTraits<BitType>::allFlags)) {
+            throw std::runtime_error("Invalid flags in pipeline manifest record!");
+        }
+        return value;
+    }
+
+    std::string readString() {
+        uint64_t size = read<uint64_t>();
+        return std::string{take(size), size};
+    }
+
+    template <typename T>
+    std::vector<T> readVector() {
+        uint64_t size = read<uint64_t>();
+        std::vector<T> values;
+        for (uint64_t i = 0; i < size; i++) values.push_back(read<T>());
+        return values;
+    }
+
+    bool isAtEnd() const { return m_offset == m_data.size(); }
+
+private:
+    const char *take(uint64_t size) {
+        if (size > m_data.size() - m_offset) {
+            throw std::runtime_error("Truncated pipeline manifest record!");
+        }
+        const char *data = m_data.data() + m_offset;
+        m_offset += size;
+        return data;
+    }
+
+private:
+    std::string_view m_data;
+    size_t m_offset;
+};
+
+// **********PipelineManifest::PrewarmInfo**********
+PipelineManifest::PrewarmInfo::PrewarmInfo() : m_descriptorSetLayoutCache(nullptr), m_pipelineStateCache(nullptr), m_threadCount(0) {}
+
+PipelineManifest::PrewarmInfo& PipelineManifest::PrewarmInfo::addRenderPass(const RenderPass& renderPass) {
+    m_renderPasses[renderPass.getCompatibilityHash()] = renderPass.get();
+    return *this;
+}
+
+PipelineManifest::PrewarmInfo& PipelineManifest::PrewarmInfo::setDescriptorSetLayoutCache(DescriptorSetLayoutCache& descriptorSetLayoutCache) {
+    m_descriptorSetLayoutCache = &descriptorSetLayoutCache;
+    return *this;
+}
+
+PipelineManifest::PrewarmInfo& PipelineManifest::PrewarmInfo::setPipelineStateCache(PipelineStateCache& pipelineStateCache) {
+    m_pipelineStateCache = &pipelineStateCache;
+    return *this;
+}
+
+PipelineManifest::PrewarmInfo& PipelineManifest::PrewarmInfo::setThreadCount(uint32_t threadCount) {
+    m_threadCount = threadCount;
+    return *this;
+}
+
+PipelineManifest::PrewarmInfo& PipelineManifest::PrewarmInfo::setProgressCallback(std::function<void(uint32_t completed, uint32_t total)> progressCallback) {
+    m_progressCallback = std::move(progressCallback);
+    return *this;
+}
+
+// **********PipelineManifest**********
+PipelineManifest::PipelineManifest(const std::filesystem::path& path) : m_path(path) {
+    if (m_path.empty()) return;
+    auto data = core::tryReadFile(m_path);
+    if (!data) return;
+
+    try {
+        RecordReader reader{*data};
+        if (reader.read<uint32_t>() != MANIFEST_MAGIC || reader.read<uint32_t>() != MANIFEST_VERSION) {
+            INFO("Discarding pipeline manifest {}, it was written by a different version", m_path.string());
+            return;
+        }
+        uint64_t recordCount = reader.read<uint64_t>();
+        for (uint64_t i = 0; i < recordCount; i++) {
+            m_records.insert(reader.readString());
+        }
+    } catch (const std::exception& e) {
+        WARN("Discarding pipeline manifest {}: {}", m_path.string(), e.what());
+        m_records.clear();
+        return;
+    }
+    INFO("Loaded {} pipelines from pipeline manifest {}", m_records.size(), m_path.string());
+}
+
+void PipelineManifest::record(const GraphicsPipeline::Builder& builder) {
+    std::string record = serialize(builder);
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_records.insert(std::move(record));
+}
+
+bool PipelineManifest::save() const {
+    if (m_path.empty()) return false;
+
+    core::KeyWriter writer;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        writer.add(MANIFEST_MAGIC).add(MANIFEST_VERSION).add(static_cast<uint64_t>(m_records.size()));
+        for (auto& record : m_records) {
+            writer.add(std::string_view{record});
+        }
+    }
+    if (!core::writeFileAtomic(m_path, writer.get())) {
+        WARN("Failed to save pipeline manifest {}", m_path.string());
+        return false;
+    }
+    INFO("Saved {} pipelines to pipeline manifest {}", size(), m_path.string());
+    return true;
+}
+
+size_t PipelineManifest::size() const {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_records.size();
+}
+
+uint32_t PipelineManifest::prewarm(std::shared_ptr<Device> device, const PrewarmInfo& prewarmInfo) const {
+    std::vector<std::string> records;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        records.assign(m_records.begin(), m_records.end());
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    core::ThreadPool threadPool{prewarmInfo.m_threadCount};
+    std::vector<std::future<void>> builds;
+    uint32_t skipped = 0;
+    for (auto& record : records) {
+        std::optional<GraphicsPipeline::Builder> builder;
+        try {
+            builder = deserialize(record, prewarmInfo);
+        } catch (const std::exception& e) {
+            WARN("Skipping pipeline manifest record: {}", e.what());
+        }
+        if (!builder) {
+            skipped++;
+            continue;
+        }
+        // every shader is queued before any pipeline waits on one
+        builder->compileShadersAsync();
+        builds.push_back(threadPool.submit([&device, &prewarmInfo, builder = std::move(*builder)]() mutable {
+            if (prewarmInfo.m_pipelineStateCache) {
+                prewarmInfo.m_pipelineStateCache->get(builder);
+            } else {
+                builder.build(device);
+            }
+        }));
+    }
+
+    uint32_t built = 0;
+    for (uint32_t i = 0; i < builds.size(); i++) {
+        try {
+            builds[i].get();
+            built++;
+        } catch (const std::exception& e) {
+            ERROR("Failed to prewarm pipeline: {}", e.what());
+        }
+        if (prewarmInfo.m_progressCallback) {
+            prewarmInfo.m_progressCallback(i + 1, static_cast<uint32_t>(builds.size()));
+        }
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    INFO("Prewarmed {} pipelines in {:.3f} ms, skipped {} without a matching render pass or descriptor set layout cache",
+        built, std::chrono::duration<double, std::milli>(end - start).count(), skipped);
+    return built;
+}
+
+std::string PipelineManifest::serialize(const GraphicsPipeline::Builder& builder) {
+    core::KeyWriter writer;
+
+    writer.add(static_cast<uint64_t>(builder.m_shaderCompileInfos.size()));
+    for (size_t i = 0; i < builder.m_shaderCompileInfos.size(); i++) {
+        auto& shaderCompileInfo = builder.m_shaderCompileInfos[i];
+        // offline compiled spirv has no source to compile again from, the code goes in as it is
+        bool spirv = shaderCompileInfo.m_path.empty();
+        writer.add(spirv).add(shaderCompileInfo.m_stage);
+        if (spirv) {
+            writer.addVector(builder.m_requestedShaders.at(i).get().m_code);
+            continue;
+        }
+        // resolved here, the default might differ by the time the manifest is prewarmed
+        auto builderOptimizationLevel = builder.m_requestedShaders.contains(i) ? std::nullopt : builder.m_shaderOptimizationLevel;
+        writer.add(std::string_view{shaderCompileInfo.m_path.string()})
+              .add(shaderCompileInfo.m_optimizationLevel.value_or(builderOptimizationLevel.value_or(ShaderCompiler::getDefaultOptimizationLevel())));
+        writer.add(static_cast<uint64_t>(shaderCompileInfo.m_defines.size()));
+        for (auto& [name, value] : shaderCompileInfo.m_defines) {
+            writer.add(std::string_view{name}).add(std::string_view{value});
+        }
+        writer.add(static_cast<uint64_t>(shaderCompileInfo.m_includeDirectories.size()));
+        for (auto& includeDirectory : shaderCompileInfo.m_includeDirectories) {
+            writer.add(std::string_view{includeDirectory.string()});
+        }
+        writer.add(static_cast<uint64_t>(shaderCompileInfo.m_optimizerPasses.size()));
+        for (auto& optimizerPass : shaderCompileInfo.m_optimizerPasses) {
+            writer.add(std::string_view{optimizerPass});
+        }
+    }
+
+    writer.add(static_cast<uint64_t>(builder.m_specializationConstants.size()));
+    for (auto& [stage, specializationConstants] : builder.m_specializationConstants) {
+        writer.add(stage).addVector(specializationConstants.m_mapEntries).addVector(specializationConstants.m_data);
+    }
+
+    writer.addVector(builder.m_dynamicStates).add(builder.m_dynamicViewportScissor).add(builder.m_extendedDynamicState);
+
+    auto& inputAssembly = builder.m_pipelineInputAssemblyStateCreateInfo;
+    writer.add(inputAssembly.topology).add(inputAssembly.primitiveRestartEnable);
+    writer.addVector(builder.m_viewports).addVector(builder.m_scissors);
+
+    auto& rasterization = builder.m_pipelineRasterizationStateCreateInfo;
+    writer.add(rasterization.depthClampEnable)
+          .add(rasterization.rasterizerDiscardEnable)
+          .add(rasterization.polygonMode)
+          .add(rasterization.cullMode)
+          .add(rasterization.frontFace)
+          .add(rasterization.depthBiasEnable)
+          .add(rasterization.depthBiasConstantFactor)
+          .add(rasterization.depthBiasClamp)
+          .add(rasterization.depthBiasSlopeFactor)
+          .add(rasterization.lineWidth);
+
+    auto& multisample = builder.m_pipelineMultisampleStateCreateInfo;
+    writer.add(multisample.rasterizationSamples)
+          .add(multisample.sampleShadingEnable)
+          .add(multisample.minSampleShading)
+          .add(multisample.alphaToCoverageEnable)
+          .add(multisample.alphaToOneEnable);
+
+    auto& colorBlend = builder.m_pipelineColorBlendStateCreateInfo;
+    writer.addVector(builder.m_pipelineColorBlendAttachmentStates)
+          .add(colorBlend.logicOpEnable)
+          .add(colorBlend.logicOp)
+          .add(colorBlend.blendConstants);
+
+    writer.addVector(builder.m_pushConstantRanges);
+    writer.add(builder.m_descriptorSetLayoutCache != nullptr);
+    writer.add(static_cast<uint64_t>(builder.m_explicitDescriptorSetLayouts.size()));
+    for (auto& descriptorSetLayoutBuilder : builder.m_explicitDescriptorSetLayouts) {
+        writer.add(descriptorSetLayoutBuilder.m_descriptorSetLayoutCreateInfo.flags).add(static_cast<uint64_t>(descriptorSetLayoutBuilder.m_descriptorBindingDescriptions.size()));
+        for (auto& [binding, descriptorSetLayoutBinding] : descriptorSetLayoutBuilder.m_descriptorBindingDescriptions) {
+            writer.add(binding)
+                  .add(descriptorSetLayoutBinding.descriptorType)
+                  .add(descriptorSetLayoutBinding.descriptorCount)
+                  .add(descriptorSetLayoutBinding.stageFlags);
+        }
+    }
+    writer.addVector(builder.m_vertexInputBindingDescriptions).addVector(builder.m_vertexInputAttributeDescriptions);
+
+    writer.add(builder.m_renderPassCompatibilityHash);
+
+    return writer.get();
+}
+
+std::optional<GraphicsPipeline::Builder> PipelineManifest::deserialize(const std::string& record, const PrewarmInfo& prewarmInfo) {
+    RecordReader reader{record};
+    GraphicsPipeline::Builder builder;
+
+    uint64_t shaderCount = reader.read<uint64_t>();
+    for (uint64_t i = 0; i < shaderCount; i++) {
+        bool spirv = reader.readBool();
+        auto stage = reader.readEnum<vk::ShaderStageFlagBits>();
+        if (builder.hasShaderStage(stage)) {
+            throw std::runtime_error("Duplicate shader stage in pipeline manifest record!");
+        }
+        if (spirv) {
+            std::vector<uint32_t> code = reader.readVector<uint32_t>();
+            builder.addShaderFromSpirv(code, stage);
+            continue;
+        }
+        std::string path = reader.readString();
+        auto optimizationLevel = reader.read<ShaderCompiler::OptimizationLevel>();
+        if (optimizationLevel != ShaderCompiler::OptimizationLevel::eZero && optimizationLevel != ShaderCompiler::OptimizationLevel::eSize && optimizationLevel != ShaderCompiler::OptimizationLevel::ePerformance) {
+            throw std::runtime_error("Invalid optimization level in pipeline manifest record!");
+        }
+        ShaderCompiler::CompileInfo shaderCompileInfo;
+        shaderCompileInfo.setPath(path)
+                         .setStage(stage)
+                         .setOptimizationLevel(optimizationLevel);
+        uint64_t defineCount = reader.read<uint64_t>();
+        for (uint64_t j = 0; j < defineCount; j++) {
+            std::string name = reader.readString();
+            shaderCompileInfo.addDefine(name, reader.readString());
+        }
+        uint64_t includeDirectoryCount = reader.read<uint64_t>();
+        for (uint64_t j = 0; j < includeDirectoryCount; j++) {
+            shaderCompileInfo.addIncludeDirectory(reader.readString());
+        }
+        uint64_t optimizerPassCount = reader.read<uint64_t>();
+        for (uint64_t j = 0; j < optimizerPassCount; j++) {
+            shaderCompileInfo.addOptimizerPass(reader.readString());
+        }
+        builder.addShader(shaderCompileInfo);
+    }
+
+    uint64_t specializationConstantsCount = reader.read<uint64_t>();
+    for (uint64_t i = 0; i < specializationConstantsCount; i++) {
+        auto& specializationConstants = builder.m_specializationConstants[reader.readEnum<vk::ShaderStageFlagBits>()];
+        specializationConstants.m_mapEntries = reader.readVector<vk::SpecializationMapEntry>();
+        specializationConstants.m_data = reader.readVector<uint8_t>();
+        for (auto& mapEntry : specializationConstants.m_mapEntries) {
+            if ((mapEntry.size != 4 && mapEntry.size != 8) || mapEntry.offset + mapEntry.size > specializationConstants.m_data.size()) {
+                throw std::runtime_error("Invalid specialization constant in pipeline manifest record!");
+            }
+        }
+    }
+
+    builder.m_dynamicStates = reader.readVector<vk::DynamicState>();
+    for (auto dynamicState : builder.m_dynamicStates) {
+        RecordReader::checkEnum(dynamicState);
+    }
+    builder.m_dynamicViewportScissor = reader.readBool();
+    builder.m_extendedDynamicState = reader.readBool();
+
+    auto& inputAssembly = builder.m_pipelineInputAssemblyStateCreateInfo;
+    inputAssembly.topology = reader.readEnum<vk::PrimitiveTopology>();
+    inputAssembly.primitiveRestartEnable = reader.readBool32();
+    builder.m_viewports = reader.readVector<vk::Viewport>();
+    builder.m_scissors = reader.readVector<vk::Rect2D>();
+
+    auto& rasterization = builder.m_pipelineRasterizationStateCreateInfo;
+    rasterization.depthClampEnable = reader.readBool32();
+    rasterization.rasterizerDiscardEnable = reader.readBool32();
+    rasterization.polygonMode = reader.readEnum<vk::PolygonMode>();
+    rasterization.cullMode = reader.readFlags<vk::CullModeFlagBits>();
+    rasterization.frontFace = reader.readEnum<vk::FrontFace>();
+    rasterization.depthBiasEnable = reader.readBool32();
+    rasterization.depthBiasConstantFactor = reader.read<float>();
+    rasterization.depthBiasClamp = reader.read<float>();
+    rasterization.depthBiasSlopeFactor = reader.read<float>();
+    rasterization.lineWidth = reader.read<float>();
+
+    auto& multisample = builder.m_pipelineMultisampleStateCreateInfo;
+    multisample.rasterizationSamples = reader.readEnum<vk::SampleCountFlagBits>();
+    multisample.sampleShadingEnable = reader.readBool32();
+    multisample.minSampleShading = reader.read<float>();
+    multisample.alphaToCoverageEnable = reader.readBool32();
+    multisample.alphaToOneEnable = reader.readBool32();
+
+    auto& colorBlend = builder.m_pipelineColorBlendStateCreateInfo;
+    builder.m_pipelineColorBlendAttachmentStates = reader.readVector<vk::PipelineColorBlendAttachmentState>();
+    for (auto& attachment : builder.m_pipelineColorBlendAttachmentStates) {
+        if (attachment.blendEnable > VK_TRUE) throw std::runtime_error("Invalid Bool32 in pipeline manifest record!");
+        RecordReader::checkEnum(attachment.srcColorBlendFactor);
+        RecordReader::checkEnum(attachment.dstColorBlendFactor);
+        RecordReader::checkEnum(attachment.colorBlendOp);
+        RecordReader::checkEnum(attachment.srcAlphaBlendFactor);
+        RecordReader::checkEnum(attachment.dstAlphaBlendFactor);
+        RecordReader::checkEnum(attachment.alphaBlendOp);
+        RecordReader::checkFlags(attachment.colorWriteMask);
+    }
+    colorBlend.logicOpEnable = reader.readBool32();
+    colorBlend.logicOp = reader.readEnum<vk::LogicOp>();
+    colorBlend.blendConstants = reader.read<std::array<float, 4>>();
+
+    builder.m_pushConstantRanges = reader.readVector<vk::PushConstantRange>();
+    for (auto& pushConstantRange : builder.m_pushConstantRanges) {
+        RecordReader::checkFlags(pushConstantRange.stageFlags);
+    }
+    bool reflection = reader.readBool();
+    uint64_t descriptorSetLayoutCount = reader.read<uint64_t>();
+    if ((reflection || descriptorSetLayoutCount > 0) && !prewarmInfo.m_descriptorSetLayoutCache) {
+        return std::nullopt;
+    }
+    if (reflection) {
+        builder.setReflection(*prewarmInfo.m_descriptorSetLayoutCache);
+    }
+    for (uint64_t i = 0; i < descriptorSetLayoutCount; i++) {
+        DescriptorSetLayout::Builder descriptorSetLayoutBuilder;
+        descriptorSetLayoutBuilder.setFlags(reader.readFlags<vk::DescriptorSetLayoutCreateFlagBits>());
+        uint64_t bindingCount = reader.read<uint64_t>();
+        for (uint64_t j = 0; j < bindingCount; j++) {
+            auto binding = reader.read<uint32_t>();
+            auto descriptorType = reader.readEnum<vk::DescriptorType>();
+            auto descriptorCount = reader.read<uint32_t>();
+            auto stageFlags = reader.readFlags<vk::ShaderStageFlagBits>();
+            if (descriptorSetLayoutBuilder.m_descriptorBindingDescriptions.contains(binding)) {
+                throw std::runtime_error("Duplicate binding in pipeline manifest record!");
+            }
+            descriptorSetLayoutBuilder.addBinding(binding, descriptorType, stageFlags, descriptorCount);
+        }
+        builder.addDescriptorSetLayout(prewarmInfo.m_descriptorSetLayoutCache->get(descriptorSetLayoutBuilder));
+    }
+    builder.m_vertexInputBindingDescriptions = reader.readVector<vk::VertexInputBindingDescription>();
+    builder.m_vertexInputAttributeDescriptions = reader.readVector<vk::VertexInputAttributeDescription>();
+    for (auto& vertexInputBindingDescription : builder.m_vertexInputBindingDescriptions) {
+        RecordReader::checkEnum(vertexInputBindingDescription.inputRate);
+    }
+    for (auto& vertexInputAttributeDescription : builder.m_vertexInputAttributeDescriptions) {
+        RecordReader::checkEnum(vertexInputAttributeDescription.format);
+    }
+
+    uint64_t renderPassCompatibilityHash = reader.read<uint64_t>();
+    if (!reader.isAtEnd()) {
+        throw std::runtime_error("Pipeline manifest record has trailing data!");
+    }
+    auto renderPass = prewarmInfo.m_renderPasses.find(renderPassCompatibilityHash);
+    if (renderPass == prewarmInfo.m_renderPasses.end()) {
+        return std::nullopt;
+    }
+    builder.m_renderPass = renderPass->second;
+    builder.m_renderPassCompatibilityHash = renderPassCompatibilityHash;
+
+    return builder;
+}
+
+} // namespace gfx
@@ -0,0 +1,73 @@
+#ifndef GFX_PIPELINEMANIFEST_HPP
+#define GFX_PIPELINEMANIFEST_HPP
+
+#include "pipeline.hpp"
+#include "pipelinestatecache.hpp"
+
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+
+namespace gfx {
+
+// every graphics pipeline description built, recorded so a loading phase of the next run can build them all up front
+// (filling the spirv cache, the driver's pipeline cache and optionally a PipelineStateCache) instead of hitching mid frame
+// owned by Device, every path creating a graphics pipeline records its builder once the pipeline was created
+class PipelineManifest {
+public:
+    struct PrewarmInfo {
+        PrewarmInfo();
+
+        // recorded pipelines are matched to these by render pass compatibility, the ones without a match are skipped
+        PrewarmInfo& addRenderPass(const RenderPass& renderPass);
+        // needed for pipelines built with reflection or explicit descriptor set layouts, the explicit ones are recreated through it
+        PrewarmInfo& setDescriptorSetLayoutCache(DescriptorSetLayoutCache& descriptorSetLayoutCache);
+        // the prewarmed pipelines are kept in it so later requests are hits, without one they are built and dropped again
+        // note: explicit descriptor set layouts only match later requests when those take their layouts from the same cache
+        PrewarmInfo& setPipelineStateCache(PipelineStateCache& pipelineStateCache);
+        // 0 picks one thread per core
+        PrewarmInfo& setThreadCount(uint32_t threadCount);
+        // called on the prewarming thread after every pipeline, for loading screens
+        PrewarmInfo& setProgressCallback(std::function<void(uint32_t completed, uint32_t total)> progressCallback);
+
+        std::map<uint64_t, vk::RenderPass> m_renderPasses;
+        DescriptorSetLayoutCache *m_descriptorSetLayoutCache;
+        PipelineStateCache *m_pipelineStateCache;
+        uint32_t m_threadCount;
+        std::function<void(uint32_t, uint32_t)> m_progressCallback;
+    };
+
+    // loads the manifest at path when there is one, an empty path keeps the record in memory only
+    PipelineManifest(const std::filesystem::path& path);
+
+    PipelineManifest(const PipelineManifest&) = delete;
+    PipelineManifest& operator=(const PipelineManifest&) = delete;
+
+    // thread safe, a description already recorded is not added again
+    void record(const GraphicsPipeline::Builder& builder);
+    // writes atomically, also the entries loaded that were not built this run
+    bool save() const;
+    size_t size() const;
+
+    // builds every recorded pipeline in parallel and blocks until all are done, returns how many were built
+    uint32_t prewarm(std::shared_ptr<Device> device, const PrewarmInfo& prewarmInfo) const;
+
+private:
+    static std::string serialize(const GraphicsPipeline::Builder& builder);
+    // nullopt when the render pass or descriptor set layout cache it needs was not given
+    static std::optional<GraphicsPipeline::Builder> deserialize(const std::string& record, const PrewarmInfo& prewarmInfo);
+
+private:
+    std::filesystem::path m_path;
+    mutable std::mutex m_mutex;
+    // the serialized description is its own key
+    std::set<std::string> m_records;
+};
+
+} // namespace gfx
+
+#endif
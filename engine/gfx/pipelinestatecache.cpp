@@ -0,0 +1,180 @@
+#include "pipelinestatecache.hpp"
+
+#include "../core/hash.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace gfx {
+
+static vk::PrimitiveTopology getTopologyClass(vk::PrimitiveTopology topology) {
+    switch (topology) {
+        case vk::PrimitiveTopology::eLineList:
+        case vk::PrimitiveTopology::eLineStrip:
+        case vk::PrimitiveTopology::eLineListWithAdjacency:
+        case vk::PrimitiveTopology::eLineStripWithAdjacency:
+            return vk::PrimitiveTopology::eLineList;
+        case vk::PrimitiveTopology::eTriangleList:
+        case vk::PrimitiveTopology::eTriangleStrip:
+        case vk::PrimitiveTopology::eTriangleFan:
+        case vk::PrimitiveTopology::eTriangleListWithAdjacency:
+        case vk::PrimitiveTopology::eTriangleStripWithAdjacency:
+            return vk::PrimitiveTopology::eTriangleList;
+        default:
+            return topology;
+    }
+}
+
+PipelineStateCache::PipelineStateCache(std::shared_ptr<Device> device) : m_device(device), m_hits(0), m_misses(0), m_buildMilliseconds(0) {}
+
+std::string PipelineStateCache::getKey(const GraphicsPipeline::Builder& builder) const {
+    core::KeyWriter key;
+
+    key.add(static_cast<uint64_t>(builder.m_shaderCompileInfos.size()));
+    for (size_t i = 0; i < builder.m_shaderCompileInfos.size(); i++) {
+        auto& shaderCompileInfo = builder.m_shaderCompileInfos[i];
+        // offline compiled spirv has no path to tell it apart, the code itself does
+        if (shaderCompileInfo.m_path.empty()) {
+            key.add(shaderCompileInfo.m_stage).addVector(builder.m_requestedShaders.at(i).get().m_code);
+            continue;
+        }
+        // permutation variants are compiled as they are, without the builder's optimization level
+        auto builderOptimizationLevel = builder.m_requestedShaders.contains(i) ? std::nullopt : builder.m_shaderOptimizationLevel;
+        key.add(std::string_view{shaderCompileInfo.m_path.string()})
+           .add(shaderCompileInfo.m_stage)
+           .add(shaderCompileInfo.m_optimizationLevel.value_or(builderOptimizationLevel.value_or(ShaderCompiler::getDefaultOptimizationLevel())));
+        key.add(static_cast<uint64_t>(shaderCompileInfo.m_defines.size()));
+        for (auto& [name, value] : shaderCompileInfo.m_defines) {
+            key.add(std::string_view{name}).add(std::string_view{value});
+        }
+        key.add(static_cast<uint64_t>(shaderCompileInfo.m_includeDirectories.size()));
+        for (auto& includeDirectory : shaderCompileInfo.m_includeDirectories) {
+            key.add(std::string_view{includeDirectory.string()});
+        }
+        key.add(static_cast<uint64_t>(shaderCompileInfo.m_optimizerPasses.size()));
+        for (auto& optimizerPass : shaderCompileInfo.m_optimizerPasses) {
+            key.add(std::string_view{optimizerPass});
+        }
+    }
+
+    key.add(static_cast<uint64_t>(builder.m_specializationConstants.size()));
+    for (auto& [stage, specializationConstants] : builder.m_specializationConstants) {
+        key.add(stage).add(static_cast<uint64_t>(specializationConstants.m_mapEntries.size()));
+        for (auto& mapEntry : specializationConstants.m_mapEntries) {
+            key.add(mapEntry.constantID).add(mapEntry.offset).add(static_cast<uint64_t>(mapEntry.size));
+        }
+        key.addVector(specializationConstants.m_data);
+    }
+
+    const auto dynamicStates = builder.getDynamicStates(*m_device);
+    key.addVector(dynamicStates);
+    // baked in state is only written when it is not dynamic
+    auto isDynamic = [&](vk::DynamicState dynamicState) {
+        return std::find(dynamicStates.begin(), dynamicStates.end(), dynamicState) != dynamicStates.end();
+    };
+
+    auto& inputAssembly = builder.m_pipelineInputAssemblyStateCreateInfo;
+    // a dynamic topology can only change within its class, so the class still tells pipelines apart
+    key.add(isDynamic(vk::DynamicState::ePrimitiveTopology) ? getTopologyClass(inputAssembly.topology) : inputAssembly.topology);
+    if (!isDynamic(vk::DynamicState::ePrimitiveRestartEnable)) key.add(inputAssembly.primitiveRestartEnable);
+
+    if (builder.m_dynamicViewportScissor) {
+        key.add(static_cast<uint64_t>(builder.m_viewports.size())).add(static_cast<uint64_t>(builder.m_scissors.size()));
+    } else {
+        key.addVector(builder.m_viewports).addVector(builder.m_scissors);
+    }
+
+    auto& rasterization = builder.m_pipelineRasterizationStateCreateInfo;
+    key.add(rasterization.depthClampEnable)
+       .add(rasterization.depthBiasConstantFactor)
+       .add(rasterization.depthBiasClamp)
+       .add(rasterization.depthBiasSlopeFactor)
+       .add(rasterization.lineWidth);
+    if (!isDynamic(vk::DynamicState::eRasterizerDiscardEnable)) key.add(rasterization.rasterizerDiscardEnable);
+    if (!isDynamic(vk::DynamicState::ePolygonModeEXT)) key.add(rasterization.polygonMode);
+    if (!isDynamic(vk::DynamicState::eCullMode)) key.add(rasterization.cullMode);
+    if (!isDynamic(vk::DynamicState::eFrontFace)) key.add(rasterization.frontFace);
+    if (!isDynamic(vk::DynamicState::eDepthBiasEnable)) key.add(rasterization.depthBiasEnable);
+
+    auto& multisample = builder.m_pipelineMultisampleStateCreateInfo;
+    key.add(multisample.rasterizationSamples)
+       .add(multisample.sampleShadingEnable)
+       .add(multisample.minSampleShading)
+       .add(multisample.alphaToCoverageEnable)
+       .add(multisample.alphaToOneEnable);
+
+    key.addVector(builder.m_pipelineColorBlendAttachmentStates);
+    auto& colorBlend = builder.m_pipelineColorBlendStateCreateInfo;
+    key.add(colorBlend.logicOpEnable).add(colorBlend.logicOp).add(colorBlend.blendConstants);
+
+    key.addVector(builder.m_pushConstantRanges);
+    key.addVector(builder.m_descriptorSetLayout);
+    key.addVector(builder.m_vertexInputBindingDescriptions).addVector(builder.m_vertexInputAttributeDescriptions);
+
+    // a pipeline can be used with any compatible render pass, the handle it is created with does not matter
+    key.add(builder.m_renderPassCompatibilityHash);
+    // the reflected layouts come from this cache
+    key.add(reinterpret_cast<uintptr_t>(builder.m_descriptorSetLayoutCache));
+
+    return key.get();
+}
+
+std::shared_ptr<GraphicsPipeline> PipelineStateCache::get(const GraphicsPipeline::Builder& builder) {
+    std::string key = getKey(builder);
+
+    std::promise<std::shared_ptr<GraphicsPipeline>> promise;
+    std::shared_future<std::shared_ptr<GraphicsPipeline>> future;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        auto pipeline = m_pipelines.find(key);
+        if (pipeline != m_pipelines.end()) {
+            future = pipeline->second;
+        } else {
+            m_pipelines.emplace(key, promise.get_future().share());
+        }
+    }
+    // built or being built by another caller
+    if (future.valid()) {
+        m_hits++;
+        return future.get();
+    }
+
+    m_misses++;
+    auto start = std::chrono::high_resolution_clock::now();
+    try {
+        GraphicsPipeline::Builder pipelineBuilder = builder;
+        auto pipeline = std::make_shared<GraphicsPipeline>(pipelineBuilder.build(m_device));
+        auto end = std::chrono::high_resolution_clock::now();
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_buildMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+        }
+        promise.set_value(pipeline);
+        return pipeline;
+    } catch (...) {
+        // the next request retries instead of getting the failure cached
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_pipelines.erase(key);
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+}
+
+PipelineStateCache::Statistics PipelineStateCache::getStatistics() const {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return {m_hits, m_misses, m_buildMilliseconds};
+}
+
+size_t PipelineStateCache::size() const {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_pipelines.size();
+}
+
+void PipelineStateCache::clear() {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_pipelines.clear();
+}
+
+} // namespace gfx
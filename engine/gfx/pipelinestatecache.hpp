@@ -0,0 +1,55 @@
+#ifndef GFX_PIPELINESTATECACHE_HPP
+#define GFX_PIPELINESTATECACHE_HPP
+
+#include "pipeline.hpp"
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace gfx {
+
+// hands out one shared pipeline per distinct builder state, so systems can request pipelines without creating duplicates
+// unlike the vk::PipelineCache of the device, a hit skips pipeline creation entirely
+// note: shaders are keyed by path and compile settings, not content; hot reloaded pipelines should not come from here
+class PipelineStateCache {
+public:
+    struct Statistics {
+        uint64_t hits;
+        uint64_t misses;
+        double buildMilliseconds;  // total time spent building on misses
+    };
+
+    PipelineStateCache(std::shared_ptr<Device> device);
+
+    PipelineStateCache(const PipelineStateCache&) = delete;
+    PipelineStateCache& operator=(const PipelineStateCache&) = delete;
+
+    // builds from a copy of builder on a miss, thread safe
+    // callers asking for a state that is still being built wait for it instead of building it again
+    std::shared_ptr<GraphicsPipeline> get(const GraphicsPipeline::Builder& builder);
+
+    // everything that ends up in the pipeline, two builders with the same key build interchangeable pipelines
+    // state that is dynamic on this device is left out, builders differing only in it share a pipeline
+    std::string getKey(const GraphicsPipeline::Builder& builder) const;
+
+    Statistics getStatistics() const;
+    size_t size() const;
+    // drops the cache's references, pipelines still in use elsewhere stay alive
+    void clear();
+
+private:
+    std::shared_ptr<Device> m_device;
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, std::shared_future<std::shared_ptr<GraphicsPipeline>>> m_pipelines;
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+    double m_buildMilliseconds;
+};
+
+} // namespace gfx
+
+#endif
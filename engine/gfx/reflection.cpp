@@ -0,0 +1,474 @@
+#include "reflection.hpp"
+
+#include "../core/hash.hpp"
+
+#include <spirv/unified1/spirv.hpp>
+
+#include <algorithm>
+#include <array>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+namespace gfx {
+
+namespace {
+
+struct Type {
+    spv::Op op = spv::OpNop;
+    uint32_t width = 0;              // int, float
+    bool isSigned = false;           // int
+    uint32_t elementType = 0;        // vector, matrix, array, runtime array, pointer, sampled image, image (sampled type)
+    uint32_t count = 0;              // vector components, matrix columns
+    uint32_t lengthId = 0;           // array
+    spv::StorageClass storageClass = spv::StorageClassMax;  // pointer
+    spv::Dim dim = spv::DimMax;      // image
+    uint32_t sampled = 0;            // image, 1 sampled 2 storage
+    std::vector<uint32_t> members;   // struct
+};
+
+struct Decorations {
+    std::optional<uint32_t> set;
+    std::optional<uint32_t> binding;
+    std::optional<uint32_t> location;
+    std::optional<uint32_t> arrayStride;
+    bool block = false;
+    bool bufferBlock = false;
+    bool builtIn = false;
+    std::optional<uint32_t> specId;
+    std::map<uint32_t, uint32_t> memberOffsets;
+    std::map<uint32_t, uint32_t> memberMatrixStrides;
+};
+
+struct Variable {
+    uint32_t id;
+    uint32_t typeId;
+    spv::StorageClass storageClass;
+};
+
+// only the parts of the module that describe its interface
+class Module {
+public:
+    Module(const std::vector<uint32_t>& code) {
+        if (code.size() < 5 || code[0] != spv::MagicNumber) {
+            throw std::runtime_error("Cannot reflect, not a SPIR-V module!");
+        }
+        size_t i = 5;
+        while (i < code.size()) {
+            const uint32_t wordCount = code[i] >> 16;
+            const spv::Op op = static_cast<spv::Op>(code[i] & 0xffff);
+            if (wordCount == 0 || i + wordCount > code.size()) {
+                throw std::runtime_error("Cannot reflect, malformed SPIR-V instruction!");
+            }
+            parseInstruction(op, &code[i], wordCount);
+            i += wordCount;
+        }
+    }
+
+    const Type& getType(uint32_t id) const {
+        auto type = m_types.find(id);
+        if (type == m_types.end()) {
+            throw std::runtime_error("Cannot reflect, unknown SPIR-V type id " + std::to_string(id));
+        }
+        return type->second;
+    }
+
+    const Decorations& getDecorations(uint32_t id) const {
+        static const Decorations none{};
+        auto decorations = m_decorations.find(id);
+        return decorations == m_decorations.end() ? none : decorations->second;
+    }
+
+    std::string getName(uint32_t id) const {
+        auto name = m_names.find(id);
+        return name == m_names.end() ? std::string{} : name->second;
+    }
+
+    uint32_t getArrayLength(const Type& type) const {
+        auto constant = m_constants.find(type.lengthId);
+        if (constant == m_constants.end()) {
+            throw std::runtime_error("Cannot reflect, array length is not a constant (specialization constant sized arrays are not supported)");
+        }
+        return constant->second;
+    }
+
+    // byte size as laid out in memory, matrixStride comes from the member decoration of the enclosing struct
+    uint32_t getTypeSize(uint32_t id, uint32_t matrixStride = 0) const {
+        const Type& type = getType(id);
+        switch (type.op) {
+            case spv::OpTypeBool:
+            case spv::OpTypeInt:
+            case spv::OpTypeFloat:
+                return std::max(type.width, 32u) / 8;
+            case spv::OpTypeVector:
+                return type.count * getTypeSize(type.elementType);
+            case spv::OpTypeMatrix:
+                return type.count * (matrixStride ? matrixStride : getTypeSize(type.elementType));
+            case spv::OpTypeArray: {
+                const auto& decorations = getDecorations(id);
+                uint32_t stride = decorations.arrayStride ? *decorations.arrayStride : getTypeSize(type.elementType, matrixStride);
+                return getArrayLength(type) * stride;
+            }
+            case spv::OpTypeRuntimeArray:
+                return 0;
+            case spv::OpTypeStruct: {
+                const auto& decorations = getDecorations(id);
+                uint32_t size = 0;
+                for (uint32_t member = 0; member < type.members.size(); member++) {
+                    auto offset = decorations.memberOffsets.find(member);
+                    auto memberMatrixStride = decorations.memberMatrixStrides.find(member);
+                    uint32_t memberOffset = offset == decorations.memberOffsets.end() ? size : offset->second;
+                    uint32_t memberSize = getTypeSize(type.members[member], memberMatrixStride == decorations.memberMatrixStrides.end() ? 0 : memberMatrixStride->second);
+                    size = std::max(size, memberOffset + memberSize);
+                }
+                return size;
+            }
+            default:
+                throw std::runtime_error("Cannot reflect the size of SPIR-V type " + std::to_string(static_cast<uint32_t>(type.op)));
+        }
+    }
+
+    const std::vector<Variable>& getVariables() const { return m_variables; }
+
+    struct LocalSize {
+        std::array<uint32_t, 3> size;
+        // set for the dimensions that are specialization constants (local_size_*_id), size holds their default then
+        std::array<std::optional<uint32_t>, 3> constantIds;
+    };
+
+    // glslang keeps writing the LocalSize execution mode with the defaults for local_size_*_id,
+    // the actual size is the WorkgroupSize built in (or LocalSizeId for newer spirv) made of spec constants
+    LocalSize getLocalSize() const {
+        LocalSize localSize{{m_localSize.width, m_localSize.height, m_localSize.depth}, {}};
+        std::optional<std::array<uint32_t, 3>> sizeIds = m_localSizeIds;
+        if (m_workgroupSizeId) {
+            auto composite = m_composites.find(*m_workgroupSizeId);
+            if (composite != m_composites.end() && composite->second.size() == 3) {
+                sizeIds = std::array{composite->second[0], composite->second[1], composite->second[2]};
+            }
+        }
+        if (!sizeIds) return localSize;
+
+        for (uint32_t i = 0; i < 3; i++) {
+            uint32_t id = (*sizeIds)[i];
+            if (auto specConstant = m_specConstants.find(id); specConstant != m_specConstants.end()) {
+                localSize.size[i] = specConstant->second;
+                localSize.constantIds[i] = getDecorations(id).specId;
+            } else if (auto constant = m_constants.find(id); constant != m_constants.end()) {
+                localSize.size[i] = constant->second;
+            } else {
+                throw std::runtime_error("Cannot reflect the local size, it is not made of constants");
+            }
+        }
+        return localSize;
+    }
+
+private:
+    void parseInstruction(spv::Op op, const uint32_t *words, uint32_t wordCount) {
+        switch (op) {
+            case spv::OpName:
+                m_names[words[1]] = reinterpret_cast<const char *>(&words[2]);
+                break;
+            case spv::OpExecutionMode:
+                if (static_cast<spv::ExecutionMode>(words[2]) == spv::ExecutionModeLocalSize) {
+                    m_localSize = vk::Extent3D{words[3], words[4], words[5]};
+                }
+                break;
+            case spv::OpExecutionModeId:
+                if (static_cast<spv::ExecutionMode>(words[2]) == spv::ExecutionModeLocalSizeId) {
+                    m_localSizeIds = std::array{words[3], words[4], words[5]};
+                }
+                break;
+            case spv::OpDecorate: {
+                auto& decorations = m_decorations[words[1]];
+                switch (static_cast<spv::Decoration>(words[2])) {
+                    case spv::DecorationDescriptorSet: decorations.set = words[3]; break;
+                    case spv::DecorationBinding:       decorations.binding = words[3]; break;
+                    case spv::DecorationLocation:      decorations.location = words[3]; break;
+                    case spv::DecorationArrayStride:   decorations.arrayStride = words[3]; break;
+                    case spv::DecorationBlock:         decorations.block = true; break;
+                    case spv::DecorationBufferBlock:   decorations.bufferBlock = true; break;
+                    case spv::DecorationSpecId:        decorations.specId = words[3]; break;
+                    case spv::DecorationBuiltIn:
+                        decorations.builtIn = true;
+                        if (static_cast<spv::BuiltIn>(words[3]) == spv::BuiltInWorkgroupSize) m_workgroupSizeId = words[1];
+                        break;
+                    default: break;
+                }
+                break;
+            }
+            case spv::OpMemberDecorate: {
+                auto& decorations = m_decorations[words[1]];
+                switch (static_cast<spv::Decoration>(words[3])) {
+                    case spv::DecorationOffset:       decorations.memberOffsets[words[2]] = words[4]; break;
+                    case spv::DecorationMatrixStride: decorations.memberMatrixStrides[words[2]] = words[4]; break;
+                    case spv::DecorationBuiltIn:      decorations.builtIn = true; break;
+                    default: break;
+                }
+                break;
+            }
+            case spv::OpTypeVoid:
+            case spv::OpTypeBool:
+            case spv::OpTypeSampler:
+            case spv::OpTypeAccelerationStructureKHR:
+                m_types[words[1]].op = op;
+                break;
+            case spv::OpTypeInt:
+                m_types[words[1]] = Type{.op = op, .width = words[2], .isSigned = words[3] != 0};
+                break;
+            case spv::OpTypeFloat:
+                m_types[words[1]] = Type{.op = op, .width = words[2]};
+                break;
+            case spv::OpTypeVector:
+            case spv::OpTypeMatrix:
+                m_types[words[1]] = Type{.op = op, .elementType = words[2], .count = words[3]};
+                break;
+            case spv::OpTypeImage:
+                m_types[words[1]] = Type{.op = op, .elementType = words[2], .dim = static_cast<spv::Dim>(words[3]), .sampled = words[7]};
+                break;
+            case spv::OpTypeSampledImage:
+            case spv::OpTypeRuntimeArray:
+                m_types[words[1]] = Type{.op = op, .elementType = words[2]};
+                break;
+            case spv::OpTypeArray:
+                m_types[words[1]] = Type{.op = op, .elementType = words[2], .lengthId = words[3]};
+                break;
+            case spv::OpTypeStruct:
+                m_types[words[1]] = Type{.op = op, .members = std::vector<uint32_t>(words + 2, words + wordCount)};
+                break;
+            case spv::OpTypePointer:
+                m_types[words[1]] = Type{.op = op, .elementType = words[3], .storageClass = static_cast<spv::StorageClass>(words[2])};
+                break;
+            case spv::OpConstant:
+                m_constants[words[2]] = words[3];
+                break;
+            case spv::OpSpecConstant:
+                m_specConstants[words[2]] = words[3];
+                break;
+            case spv::OpConstantComposite:
+            case spv::OpSpecConstantComposite:
+                m_composites[words[2]] = std::vector<uint32_t>(words + 3, words + wordCount);
+                break;
+            case spv::OpVariable:
+                m_variables.push_back(Variable{words[2], words[1], static_cast<spv::StorageClass>(words[3])});
+                break;
+            default:
+                break;
+        }
+    }
+
+private:
+    std::unordered_map<uint32_t, Type> m_types;
+    std::unordered_map<uint32_t, Decorations> m_decorations;
+    std::unordered_map<uint32_t, std::string> m_names;
+    std::unordered_map<uint32_t, uint32_t> m_constants;
+    // default values
+    std::unordered_map<uint32_t, uint32_t> m_specConstants;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> m_composites;
+    std::vector<Variable> m_variables;
+    vk::Extent3D m_localSize{0, 0, 0};
+    std::optional<std::array<uint32_t, 3>> m_localSizeIds;
+    std::optional<uint32_t> m_workgroupSizeId;
+};
+
+vk::DescriptorType getDescriptorType(const Module& module, const Variable& variable, uint32_t typeId) {
+    const Type& type = module.getType(typeId);
+    switch (variable.storageClass) {
+        case spv::StorageClassStorageBuffer:
+            return vk::DescriptorType::eStorageBuffer;
+        case spv::StorageClassUniform:
+            // pre 1.3 spirv marks storage buffers as Uniform + BufferBlock
+            return module.getDecorations(typeId).bufferBlock ? vk::DescriptorType::eStorageBuffer : vk::DescriptorType::eUniformBuffer;
+        case spv::StorageClassUniformConstant:
+            switch (type.op) {
+                case spv::OpTypeSampler:                  return vk::DescriptorType::eSampler;
+                case spv::OpTypeSampledImage:             return vk::DescriptorType::eCombinedImageSampler;
+                case spv::OpTypeAccelerationStructureKHR: return vk::DescriptorType::eAccelerationStructureKHR;
+                case spv::OpTypeImage:
+                    if (type.dim == spv::DimBuffer)      return type.sampled == 1 ? vk::DescriptorType::eUniformTexelBuffer : vk::DescriptorType::eStorageTexelBuffer;
+                    if (type.dim == spv::DimSubpassData) return vk::DescriptorType::eInputAttachment;
+                    return type.sampled == 1 ? vk::DescriptorType::eSampledImage : vk::DescriptorType::eStorageImage;
+                default: break;
+            }
+            break;
+        default:
+            break;
+    }
+    throw std::runtime_error("Cannot reflect the descriptor type of " + module.getName(variable.id));
+}
+
+vk::Format getVertexFormat(const Module& module, uint32_t typeId) {
+    const Type *type = &module.getType(typeId);
+    uint32_t count = 1;
+    if (type->op == spv::OpTypeVector) {
+        count = type->count;
+        type = &module.getType(type->elementType);
+    }
+    static constexpr vk::Format floatFormats[]  = { vk::Format::eR32Sfloat, vk::Format::eR32G32Sfloat, vk::Format::eR32G32B32Sfloat, vk::Format::eR32G32B32A32Sfloat };
+    static constexpr vk::Format doubleFormats[] = { vk::Format::eR64Sfloat, vk::Format::eR64G64Sfloat, vk::Format::eR64G64B64Sfloat, vk::Format::eR64G64B64A64Sfloat };
+    static constexpr vk::Format intFormats[]    = { vk::Format::eR32Sint,   vk::Format::eR32G32Sint,   vk::Format::eR32G32B32Sint,   vk::Format::eR32G32B32A32Sint };
+    static constexpr vk::Format uintFormats[]   = { vk::Format::eR32Uint,   vk::Format::eR32G32Uint,   vk::Format::eR32G32B32Uint,   vk::Format::eR32G32B32A32Uint };
+    if (count >= 1 && count <= 4) {
+        if (type->op == spv::OpTypeFloat && type->width == 32) return floatFormats[count - 1];
+        if (type->op == spv::OpTypeFloat && type->width == 64) return doubleFormats[count - 1];
+        if (type->op == spv::OpTypeInt && type->width == 32)   return type->isSigned ? intFormats[count - 1] : uintFormats[count - 1];
+    }
+    throw std::runtime_error("Cannot reflect vertex input format, only 32 bit scalars / vectors and doubles are supported");
+}
+
+std::mutex cacheMutex;
+std::unordered_map<uint64_t, ShaderReflection> cache;
+
+} // namespace
+
+ShaderReflection ShaderReflection::reflect(const std::vector<uint32_t>& code, vk::ShaderStageFlagBits stage) {
+    const uint64_t key = core::Hasher{}.add(code.data(), code.size() * sizeof(uint32_t)).add(static_cast<uint32_t>(stage)).get();
+    {
+        std::lock_guard<std::mutex> lock{cacheMutex};
+        auto cached = cache.find(key);
+        if (cached != cache.end()) return cached->second;
+    }
+
+    Module module{code};
+    ShaderReflection shaderReflection;
+
+    for (auto& variable : module.getVariables()) {
+        const Type& pointer = module.getType(variable.typeId);
+        const auto& decorations = module.getDecorations(variable.id);
+
+        switch (variable.storageClass) {
+            case spv::StorageClassUniform:
+            case spv::StorageClassUniformConstant:
+            case spv::StorageClassStorageBuffer: {
+                if (!decorations.binding) break;
+                uint32_t typeId = pointer.elementType;
+                uint32_t descriptorCount = 1;
+                while (module.getType(typeId).op == spv::OpTypeArray || module.getType(typeId).op == spv::OpTypeRuntimeArray) {
+                    const Type& array = module.getType(typeId);
+                    if (array.op == spv::OpTypeRuntimeArray) {
+                        throw std::runtime_error("Cannot reflect " + module.getName(variable.id) + ", unbounded descriptor arrays are not supported");
+                    }
+                    descriptorCount *= module.getArrayLength(array);
+                    typeId = array.elementType;
+                }
+                shaderReflection.m_descriptorSets[decorations.set.value_or(0)][*decorations.binding] = vk::DescriptorSetLayoutBinding{}
+                    .setBinding(*decorations.binding)
+                    .setDescriptorType(getDescriptorType(module, variable, typeId))
+                    .setDescriptorCount(descriptorCount)
+                    .setStageFlags(stage);
+                break;
+            }
+            case spv::StorageClassPushConstant: {
+                const auto& blockDecorations = module.getDecorations(pointer.elementType);
+                uint32_t offset = 0;
+                if (!blockDecorations.memberOffsets.empty()) {
+                    offset = std::min_element(blockDecorations.memberOffsets.begin(), blockDecorations.memberOffsets.end(), 
+                        [](auto& a, auto& b) { return a.second < b.second; })->second;
+                }
+                uint32_t size = module.getTypeSize(pointer.elementType);
+                shaderReflection.m_pushConstantRanges.push_back(vk::PushConstantRange{}
+                    .setStageFlags(stage)
+                    .setOffset(offset)
+                    .setSize(size - offset));
+                break;
+            }
+            case spv::StorageClassInput: {
+                if (stage != vk::ShaderStageFlagBits::eVertex || decorations.builtIn || !decorations.location) break;
+                if (module.getDecorations(pointer.elementType).builtIn) break;
+                shaderReflection.m_vertexAttributes.push_back(VertexAttribute{
+                    *decorations.location, 
+                    getVertexFormat(module, pointer.elementType), 
+                    module.getTypeSize(pointer.elementType), 
+                    module.getName(variable.id)});
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    std::sort(shaderReflection.m_vertexAttributes.begin(), shaderReflection.m_vertexAttributes.end(), 
+        [](auto& a, auto& b) { return a.location < b.location; });
+    if (stage == vk::ShaderStageFlagBits::eCompute) {
+        auto localSize = module.getLocalSize();
+        shaderReflection.m_workgroupSize = vk::Extent3D{localSize.size[0], localSize.size[1], localSize.size[2]};
+        shaderReflection.m_workgroupSizeConstantIds = localSize.constantIds;
+    }
+
+    std::lock_guard<std::mutex> lock{cacheMutex};
+    cache.emplace(key, shaderReflection);
+    return shaderReflection;
+}
+
+void ShaderReflection::merge(const ShaderReflection& shaderReflection) {
+    for (auto& [set, descriptorBindingDescriptions] : shaderReflection.m_descriptorSets) {
+        auto& mergedDescriptorBindingDescriptions = m_descriptorSets[set];
+        for (auto& [binding, descriptorSetLayoutBinding] : descriptorBindingDescriptions) {
+            auto merged = mergedDescriptorBindingDescriptions.find(binding);
+            if (merged == mergedDescriptorBindingDescriptions.end()) {
+                mergedDescriptorBindingDescriptions[binding] = descriptorSetLayoutBinding;
+                continue;
+            }
+            if (merged->second.descriptorType != descriptorSetLayoutBinding.descriptorType || merged->second.descriptorCount != descriptorSetLayoutBinding.descriptorCount) {
+                throw std::runtime_error("Shader stages disagree on set " + std::to_string(set) + " binding " + std::to_string(binding) + "!");
+            }
+            merged->second.stageFlags |= descriptorSetLayoutBinding.stageFlags;
+        }
+    }
+    for (auto& pushConstantRange : shaderReflection.m_pushConstantRanges) {
+        auto merged = std::find_if(m_pushConstantRanges.begin(), m_pushConstantRanges.end(), [&](auto& range) {
+            return range.offset == pushConstantRange.offset && range.size == pushConstantRange.size;
+        });
+        if (merged == m_pushConstantRanges.end()) {
+            m_pushConstantRanges.push_back(pushConstantRange);
+        } else {
+            merged->stageFlags |= pushConstantRange.stageFlags;
+        }
+    }
+    if (m_vertexAttributes.empty()) {
+        m_vertexAttributes = shaderReflection.m_vertexAttributes;
+    }
+    if (m_workgroupSize.width == 0) {
+        m_workgroupSize = shaderReflection.m_workgroupSize;
+        m_workgroupSizeConstantIds = shaderReflection.m_workgroupSizeConstantIds;
+    }
+}
+
+std::vector<DescriptorSetLayout::Builder> ShaderReflection::getDescriptorSetLayoutBuilders() const {
+    if (m_descriptorSets.empty()) return {};
+    std::vector<DescriptorSetLayout::Builder> descriptorSetLayoutBuilders(m_descriptorSets.rbegin()->first + 1);
+    for (auto& [set, descriptorBindingDescriptions] : m_descriptorSets) {
+        for (auto& [binding, descriptorSetLayoutBinding] : descriptorBindingDescriptions) {
+            descriptorSetLayoutBuilders[set].addBinding(binding, descriptorSetLayoutBinding.descriptorType, descriptorSetLayoutBinding.stageFlags, descriptorSetLayoutBinding.descriptorCount);
+        }
+    }
+    return descriptorSetLayoutBuilders;
+}
+
+vk::VertexInputBindingDescription ShaderReflection::getVertexInputBindingDescription(uint32_t binding) const {
+    uint32_t stride = 0;
+    for (auto& vertexAttribute : m_vertexAttributes) {
+        stride += vertexAttribute.size;
+    }
+    return vk::VertexInputBindingDescription{}
+        .setBinding(binding)
+        .setStride(stride)
+        .setInputRate(vk::VertexInputRate::eVertex);
+}
+
+std::vector<vk::VertexInputAttributeDescription> ShaderReflection::getVertexInputAttributeDescriptions(uint32_t binding) const {
+    std::vector<vk::VertexInputAttributeDescription> vertexInputAttributeDescriptions;
+    vertexInputAttributeDescriptions.reserve(m_vertexAttributes.size());
+    uint32_t offset = 0;
+    for (auto& vertexAttribute : m_vertexAttributes) {
+        vertexInputAttributeDescriptions.push_back(vk::VertexInputAttributeDescription{}
+            .setBinding(binding)
+            .setLocation(vertexAttribute.location)
+            .setFormat(vertexAttribute.format)
+            .setOffset(offset));
+        offset += vertexAttribute.size;
+    }
+    return vertexInputAttributeDescriptions;
+}
+
+} // namespace gfx
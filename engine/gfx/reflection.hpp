@@ -0,0 +1,48 @@
+#ifndef GFX_REFLECTION_HPP
+#define GFX_REFLECTION_HPP
+
+#include "descriptors.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace gfx {
+
+// what a shader expects from its pipeline layout and vertex input, read straight from its spirv
+class ShaderReflection {
+public:
+    struct VertexAttribute {
+        uint32_t location;
+        vk::Format format;
+        uint32_t size;
+        std::string name;
+    };
+
+    // results are cached by the hash of the code, reflecting the same module twice is a lookup
+    static ShaderReflection reflect(const std::vector<uint32_t>& code, vk::ShaderStageFlagBits stage);
+
+    // combines the interface of another stage into this one, stage flags of shared bindings are or'ed
+    // throws if both stages declare the same binding with different types
+    void merge(const ShaderReflection& shaderReflection);
+
+    // the builder for every set the shaders use, sets in between that nothing uses get an empty builder
+    std::vector<DescriptorSetLayout::Builder> getDescriptorSetLayoutBuilders() const;
+    // one interleaved, tightly packed binding with the attributes in location order
+    vk::VertexInputBindingDescription getVertexInputBindingDescription(uint32_t binding = 0) const;
+    std::vector<vk::VertexInputAttributeDescription> getVertexInputAttributeDescriptions(uint32_t binding = 0) const;
+
+    std::map<uint32_t, DescriptorBindingDescriptions> m_descriptorSets;
+    std::vector<vk::PushConstantRange> m_pushConstantRanges;
+    std::vector<VertexAttribute> m_vertexAttributes;  // vertex stage only, sorted by location
+    vk::Extent3D m_workgroupSize{0, 0, 0};            // compute stage only, the defaults for the dimensions below
+    std::array<std::optional<uint32_t>, 3> m_workgroupSizeConstantIds;  // compute stage only, the constant_id of the dimensions set by local_size_*_id
+};
+
+} // namespace gfx
+
+#endif
@@ -1,5 +1,7 @@
 #include "renderpass.hpp"
 
+#include "../core/hash.hpp"
+
 namespace gfx {
 
 // **********RenderPass::Builder**********
@@ -73,24 +75,48 @@ RenderPass RenderPass::Builder::build(std::shared_ptr<Device> device) {
 
     INFO("Created Render Pass!");
 
-    return {device, renderPass};
+    return {device, renderPass, getCompatibilityHash()};
+}
+
+uint64_t RenderPass::Builder::getCompatibilityHash() const {
+    // only the format and sample count of every referenced attachment matter, load / store ops and layouts do not
+    core::Hasher hasher;
+    auto addReference = [&](const vk::AttachmentReference& attachmentReference) {
+        if (attachmentReference.attachment == VK_ATTACHMENT_UNUSED || attachmentReference.attachment >= m_attachmentDescriptions.size()) {
+            hasher.add(VK_ATTACHMENT_UNUSED);
+            return;
+        }
+        auto& attachmentDescription = m_attachmentDescriptions[attachmentReference.attachment];
+        hasher.add(attachmentDescription.format).add(attachmentDescription.samples);
+    };
+    hasher.add(m_renderPassCreateInfo.flags).add(m_subpassDescription.flags).add(m_subpassDescription.pipelineBindPoint);
+    hasher.add(static_cast<uint32_t>(m_colorAttachmentRefrences.size()));
+    for (auto& colorAttachmentRefrence : m_colorAttachmentRefrences) addReference(colorAttachmentRefrence);
+    hasher.add(static_cast<uint32_t>(m_inputAttachmentRefrences.size()));
+    for (auto& inputAttachmentRefrence : m_inputAttachmentRefrences) addReference(inputAttachmentRefrence);
+    hasher.add(setDepthStencilAttachment);
+    if (setDepthStencilAttachment) addReference(m_depthStencilAttachmentRefrence);
+    hasher.add(setResolveAttachment);
+    if (setResolveAttachment) addReference(m_resolveAttachmentRefrence);
+    return hasher.get();
 }
 
 // **********RenderPass**********
-RenderPass::RenderPass(std::shared_ptr<Device> device, vk::RenderPass renderPass) : m_device(device), m_renderPass(renderPass) {}
+RenderPass::RenderPass(std::shared_ptr<Device> device, vk::RenderPass renderPass, uint64_t compatibilityHash) : m_device(device), m_renderPass(renderPass), m_compatibilityHash(compatibilityHash) {}
 
 RenderPass::~RenderPass() {
     if (m_renderPass) m_device->get().destroyRenderPass(m_renderPass);
     m_renderPass = VK_NULL_HANDLE;
 }
 
-RenderPass::RenderPass(RenderPass&& renderPass) : m_device(renderPass.m_device), m_renderPass(renderPass.m_renderPass) {
+RenderPass::RenderPass(RenderPass&& renderPass) : m_device(renderPass.m_device), m_renderPass(renderPass.m_renderPass), m_compatibilityHash(renderPass.m_compatibilityHash) {
     renderPass.m_renderPass = VK_NULL_HANDLE;
 }
 
 RenderPass& RenderPass::operator=(RenderPass&& renderPass) {
     m_device = renderPass.m_device;
     m_renderPass = renderPass.m_renderPass;
+    m_compatibilityHash = renderPass.m_compatibilityHash;
     renderPass.m_device = nullptr;
     renderPass.m_renderPass = VK_NULL_HANDLE;
     return *this;
@@ -111,6 +137,11 @@ RenderPass::BeginInfo& RenderPass::BeginInfo::addClearValue(const vk::ClearValue
     return *this;
 }
 
+RenderPass::BeginInfo& RenderPass::BeginInfo::setSubpassContents(vk::SubpassContents subpassContents) {
+    m_subpassContents = subpassContents;
+    return *this;
+}
+
 void RenderPass::begin(const CommandBuffer& commandBuffer, const BeginInfo& beginInfo) {
     vk::RenderPassBeginInfo renderPassBeginInfo = vk::RenderPassBeginInfo{}
         .setRenderPass(m_renderPass)
@@ -119,7 +150,7 @@ void RenderPass::begin(const CommandBuffer& commandBuffer, const BeginInfo& begi
         .setClearValueCount(beginInfo.m_clearValues.size())
         .setPClearValues(beginInfo.m_clearValues.data());
     
-    commandBuffer.get().beginRenderPass(&renderPassBeginInfo, vk::SubpassContents::eInline);
+    commandBuffer.get().beginRenderPass(&renderPassBeginInfo, beginInfo.m_subpassContents);
 }
 
 void RenderPass::end(const CommandBuffer& commandBuffer) {
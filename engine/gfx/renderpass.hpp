@@ -23,6 +23,8 @@ public:
         Builder& setRenderpassFlags(vk::RenderPassCreateFlags renderpassCreateFlags);
 
         RenderPass build(std::shared_ptr<Device> device);
+        // equal for render passes a pipeline can be used with interchangeably, see render pass compatibility in the spec
+        uint64_t getCompatibilityHash() const;
         
         std::vector<vk::AttachmentReference> m_colorAttachmentRefrences;
         vk::AttachmentReference m_depthStencilAttachmentRefrence;
@@ -36,7 +38,7 @@ public:
         bool setResolveAttachment = false, setDepthStencilAttachment = false;
     };
     
-    RenderPass() : m_device(nullptr), m_renderPass(VK_NULL_HANDLE) {}
+    RenderPass() : m_device(nullptr), m_renderPass(VK_NULL_HANDLE), m_compatibilityHash(0) {}
     
     ~RenderPass();
 
@@ -46,26 +48,31 @@ public:
     RenderPass& operator=(RenderPass&& renderPass);
 
     vk::RenderPass get() const { return m_renderPass; }
+    uint64_t getCompatibilityHash() const { return m_compatibilityHash; }
 
     struct BeginInfo {
         BeginInfo& setFrameBuffer(const FrameBuffer& frameBuffer);
         BeginInfo& setRenderArea(const vk::Rect2D& renderArea);
         BeginInfo& addClearValue(const vk::ClearValue& clearValue);
+        // eSecondaryCommandBuffers when the subpass is recorded into secondary command buffers and only executed from the primary
+        BeginInfo& setSubpassContents(vk::SubpassContents subpassContents);
         
         vk::Framebuffer m_frameBuffer;
         vk::Rect2D m_renderArea;
         std::vector<vk::ClearValue> m_clearValues;
+        vk::SubpassContents m_subpassContents = vk::SubpassContents::eInline;
     };
 
     void begin(const CommandBuffer& commandBuffer, const BeginInfo& beginInfo);
     void end(const CommandBuffer& commandBuffer);
 
 private:
-    RenderPass(std::shared_ptr<Device> device, vk::RenderPass renderPass);
+    RenderPass(std::shared_ptr<Device> device, vk::RenderPass renderPass, uint64_t compatibilityHash);
 
 private:
     std::shared_ptr<Device> m_device;
     vk::RenderPass m_renderPass;
+    uint64_t m_compatibilityHash;
 };
 
 } // namespace gfx
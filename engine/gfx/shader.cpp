@@ -0,0 +1,401 @@
+#include "shader.hpp"
+
+#include "../core/log.hpp"
+#include "../core/file.hpp"
+#include "../core/hash.hpp"
+
+#ifdef ENGINE_RUNTIME_SHADER_COMPILER
+#include <shaderc/shaderc.hpp>
+#include <spirv-tools/optimizer.hpp>
+#endif
+
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <sstream>
+
+// set by the build from the revisions of shaderc, glslang and SPIRV-Tools
+#ifndef ENGINE_SHADER_TOOLCHAIN_VERSION
+#define ENGINE_SHADER_TOOLCHAIN_VERSION "unknown"
+#endif
+
+namespace gfx {
+
+// bump whenever the cache file layout or anything that changes the generated spirv without changing the key does
+static constexpr uint32_t CACHE_VERSION = 4;
+static constexpr uint32_t CACHE_MAGIC = 0x43565053;  // "SPVC"
+
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t dependencyCount;
+    uint32_t codeWordCount;
+};
+
+std::filesystem::path ShaderCompiler::m_cacheDirectory = "shadercache";
+bool ShaderCompiler::m_cacheEnabled = true;
+std::vector<std::filesystem::path> ShaderCompiler::m_includeDirectories{};
+#ifdef NDEBUG
+ShaderCompiler::OptimizationLevel ShaderCompiler::m_defaultOptimizationLevel = ShaderCompiler::OptimizationLevel::ePerformance;
+#else
+ShaderCompiler::OptimizationLevel ShaderCompiler::m_defaultOptimizationLevel = ShaderCompiler::OptimizationLevel::eZero;
+#endif
+
+#ifdef ENGINE_RUNTIME_SHADER_COMPILER
+// resolves #include for shaderc and records every file it hands out
+class Includer : public shaderc::CompileOptions::IncluderInterface {
+public:
+    Includer(std::vector<std::filesystem::path> includeDirectories) : m_includeDirectories(std::move(includeDirectories)) {}
+
+    shaderc_include_result *GetInclude(const char *requestedSource, shaderc_include_type type, const char *requestingSource, size_t includeDepth) override {
+        auto include = new Include{};
+        auto resolvedPath = resolve(requestedSource, type, requestingSource);
+        auto content = resolvedPath ? core::tryReadFile(*resolvedPath) : std::nullopt;
+        if (content) {
+            include->sourceName = resolvedPath->string();
+            include->content = std::move(*content);
+            m_dependencies[include->sourceName] = core::Hasher{}.add(std::string_view{include->content}).get();
+        } else {
+            // an empty source name tells shaderc the include failed, the content is the error message
+            include->content = "Failed to resolve include \"" + std::string{requestedSource} + "\" from " + requestingSource;
+        }
+        include->result.source_name = include->sourceName.c_str();
+        include->result.source_name_length = include->sourceName.size();
+        include->result.content = include->content.c_str();
+        include->result.content_length = include->content.size();
+        include->result.user_data = include;
+        return &include->result;
+    }
+
+    void ReleaseInclude(shaderc_include_result *data) override {
+        delete static_cast<Include *>(data->user_data);
+    }
+
+    std::vector<ShaderCompiler::Dependency> getDependencies() const {
+        std::vector<ShaderCompiler::Dependency> dependencies;
+        dependencies.reserve(m_dependencies.size());
+        for (auto& [path, contentHash] : m_dependencies) {
+            dependencies.push_back({path, contentHash});
+        }
+        return dependencies;
+    }
+
+private:
+    struct Include {
+        shaderc_include_result result;
+        std::string sourceName;
+        std::string content;
+    };
+
+    std::optional<std::filesystem::path> resolve(const std::filesystem::path& requestedSource, shaderc_include_type type, const std::filesystem::path& requestingSource) const {
+        if (type == shaderc_include_type_relative) {
+            auto path = (requestingSource.parent_path() / requestedSource).lexically_normal();
+            if (std::filesystem::is_regular_file(path)) return path;
+        }
+        for (auto& includeDirectory : m_includeDirectories) {
+            auto path = (includeDirectory / requestedSource).lexically_normal();
+            if (std::filesystem::is_regular_file(path)) return path;
+        }
+        return std::nullopt;
+    }
+
+private:
+    std::vector<std::filesystem::path> m_includeDirectories;
+    // a header included from several places (or guarded and included twice) is only recorded once
+    std::map<std::string, uint64_t> m_dependencies;
+};
+#endif
+
+// **********ShaderCompiler::CompileInfo**********
+ShaderCompiler::CompileInfo::CompileInfo() : m_stage(vk::ShaderStageFlagBits::eVertex) {}
+
+ShaderCompiler::CompileInfo& ShaderCompiler::CompileInfo::setPath(const std::filesystem::path& path) {
+    m_path = path;
+    m_stage = getStageFromPath(path);
+    return *this;
+}
+
+ShaderCompiler::CompileInfo& ShaderCompiler::CompileInfo::setStage(vk::ShaderStageFlagBits stage) {
+    m_stage = stage;
+    return *this;
+}
+
+ShaderCompiler::CompileInfo& ShaderCompiler::CompileInfo::addDefine(const std::string& name, const std::string& value) {
+    m_defines.emplace_back(name, value);
+    return *this;
+}
+
+ShaderCompiler::CompileInfo& ShaderCompiler::CompileInfo::addIncludeDirectory(const std::filesystem::path& includeDirectory) {
+    m_includeDirectories.push_back(includeDirectory);
+    return *this;
+}
+
+ShaderCompiler::CompileInfo& ShaderCompiler::CompileInfo::setOptimizationLevel(OptimizationLevel optimizationLevel) {
+    m_optimizationLevel = optimizationLevel;
+    return *this;
+}
+
+ShaderCompiler::CompileInfo& ShaderCompiler::CompileInfo::addOptimizerPass(const std::string& optimizerPass) {
+    m_optimizerPasses.push_back(optimizerPass);
+    return *this;
+}
+
+// **********ShaderCompiler**********
+void ShaderCompiler::setCacheDirectory(const std::filesystem::path& cacheDirectory) {
+    m_cacheDirectory = cacheDirectory;
+}
+
+void ShaderCompiler::setCacheEnabled(bool enable) {
+    m_cacheEnabled = enable;
+}
+
+void ShaderCompiler::setDefaultOptimizationLevel(OptimizationLevel optimizationLevel) {
+    m_defaultOptimizationLevel = optimizationLevel;
+}
+
+void ShaderCompiler::addIncludeDirectory(const std::filesystem::path& includeDirectory) {
+    m_includeDirectories.push_back(includeDirectory);
+}
+
+vk::ShaderStageFlagBits ShaderCompiler::getStageFromPath(const std::filesystem::path& path) {
+    auto extension = path.extension().string();
+    if (extension == ".vert") return vk::ShaderStageFlagBits::eVertex;
+    if (extension == ".frag") return vk::ShaderStageFlagBits::eFragment;
+    if (extension == ".geom") return vk::ShaderStageFlagBits::eGeometry;
+    if (extension == ".comp") return vk::ShaderStageFlagBits::eCompute;
+    throw std::runtime_error("Unknown shader extension: " + path.string());
+}
+
+#ifdef ENGINE_RUNTIME_SHADER_COMPILER
+static shaderc_shader_kind getShaderKind(vk::ShaderStageFlagBits stage) {
+    switch (stage) {
+        case vk::ShaderStageFlagBits::eVertex:   return shaderc_shader_kind::shaderc_glsl_vertex_shader;
+        case vk::ShaderStageFlagBits::eFragment: return shaderc_shader_kind::shaderc_glsl_fragment_shader;
+        case vk::ShaderStageFlagBits::eGeometry: return shaderc_shader_kind::shaderc_glsl_geometry_shader;
+        case vk::ShaderStageFlagBits::eCompute:  return shaderc_shader_kind::shaderc_glsl_compute_shader;
+        default:
+            throw std::runtime_error("Unsupported shader stage " + vk::to_string(stage));
+    }
+}
+
+#endif
+
+// the ones of the compile info come first
+static std::vector<std::filesystem::path> collectIncludeDirectories(const ShaderCompiler::CompileInfo& compileInfo) {
+    std::vector<std::filesystem::path> includeDirectories = compileInfo.m_includeDirectories;
+    auto& globalIncludeDirectories = ShaderCompiler::getIncludeDirectories();
+    includeDirectories.insert(includeDirectories.end(), globalIncludeDirectories.begin(), globalIncludeDirectories.end());
+    return includeDirectories;
+}
+
+static ShaderCompiler::OptimizationLevel getOptimizationLevel(const ShaderCompiler::CompileInfo& compileInfo) {
+    return compileInfo.m_optimizationLevel.value_or(ShaderCompiler::getDefaultOptimizationLevel());
+}
+
+#ifdef ENGINE_RUNTIME_SHADER_COMPILER
+static shaderc_optimization_level getShadercOptimizationLevel(const ShaderCompiler::CompileInfo& compileInfo) {
+    switch (getOptimizationLevel(compileInfo)) {
+        case ShaderCompiler::OptimizationLevel::eZero:        return shaderc_optimization_level_zero;
+        case ShaderCompiler::OptimizationLevel::eSize:        return shaderc_optimization_level_size;
+        case ShaderCompiler::OptimizationLevel::ePerformance: return shaderc_optimization_level_performance;
+    }
+    return shaderc_optimization_level_zero;
+}
+
+// runs the custom spirv-opt passes of compileInfo over code in place
+static void runOptimizerPasses(const ShaderCompiler::CompileInfo& compileInfo, std::vector<uint32_t>& code) {
+    spvtools::Optimizer optimizer{SPV_ENV_VULKAN_1_0};
+    std::string messages;
+    optimizer.SetMessageConsumer([&](spv_message_level_t, const char *, const spv_position_t&, const char *message) {
+        messages += message;
+        messages += "\n\t";
+    });
+    if (!optimizer.RegisterPassesFromFlags(compileInfo.m_optimizerPasses)) {
+        throw std::runtime_error("Invalid optimizer passes for shader: " + compileInfo.m_path.string() + "\n\t" + messages);
+    }
+    std::vector<uint32_t> optimized;
+    if (!optimizer.Run(code.data(), code.size(), &optimized)) {
+        throw std::runtime_error("Failed to optimize shader: " + compileInfo.m_path.string() + "\n\t" + messages);
+    }
+    code = std::move(optimized);
+}
+#endif
+
+uint64_t ShaderCompiler::getCacheKey(const CompileInfo& compileInfo, const std::string& source) {
+    // everything that ends up in the CompileOptions has to be part of the key
+    core::Hasher hasher;
+    hasher.add(CACHE_VERSION)
+          // a different compiler or optimizer can emit different spirv for the same input
+          .add(std::string_view{ENGINE_SHADER_TOOLCHAIN_VERSION})
+          .add(source)
+          .add(std::string_view{compileInfo.m_path.string()})  // includes resolve relative to it
+          .add(static_cast<uint32_t>(compileInfo.m_stage))
+          // the engine's own enum, so builds with and without shaderc share cache entries
+          .add(static_cast<uint32_t>(getOptimizationLevel(compileInfo)))
+          .add(static_cast<uint64_t>(compileInfo.m_defines.size()));
+    for (auto& [name, value] : compileInfo.m_defines) {
+        hasher.add(std::string_view{name}).add(std::string_view{value});
+    }
+    hasher.add(static_cast<uint64_t>(compileInfo.m_optimizerPasses.size()));
+    for (auto& optimizerPass : compileInfo.m_optimizerPasses) {
+        hasher.add(std::string_view{optimizerPass});
+    }
+    // the included files themselves are checked against the hashes stored with the entry
+    for (auto& includeDirectory : collectIncludeDirectories(compileInfo)) {
+        hasher.add(std::string_view{includeDirectory.string()});
+    }
+    return hasher.get();
+}
+
+std::filesystem::path ShaderCompiler::getCachePath(uint64_t key) {
+    std::stringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << ".spvcache";
+    return m_cacheDirectory / name.str();
+}
+
+std::optional<std::vector<uint32_t>> ShaderCompiler::loadFromCache(uint64_t key, std::vector<Dependency>& dependencies) {
+    auto data = core::tryReadFile(getCachePath(key));
+    if (!data) return std::nullopt;
+
+    size_t offset = 0;
+    auto read = [&](void *dst, size_t size) {
+        if (offset + size > data->size()) return false;
+        std::memcpy(dst, data->data() + offset, size);
+        offset += size;
+        return true;
+    };
+
+    CacheHeader header;
+    if (!read(&header, sizeof(header)) || header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.key != key) {
+        return std::nullopt;
+    }
+    // the key only covers the main source, anything it pulled in has to be unchanged as well
+    for (uint32_t i = 0; i < header.dependencyCount; i++) {
+        uint32_t pathLength;
+        uint64_t contentHash;
+        if (!read(&pathLength, sizeof(pathLength))) return std::nullopt;
+        std::string path(pathLength, '\0');
+        if (!read(path.data(), pathLength) || !read(&contentHash, sizeof(contentHash))) return std::nullopt;
+        auto dependencySource = core::tryReadFile(path);
+        if (!dependencySource || core::Hasher{}.add(std::string_view{*dependencySource}).get() != contentHash) {
+            return std::nullopt;
+        }
+        dependencies.push_back({path, contentHash});
+    }
+    std::vector<uint32_t> code(header.codeWordCount);
+    if (!read(code.data(), code.size() * sizeof(uint32_t))) return std::nullopt;
+    return code;
+}
+
+void ShaderCompiler::storeToCache(uint64_t key, const std::vector<uint32_t>& code, const std::vector<Dependency>& dependencies) {
+    CacheHeader header{};
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.key = key;
+    header.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    header.codeWordCount = static_cast<uint32_t>(code.size());
+
+    std::string data;
+    data.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (auto& dependency : dependencies) {
+        std::string path = dependency.path.string();
+        uint32_t pathLength = static_cast<uint32_t>(path.size());
+        data.append(reinterpret_cast<const char *>(&pathLength), sizeof(pathLength));
+        data.append(path);
+        data.append(reinterpret_cast<const char *>(&dependency.contentHash), sizeof(dependency.contentHash));
+    }
+    data.append(reinterpret_cast<const char *>(code.data()), code.size() * sizeof(uint32_t));
+
+    core::writeFileAtomic(getCachePath(key), data);
+}
+
+ShaderCompiler::Result ShaderCompiler::compile(const CompileInfo& compileInfo) {
+    const auto source = core::readFile(compileInfo.m_path);
+    const uint64_t key = getCacheKey(compileInfo, source);
+
+    if (m_cacheEnabled) {
+        std::vector<Dependency> dependencies;
+        if (auto code = loadFromCache(key, dependencies)) {
+            INFO("Loaded shader {} from cache", compileInfo.m_path.filename().string());
+            return {std::move(*code), compileInfo.m_stage, true, std::move(dependencies)};
+        }
+    }
+
+#ifdef ENGINE_RUNTIME_SHADER_COMPILER
+    // shaderc::Compiler is not safe to use from several threads at once
+    thread_local shaderc::Compiler compiler;
+    shaderc::CompileOptions options;
+    options.SetOptimizationLevel(getShadercOptimizationLevel(compileInfo));
+    for (auto& [name, value] : compileInfo.m_defines) {
+        options.AddMacroDefinition(name, value);
+    }
+    // owned by the options, which outlive the compilation
+    auto includerPtr = std::make_unique<Includer>(collectIncludeDirectories(compileInfo));
+    Includer& includer = *includerPtr;
+    options.SetIncluder(std::move(includerPtr));
+
+    const auto name = compileInfo.m_path.filename().string();
+    // the full path as the source name, relative includes resolve against it
+    shaderc::SpvCompilationResult module = compiler.CompileGlslToSpv(source, getShaderKind(compileInfo.m_stage), compileInfo.m_path.string().c_str(), options);
+
+    if (module.GetCompilationStatus() != shaderc_compilation_status_success) {
+        throw std::runtime_error("Failed to compile shader: " + compileInfo.m_path.string() + "\n\t" + module.GetErrorMessage());
+    }
+
+    INFO("Successfully compiled shader {}", name);
+
+    std::vector<uint32_t> code{ module.cbegin(), module.cend() };
+    if (!compileInfo.m_optimizerPasses.empty()) {
+        runOptimizerPasses(compileInfo, code);
+    }
+
+    if (m_cacheEnabled) {
+        storeToCache(key, code, includer.getDependencies());
+    }
+
+    return {std::move(code), compileInfo.m_stage, false, includer.getDependencies()};
+#else
+    throw std::runtime_error("Shader " + compileInfo.m_path.string() + " is not in the cache and the engine was built without the runtime shader compiler!");
+#endif
+}
+
+std::shared_future<ShaderCompiler::Result> ShaderCompiler::compileAsync(const CompileInfo& compileInfo) {
+    return getThreadPool().submit([compileInfo]() { return compile(compileInfo); }).share();
+}
+
+std::vector<ShaderCompiler::Result> ShaderCompiler::compileAll(const std::vector<CompileInfo>& compileInfos) {
+    std::vector<std::shared_future<Result>> futures;
+    futures.reserve(compileInfos.size());
+    for (auto& compileInfo : compileInfos) {
+        futures.push_back(compileAsync(compileInfo));
+    }
+    std::vector<Result> results;
+    results.reserve(compileInfos.size());
+    for (auto& future : futures) {
+        results.push_back(future.get());
+    }
+    return results;
+}
+
+std::shared_future<ShaderCompiler::Result> ShaderCompiler::fromSpirv(std::span<const uint32_t> code, vk::ShaderStageFlagBits stage) {
+    std::promise<Result> promise;
+    promise.set_value({std::vector<uint32_t>{code.begin(), code.end()}, stage, true, {}});
+    return promise.get_future().share();
+}
+
+bool ShaderCompiler::isRuntimeCompilerAvailable() {
+#ifdef ENGINE_RUNTIME_SHADER_COMPILER
+    return true;
+#else
+    return false;
+#endif
+}
+
+core::ThreadPool& ShaderCompiler::getThreadPool() {
+    static core::ThreadPool threadPool;
+    return threadPool;
+}
+
+} // namespace gfx
@@ -0,0 +1,107 @@
+#ifndef GFX_SHADER_HPP
+#define GFX_SHADER_HPP
+
+#include "../core/threadpool.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <filesystem>
+#include <future>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace gfx {
+
+// compiles glsl to spirv through shaderc, results are kept in a content addressed on disk cache
+// so a warm start never touches shaderc
+// built without ENGINE_RUNTIME_SHADER_COMPILER there is no shaderc, compile only serves cache hits and throws otherwise
+// compile is thread safe, every thread gets its own shaderc::Compiler; the cache settings are not and should be set up front
+class ShaderCompiler {
+public:
+    enum class OptimizationLevel {
+        eZero,          // fastest compile, keeps debug names
+        eSize,
+        ePerformance,
+    };
+
+    struct CompileInfo {
+        CompileInfo();
+
+        // also picks the stage from the extension (.vert .frag .geom .comp)
+        CompileInfo& setPath(const std::filesystem::path& path);
+        CompileInfo& setStage(vk::ShaderStageFlagBits stage);
+        CompileInfo& addDefine(const std::string& name, const std::string& value = "");
+        // searched after the directory of the including file, before the global include directories
+        CompileInfo& addIncludeDirectory(const std::filesystem::path& includeDirectory);
+        // overrides the default optimization level
+        CompileInfo& setOptimizationLevel(OptimizationLevel optimizationLevel);
+        // spirv-opt flags (e.g. "--merge-return", "-O") run in order on the output of shaderc
+        CompileInfo& addOptimizerPass(const std::string& optimizerPass);
+
+        std::filesystem::path m_path;
+        vk::ShaderStageFlagBits m_stage;
+        std::vector<std::pair<std::string, std::string>> m_defines;
+        std::vector<std::filesystem::path> m_includeDirectories;
+        std::optional<OptimizationLevel> m_optimizationLevel;
+        std::vector<std::string> m_optimizerPasses;
+    };
+
+    // a file the spirv was built from besides the main source, with the hash of its content at compile time
+    struct Dependency {
+        std::filesystem::path path;
+        uint64_t contentHash;
+    };
+
+    struct Result {
+        std::vector<uint32_t> m_code;
+        vk::ShaderStageFlagBits m_stage;
+        bool m_cacheHit;
+        // every file pulled in through #include, directly or not
+        std::vector<Dependency> m_dependencies;
+    };
+
+    static Result compile(const CompileInfo& compileInfo);
+    // one job on the shared worker pool
+    static std::shared_future<Result> compileAsync(const CompileInfo& compileInfo);
+    // compiles all in parallel, results are in the order of compileInfos
+    static std::vector<Result> compileAll(const std::vector<CompileInfo>& compileInfos);
+    // spirv compiled offline (e.g. embedded by engine_embed_shaders) as an already finished compilation
+    static std::shared_future<Result> fromSpirv(std::span<const uint32_t> code, vk::ShaderStageFlagBits stage);
+    static bool isRuntimeCompilerAvailable();
+
+    // lazily created with one worker per core
+    static core::ThreadPool& getThreadPool();
+
+    // defaults to "shadercache" relative to the working directory
+    static void setCacheDirectory(const std::filesystem::path& cacheDirectory);
+    static const std::filesystem::path& getCacheDirectory() { return m_cacheDirectory; }
+    static void setCacheEnabled(bool enable);
+    static bool isCacheEnabled() { return m_cacheEnabled; }
+    // used by every compile info that does not set its own, ePerformance in release builds and eZero otherwise
+    static void setDefaultOptimizationLevel(OptimizationLevel optimizationLevel);
+    static OptimizationLevel getDefaultOptimizationLevel() { return m_defaultOptimizationLevel; }
+    // searched by every compile for #include "..." after the directory of the including file, and for #include <...>
+    static void addIncludeDirectory(const std::filesystem::path& includeDirectory);
+    static const std::vector<std::filesystem::path>& getIncludeDirectories() { return m_includeDirectories; }
+
+    static vk::ShaderStageFlagBits getStageFromPath(const std::filesystem::path& path);
+
+private:
+    static uint64_t getCacheKey(const CompileInfo& compileInfo, const std::string& source);
+    static std::filesystem::path getCachePath(uint64_t key);
+    static std::optional<std::vector<uint32_t>> loadFromCache(uint64_t key, std::vector<Dependency>& dependencies);
+    static void storeToCache(uint64_t key, const std::vector<uint32_t>& code, const std::vector<Dependency>& dependencies);
+
+private:
+    static std::filesystem::path m_cacheDirectory;
+    static bool m_cacheEnabled;
+    static std::vector<std::filesystem::path> m_includeDirectories;
+    static OptimizationLevel m_defaultOptimizationLevel;
+};
+
+} // namespace gfx
+
+#endif
@@ -0,0 +1,68 @@
+#include "shadermodule.hpp"
+
+#include "../core/hash.hpp"
+
+#include <algorithm>
+
+namespace gfx {
+
+// **********************SHADERMODULE*********************
+ShaderModule::ShaderModule(vk::Device device, std::span<const uint32_t> code) : m_device(device), m_shaderModule(VK_NULL_HANDLE) {
+    vk::ShaderModuleCreateInfo shaderModuleCreateInfo = vk::ShaderModuleCreateInfo{}
+        .setCodeSize(code.size() * sizeof(uint32_t))
+        .setPCode(code.data());
+
+    if (m_device.createShaderModule(&shaderModuleCreateInfo, nullptr, &m_shaderModule) != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create shader module!");
+    }
+}
+
+ShaderModule::~ShaderModule() {
+    destroy();
+}
+
+ShaderModule::ShaderModule(ShaderModule&& shaderModule) : m_device(shaderModule.m_device), m_shaderModule(shaderModule.m_shaderModule) {
+    shaderModule.m_shaderModule = VK_NULL_HANDLE;
+}
+
+ShaderModule& ShaderModule::operator=(ShaderModule&& shaderModule) {
+    destroy();
+    m_device = shaderModule.m_device;
+    m_shaderModule = shaderModule.m_shaderModule;
+    shaderModule.m_shaderModule = VK_NULL_HANDLE;
+    return *this;
+}
+
+void ShaderModule::destroy() {
+    if (m_shaderModule) m_device.destroyShaderModule(m_shaderModule);
+    m_shaderModule = VK_NULL_HANDLE;
+}
+
+// **********************SHADERMODULECACHE*********************
+std::shared_ptr<const ShaderModule> ShaderModuleCache::get(std::span<const uint32_t> code) const {
+    const uint64_t hash = core::Hasher{}.add(code.data(), code.size_bytes()).get();
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    auto [begin, end] = m_entries.equal_range(hash);
+    for (auto entry = begin; entry != end; ++entry) {
+        auto shaderModule = entry->second.shaderModule.lock();
+        if (shaderModule && std::equal(code.begin(), code.end(), entry->second.code.begin(), entry->second.code.end())) {
+            m_hits++;
+            return shaderModule;
+        }
+    }
+
+    m_misses++;
+    // misses are rare enough to drop the entries of modules every pipeline has let go of here
+    std::erase_if(m_entries, [](auto& entry) { return entry.second.shaderModule.expired(); });
+    auto shaderModule = std::make_shared<const ShaderModule>(m_device, code);
+    m_entries.emplace(hash, Entry{{code.begin(), code.end()}, shaderModule});
+    return shaderModule;
+}
+
+size_t ShaderModuleCache::size() const {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return std::count_if(m_entries.begin(), m_entries.end(), [](auto& entry) { return !entry.second.shaderModule.expired(); });
+}
+
+} // namespace gfx
@@ -0,0 +1,72 @@
+#ifndef GFX_SHADERMODULE_HPP
+#define GFX_SHADERMODULE_HPP
+
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace gfx {
+
+class ShaderModule {
+public:
+    ShaderModule() : m_device(VK_NULL_HANDLE), m_shaderModule(VK_NULL_HANDLE) {}
+    ShaderModule(vk::Device device, std::span<const uint32_t> code);
+
+    ~ShaderModule();
+
+    ShaderModule(ShaderModule&& shaderModule);
+    ShaderModule(const ShaderModule&) = delete;
+
+    ShaderModule& operator=(ShaderModule&& shaderModule);
+
+    vk::ShaderModule get() const { return m_shaderModule; }
+
+private:
+    void destroy();
+
+private:
+    vk::Device m_device;
+    vk::ShaderModule m_shaderModule;
+};
+
+// hands out one shared module per distinct spirv, so pipelines using the same shader reference a single module
+// owned by Device and created from a vk::Device like the PipelineCache; the cache only holds weak references,
+// a module is destroyed with the last pipeline using it
+class ShaderModuleCache {
+public:
+    ShaderModuleCache(vk::Device device) : m_device(device), m_hits(0), m_misses(0) {}
+
+    ShaderModuleCache(const ShaderModuleCache&) = delete;
+    ShaderModuleCache& operator=(const ShaderModuleCache&) = delete;
+
+    // thread safe
+    std::shared_ptr<const ShaderModule> get(std::span<const uint32_t> code) const;
+
+    // modules that are still alive
+    size_t size() const;
+    uint64_t getHits() const { return m_hits; }
+    uint64_t getMisses() const { return m_misses; }
+
+private:
+    struct Entry {
+        // compared on lookup, a hash collision must not hand out the wrong module
+        std::vector<uint32_t> code;
+        std::weak_ptr<const ShaderModule> shaderModule;
+    };
+
+    vk::Device m_device;
+    mutable std::mutex m_mutex;
+    mutable std::unordered_multimap<uint64_t, Entry> m_entries;
+    mutable std::atomic<uint64_t> m_hits;
+    mutable std::atomic<uint64_t> m_misses;
+};
+
+} // namespace gfx
+
+#endif
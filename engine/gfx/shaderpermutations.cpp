@@ -0,0 +1,172 @@
+#include "shaderpermutations.hpp"
+
+#include "../core/log.hpp"
+#include "../core/file.hpp"
+#include "../core/hash.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+namespace gfx {
+
+ShaderPermutations::ShaderPermutations(const ShaderCompiler::CompileInfo& baseCompileInfo, const std::vector<std::string>& keywords) 
+  : m_baseCompileInfo(baseCompileInfo), m_keywords(keywords) {
+    if (m_keywords.size() > MAX_KEYWORDS) {
+        throw std::runtime_error("Too many keywords for shader " + baseCompileInfo.m_path.string());
+    }
+}
+
+ShaderPermutations::VariantMask ShaderPermutations::getMask(const std::vector<std::string>& enabledKeywords) const {
+    VariantMask mask = 0;
+    for (auto& enabledKeyword : enabledKeywords) {
+        auto keyword = std::find(m_keywords.begin(), m_keywords.end(), enabledKeyword);
+        if (keyword == m_keywords.end()) {
+            throw std::runtime_error("Shader " + m_baseCompileInfo.m_path.string() + " has no keyword " + enabledKeyword);
+        }
+        mask |= VariantMask{1} << (keyword - m_keywords.begin());
+    }
+    return mask;
+}
+
+std::vector<std::string> ShaderPermutations::getKeywords(VariantMask mask) const {
+    std::vector<std::string> keywords;
+    for (size_t i = 0; i < m_keywords.size(); i++) {
+        if (mask & (VariantMask{1} << i)) keywords.push_back(m_keywords[i]);
+    }
+    return keywords;
+}
+
+ShaderCompiler::CompileInfo ShaderPermutations::getCompileInfo(VariantMask mask) const {
+    ShaderCompiler::CompileInfo compileInfo = m_baseCompileInfo;
+    for (auto& keyword : getKeywords(mask)) {
+        compileInfo.addDefine(keyword, "1");
+    }
+    return compileInfo;
+}
+
+std::shared_future<ShaderCompiler::Result> ShaderPermutations::getVariant(VariantMask mask) {
+    assert((m_keywords.size() == MAX_KEYWORDS || mask >> m_keywords.size() == 0) && "Variant mask has bits past the declared keywords!");
+    std::lock_guard<std::mutex> lock{m_mutex};
+    auto variant = m_variants.find(mask);
+    if (variant != m_variants.end()) {
+        if (!isOutdated(variant->second)) return variant->second.future;
+        m_variants.erase(variant);
+    }
+    Variant& requested = m_variants[mask];
+    requested.sourceWriteTime = getWriteTime(m_baseCompileInfo.m_path);
+    requested.future = ShaderCompiler::compileAsync(getCompileInfo(mask));
+    return requested.future;
+}
+
+bool ShaderPermutations::isOutdated(Variant& variant) const {
+    // still compiling, whatever changed meanwhile is picked up once it is done
+    if (variant.future.wait_for(std::chrono::seconds{0}) != std::future_status::ready) return false;
+
+    const ShaderCompiler::Result *result;
+    try {
+        result = &variant.future.get();
+    } catch (...) {
+        // failed compilations are not kept, the source may have been fixed since
+        return true;
+    }
+
+    if (getWriteTime(m_baseCompileInfo.m_path) != variant.sourceWriteTime) return true;
+
+    if (!variant.dependenciesChecked) {
+        // the includes are only known now, their content is compared once against what was compiled, their write times after that
+        for (auto& dependency : result->m_dependencies) {
+            auto writeTime = getWriteTime(dependency.path);
+            auto source = core::tryReadFile(dependency.path);
+            if (!source || core::Hasher{}.add(std::string_view{*source}).get() != dependency.contentHash) return true;
+            variant.dependencyWriteTimes.emplace_back(dependency.path, writeTime);
+        }
+        variant.dependenciesChecked = true;
+        return false;
+    }
+    for (auto& [path, writeTime] : variant.dependencyWriteTimes) {
+        if (getWriteTime(path) != writeTime) return true;
+    }
+    return false;
+}
+
+std::filesystem::file_time_type ShaderPermutations::getWriteTime(const std::filesystem::path& path) {
+    std::error_code errorCode;
+    auto writeTime = std::filesystem::last_write_time(path, errorCode);
+    return errorCode ? std::filesystem::file_time_type::min() : writeTime;
+}
+
+std::shared_future<ShaderCompiler::Result> ShaderPermutations::getVariant(const std::vector<std::string>& enabledKeywords) {
+    return getVariant(getMask(enabledKeywords));
+}
+
+std::vector<ShaderPermutations::VariantMask> ShaderPermutations::getRequestedVariants() const {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    std::vector<VariantMask> variants;
+    variants.reserve(m_variants.size());
+    for (auto& [mask, variant] : m_variants) {
+        variants.push_back(mask);
+    }
+    return variants;
+}
+
+bool ShaderPermutations::saveManifest(const std::filesystem::path& path) const {
+    std::string manifest;
+    for (auto mask : getRequestedVariants()) {
+        auto keywords = getKeywords(mask);
+        for (size_t i = 0; i < keywords.size(); i++) {
+            if (i > 0) manifest += ' ';
+            manifest += keywords[i];
+        }
+        // an empty line is the variant without keywords
+        manifest += '\n';
+    }
+    if (!core::writeFileAtomic(path, manifest)) {
+        WARN("Failed to save shader variant manifest {}", path.string());
+        return false;
+    }
+    INFO("Saved {} shader variants of {} to {}", getRequestedVariants().size(), m_baseCompileInfo.m_path.filename().string(), path.string());
+    return true;
+}
+
+size_t ShaderPermutations::precompileManifest(const std::filesystem::path& path) {
+    auto manifest = core::tryReadFile(path);
+    if (!manifest) {
+        WARN("No shader variant manifest at {}", path.string());
+        return 0;
+    }
+
+    // everything is requested before waiting on anything so the variants compile in parallel
+    std::vector<std::shared_future<ShaderCompiler::Result>> variants;
+    std::istringstream lines{*manifest};
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::istringstream words{line};
+        std::vector<std::string> keywords;
+        std::string keyword;
+        bool known = true;
+        while (words >> keyword) {
+            if (std::find(m_keywords.begin(), m_keywords.end(), keyword) == m_keywords.end()) {
+                WARN("Skipping shader variant with unknown keyword {} in {}", keyword, path.string());
+                known = false;
+                break;
+            }
+            keywords.push_back(keyword);
+        }
+        if (known) variants.push_back(getVariant(keywords));
+    }
+
+    size_t compiled = 0;
+    for (auto& variant : variants) {
+        try {
+            variant.get();
+            compiled++;
+        } catch (const std::exception& e) {
+            ERROR("Failed to precompile shader variant: {}", e.what());
+        }
+    }
+    INFO("Precompiled {} shader variants of {}", compiled, m_baseCompileInfo.m_path.filename().string());
+    return compiled;
+}
+
+} // namespace gfx
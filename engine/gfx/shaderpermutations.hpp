@@ -0,0 +1,77 @@
+#ifndef GFX_SHADERPERMUTATIONS_HPP
+#define GFX_SHADERPERMUTATIONS_HPP
+
+#include "shader.hpp"
+
+#include <filesystem>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace gfx {
+
+// one shader source with a set of keywords (eg. SKINNED, ALPHA_TEST, NORMAL_MAP), every combination of enabled keywords
+// is a variant compiled with those keywords #defined; variants only compile when first requested, through the spirv cache
+// thread safe
+class ShaderPermutations {
+public:
+    // bit i is keyword i
+    using VariantMask = uint64_t;
+    static constexpr size_t MAX_KEYWORDS = 64;
+
+    // every variant starts from baseCompileInfo (path, stage, its own defines, ...)
+    ShaderPermutations(const ShaderCompiler::CompileInfo& baseCompileInfo, const std::vector<std::string>& keywords);
+
+    ShaderPermutations(const ShaderPermutations&) = delete;
+    ShaderPermutations& operator=(const ShaderPermutations&) = delete;
+
+    // throws on keywords that were not declared
+    VariantMask getMask(const std::vector<std::string>& enabledKeywords) const;
+    std::vector<std::string> getKeywords(VariantMask mask) const;
+    ShaderCompiler::CompileInfo getCompileInfo(VariantMask mask) const;
+
+    // starts compiling the variant on the ShaderCompiler worker pool the first time it is requested, later requests share it
+    // a variant that failed to compile, or whose source or includes changed since, is compiled again on the next request
+    std::shared_future<ShaderCompiler::Result> getVariant(VariantMask mask);
+    std::shared_future<ShaderCompiler::Result> getVariant(const std::vector<std::string>& enabledKeywords);
+
+    // the variants requested so far, in mask order
+    std::vector<VariantMask> getRequestedVariants() const;
+
+    // the manifest lists the enabled keywords of one requested variant per line, by name so it survives reordering keywords
+    // save it after a play session (or collect it in a build step) and precompile it at startup or offline
+    bool saveManifest(const std::filesystem::path& path) const;
+    // requests every variant in the manifest and waits for them, unknown keywords are skipped with a warning
+    // returns the number of variants compiled
+    size_t precompileManifest(const std::filesystem::path& path);
+
+    const ShaderCompiler::CompileInfo& getBaseCompileInfo() const { return m_baseCompileInfo; }
+    const std::vector<std::string>& getKeywordNames() const { return m_keywords; }
+
+private:
+    struct Variant {
+        std::shared_future<ShaderCompiler::Result> future;
+        // of the main source when the compilation was started
+        std::filesystem::file_time_type sourceWriteTime;
+        // of the includes, taken the first time the finished variant is looked up
+        std::vector<std::pair<std::filesystem::path, std::filesystem::file_time_type>> dependencyWriteTimes;
+        bool dependenciesChecked = false;
+    };
+
+    // m_mutex has to be held
+    bool isOutdated(Variant& variant) const;
+    static std::filesystem::file_time_type getWriteTime(const std::filesystem::path& path);
+
+private:
+    ShaderCompiler::CompileInfo m_baseCompileInfo;
+    std::vector<std::string> m_keywords;
+
+    mutable std::mutex m_mutex;
+    std::map<VariantMask, Variant> m_variants;
+};
+
+} // namespace gfx
+
+#endif
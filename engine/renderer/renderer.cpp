@@ -1,26 +1,29 @@
 #include "renderer.hpp"
 
+#include <algorithm>
+
 namespace renderer {
 
 // **********Renderer::Builder**********
+Renderer::Builder::Builder() : m_recordThreadCount(0) {}
+
+Renderer::Builder& Renderer::Builder::setRecordThreadCount(uint32_t recordThreadCount) {
+    m_recordThreadCount = recordThreadCount;
+    return *this;
+}
+
 Renderer Renderer::Builder::build(std::shared_ptr<gfx::Device> device, gfx::SwapChain& swapChain) {
     INFO("Created Renderer!");
-    return {device, swapChain};
+    return {device, swapChain, m_recordThreadCount};
 }
 
 // **********Renderer**********
-Renderer::Renderer(std::shared_ptr<gfx::Device> device, gfx::SwapChain& swapChain) : m_device(device), m_swapChain(swapChain) {
-    m_commandPool = gfx::CommandPool::Builder{}
-        .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
-        .setQueueFamilyIndex(device->getQueueFamilyIndices().graphicsFamily.value())
-        .build(m_device);
-
-    m_commandBuffers = m_commandPool.createCommandBuffer(m_swapChain.MAX_FRAMES_IN_FLIGHT);
-
+Renderer::Renderer(std::shared_ptr<gfx::Device> device, gfx::SwapChain& swapChain, uint32_t recordThreadCount) : m_device(device), m_swapChain(swapChain) {
     createRenderPass();
     createSyncObjects();
     createSwapChainImageViews();
     createSwapChainFrameBuffers();
+    createFrameContexts(recordThreadCount);
 }
 
 Renderer::~Renderer() {
@@ -31,6 +34,12 @@ std::optional<Renderer::CommandBufferImageIndex> Renderer::begin() {
     assert(!didStartFrame && "cannot begin again while frame has already begin!");
     
     m_inFlightFence[m_currentFrame].wait();
+    // everything the frame recorded last time is done executing, recycle it a pool at a time
+    auto& frameContext = m_frameContexts[m_currentFrame];
+    frameContext.commandPool.reset();
+    for (auto& recordCommandPool : frameContext.recordCommandPools) {
+        recordCommandPool.reset();
+    }
     auto res = m_swapChain.acquireNextImage(m_imageAvailableSemaphore[m_currentFrame]);
     if (!res) {
         m_swapChain.recreateSwapChain();
@@ -41,20 +50,18 @@ std::optional<Renderer::CommandBufferImageIndex> Renderer::begin() {
         m_inFlightFence[m_currentFrame].reset();
     }
     m_imageIndex = res.value();
-    auto& commandBuffer = m_commandBuffers[m_currentFrame];
-    commandBuffer.reset();
-    commandBuffer.begin();
+    m_commandBuffer = frameContext.commandPool.acquire();
+    m_commandBuffer.begin(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
     didStartFrame = true;
-    return {{commandBuffer, m_imageIndex}};
+    return {{m_commandBuffer, m_imageIndex}};
 }
 
 void Renderer::end() {
     assert(didStartFrame && "cannot end frame when frame hasnt started!");
     
-    auto& commandBuffer = m_commandBuffers[m_currentFrame];
-    commandBuffer.end();
+    m_commandBuffer.end();
     m_device->submit(gfx::Device::QueueSubmitInfo{}
-            .addCommandBuffer(commandBuffer)
+            .addCommandBuffer(m_commandBuffer)
             .addWaitSemaphore(m_imageAvailableSemaphore[m_currentFrame])
             .addSignalSemaphore(m_renderFinishedSemaphore[m_currentFrame])
             .setFence(m_inFlightFence[m_currentFrame])
@@ -78,17 +85,23 @@ void Renderer::end() {
     didStartFrame = false;
 }
 
-void Renderer::beginSwapChainRenderPass() {
+void Renderer::beginSwapChainRenderPass(vk::SubpassContents subpassContents) {
     assert(!didStartRenderPass && "cannot begin again while render pass has already begin!");
 
-    auto& commandBuffer = m_commandBuffers[m_currentFrame];
-    m_renderPass.begin(commandBuffer, gfx::RenderPass::BeginInfo{}
+    m_renderPass.begin(m_commandBuffer, gfx::RenderPass::BeginInfo{}
             .setFrameBuffer(m_swapChainFrameBuffers[m_imageIndex])
             .setRenderArea(vk::Rect2D{}
                 .setOffset({0, 0})
                 .setExtent(m_swapChain.getExtent()))            
             .addClearValue(vk::ClearValue{}
-                .setColor(vk::ClearColorValue{std::array{0.f, 0.f, 0.f, 1.f}})));
+                .setColor(vk::ClearColorValue{std::array{0.f, 0.f, 0.f, 1.f}}))
+            .setSubpassContents(subpassContents));
+
+    // only vkCmdExecuteCommands is allowed in the primary then, the secondaries set their own
+    if (subpassContents == vk::SubpassContents::eInline) {
+        setSwapChainViewport(m_commandBuffer);
+    }
+    m_subpassContents = subpassContents;
     
     didStartRenderPass = true;
 }
@@ -96,11 +109,66 @@ void Renderer::beginSwapChainRenderPass() {
 void Renderer::endSwapChainRenderPass() {
     assert(didStartRenderPass && "cannot end render pass when render pass hasnt started!");
 
-    auto& commandBuffer = m_commandBuffers[m_currentFrame];
-    m_renderPass.end(commandBuffer);
+    m_renderPass.end(m_commandBuffer);
     didStartRenderPass = false;
 }
 
+void Renderer::recordParallel(uint32_t count, const RecordFunction& record) {
+    assert(didStartRenderPass && m_subpassContents == vk::SubpassContents::eSecondaryCommandBuffers && "recordParallel needs a render pass begun with secondary command buffer contents!");
+    if (count == 0) return;
+
+    auto& recordCommandPools = m_frameContexts[m_currentFrame].recordCommandPools;
+    uint32_t rangeCount = std::min(static_cast<uint32_t>(recordCommandPools.size()), count);
+
+    vk::CommandBufferInheritanceInfo commandBufferInheritanceInfo = vk::CommandBufferInheritanceInfo{}
+        .setRenderPass(m_renderPass.get())
+        .setSubpass(0)
+        .setFramebuffer(m_swapChainFrameBuffers[m_imageIndex].get());
+
+    std::vector<gfx::CommandBuffer> secondaryCommandBuffers;
+    secondaryCommandBuffers.reserve(rangeCount);
+    std::vector<std::future<void>> futures;
+    futures.reserve(rangeCount);
+
+    for (uint32_t i = 0; i < rangeCount; i++) {
+        // range i always goes to pool i, so no two jobs share a pool whichever worker picks them up
+        gfx::CommandBuffer commandBuffer = recordCommandPools[i].acquire();
+        secondaryCommandBuffers.push_back(commandBuffer);
+
+        uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(count) * i / rangeCount);
+        uint32_t last = static_cast<uint32_t>(static_cast<uint64_t>(count) * (i + 1) / rangeCount);
+        futures.push_back(m_recordThreadPool->submit([this, &record, commandBuffer, commandBufferInheritanceInfo, first, last]() mutable {
+            commandBuffer.begin(vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eOneTimeSubmit, commandBufferInheritanceInfo);
+            setSwapChainViewport(commandBuffer);
+            record(commandBuffer, first, last);
+            commandBuffer.end();
+        }));
+    }
+
+    // every job has to be done with record before an exception leaves this frame
+    for (auto& future : futures) {
+        future.wait();
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+
+    m_commandBuffer.executeCommands(secondaryCommandBuffers);
+}
+
+void Renderer::setSwapChainViewport(const gfx::CommandBuffer& commandBuffer) const {
+    // pipelines have dynamic viewport and scissor by default, so they follow the swap chain through resizes
+    auto extent = m_swapChain.getExtent();
+    commandBuffer.setViewport(vk::Viewport{}
+        .setWidth(static_cast<float>(extent.width))
+        .setHeight(static_cast<float>(extent.height))
+        .setMinDepth(0.0f)
+        .setMaxDepth(1.0f));
+    commandBuffer.setScissor(vk::Rect2D{}
+        .setOffset({0, 0})
+        .setExtent(extent));
+}
+
 void Renderer::createRenderPass() {
     m_renderPass = gfx::RenderPass::Builder{}
             .addAttachmentDescription(vk::AttachmentDescription{}
@@ -167,5 +235,19 @@ void Renderer::createSwapChainFrameBuffers() {
     }
 }
 
+void Renderer::createFrameContexts(uint32_t recordThreadCount) {
+    m_recordThreadPool = std::make_unique<core::ThreadPool>(recordThreadCount);
+
+    uint32_t queueFamilyIndex = m_device->getQueueFamilyIndices().graphicsFamily.value();
+    m_frameContexts.reserve(m_swapChain.MAX_FRAMES_IN_FLIGHT);
+    for (uint32_t i = 0; i < m_swapChain.MAX_FRAMES_IN_FLIGHT; i++) {
+        FrameContext frameContext{gfx::LinearCommandPool{m_device, queueFamilyIndex}};
+        frameContext.recordCommandPools.reserve(m_recordThreadPool->getThreadCount());
+        for (uint32_t j = 0; j < m_recordThreadPool->getThreadCount(); j++) {
+            frameContext.recordCommandPools.emplace_back(m_device, queueFamilyIndex, vk::CommandBufferLevel::eSecondary);
+        }
+        m_frameContexts.push_back(std::move(frameContext));
+    }
+}
 
 } // namespace renderer
@@ -5,15 +5,29 @@
 #include "../gfx/swapchain.hpp"
 #include "../gfx/commandbuffer.hpp"
 #include "../gfx/renderpass.hpp"
+#include "../core/threadpool.hpp"
+
+#include <functional>
+#include <memory>
 
 namespace renderer {
 
 class Renderer {
 public:
     struct Builder {
+        Builder();
+
+        // workers recording the secondary command buffers of recordParallel, 0 picks one per core
+        Builder& setRecordThreadCount(uint32_t recordThreadCount);
         Renderer build(std::shared_ptr<gfx::Device> device, gfx::SwapChain& swapChain);
+
+        uint32_t m_recordThreadCount;
     };
 
+    // gets a secondary command buffer inside the swap chain render pass with viewport and scissor set, and the range [first, last) to record
+    // runs concurrently with the other ranges, so it may only touch what is not shared between them
+    using RecordFunction = std::function<void(const gfx::CommandBuffer& commandBuffer, uint32_t first, uint32_t last)>;
+
     Renderer(const Renderer&) = delete;
 
     ~Renderer();
@@ -25,20 +39,36 @@ public:
 
     std::optional<CommandBufferImageIndex> begin();
     void end();
-    void beginSwapChainRenderPass();
+    // with eSecondaryCommandBuffers everything in the render pass has to go through recordParallel
+    void beginSwapChainRenderPass(vk::SubpassContents subpassContents = vk::SubpassContents::eInline);
     void endSwapChainRenderPass();
 
+    // splits [0, count) into one contiguous range per record thread, records them into secondary command buffers on the workers
+    // and executes those in order from the frame's command buffer, blocks until all are recorded
+    // can be called several times per frame, nothing bound on the primary carries over so each range binds its own pipeline
+    void recordParallel(uint32_t count, const RecordFunction& record);
+
     const gfx::RenderPass& getRenderPass() const { return m_renderPass; }
 
     uint32_t getCurrentFrameIndex() { return m_currentFrame; }
 
 private:
-    Renderer(std::shared_ptr<gfx::Device> device, gfx::SwapChain& swapChain);
+    // everything recorded for one frame in flight, reset wholesale once the frame's fence is signaled again
+    struct FrameContext {
+        gfx::LinearCommandPool commandPool;
+        // one per record thread, only the worker recording that thread's range touches it
+        std::vector<gfx::LinearCommandPool> recordCommandPools;
+    };
+
+    Renderer(std::shared_ptr<gfx::Device> device, gfx::SwapChain& swapChain, uint32_t recordThreadCount);
 
     void createRenderPass();
     void createSyncObjects();
     void createSwapChainImageViews();
     void createSwapChainFrameBuffers();
+    void createFrameContexts(uint32_t recordThreadCount);
+
+    void setSwapChainViewport(const gfx::CommandBuffer& commandBuffer) const;
 
     void advanceCurrentFrame() { m_currentFrame = (m_currentFrame + 1) % m_swapChain.MAX_FRAMES_IN_FLIGHT; }
 
@@ -51,12 +81,15 @@ private:
     gfx::SwapChain&                  m_swapChain;
     std::vector<gfx::ImageView>      m_swapChainImageViews;
     std::vector<gfx::FrameBuffer>    m_swapChainFrameBuffers;
-    gfx::CommandPool                 m_commandPool;
     gfx::RenderPass                  m_renderPass;
-    std::vector<gfx::CommandBuffer>  m_commandBuffers;
+    std::vector<FrameContext>        m_frameContexts;
+    // acquired from the current frame context in begin
+    gfx::CommandBuffer               m_commandBuffer;
     std::vector<gfx::Semaphore>      m_imageAvailableSemaphore;
     std::vector<gfx::Semaphore>      m_renderFinishedSemaphore;
     std::vector<gfx::Fence>          m_inFlightFence;
+    vk::SubpassContents              m_subpassContents{vk::SubpassContents::eInline};
+    std::unique_ptr<core::ThreadPool> m_recordThreadPool;
 
 };
 
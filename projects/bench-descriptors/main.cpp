@@ -0,0 +1,153 @@
+#include "core/window.hpp"
+#include "core/log.hpp"
+#include "gfx/device.hpp"
+#include "gfx/buffer.hpp"
+#include "gfx/descriptors.hpp"
+
+#include <array>
+#include <chrono>
+#include <memory>
+
+// compares the cpu cost of writing descriptors for many objects through the different update paths
+int main() {
+    if (!core::Log::init()) {
+        throw std::runtime_error("Failed to initialize logger!");
+    }
+
+    const uint32_t setCount = 4096;
+    const uint32_t iterations = 100;
+    const vk::DeviceSize objectSize = 256;
+
+    core::Window window{640, 420, "Bench Descriptors"};
+
+    auto benchmark = [&](std::shared_ptr<gfx::Device> device) {
+        gfx::Buffer uniformBuffer = gfx::Buffer::Builder{}
+            .setMemoryProperty(vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible)
+            .setSharingMode(vk::SharingMode::eExclusive)
+            .setSize(objectSize * setCount * 2)
+            .setUsage(vk::BufferUsageFlagBits::eUniformBuffer)
+            .build(device);
+
+        gfx::DescriptorSetLayout descriptorSetLayout = gfx::DescriptorSetLayout::Builder{}
+            .addBinding(0, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eVertex, 1)
+            .addBinding(1, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eFragment, 1)
+            .build(device);
+
+        gfx::DescriptorPool descriptorPool = gfx::DescriptorPool::Builder{}
+            .addPoolSize(vk::DescriptorType::eUniformBuffer, setCount * 2)
+            .setMaxSets(setCount)
+            .build(device);
+
+        gfx::DescriptorPool::SetAllocateInfo setAllocateInfo{};
+        for (uint32_t i = 0; i < setCount; i++) {
+            setAllocateInfo.addLayout(descriptorSetLayout);
+        }
+        auto descriptorSets = descriptorPool.allocate(setAllocateInfo);
+
+        struct ObjectDescriptors {
+            vk::DescriptorBufferInfo transform;
+            vk::DescriptorBufferInfo material;
+        };
+
+        std::vector<ObjectDescriptors> objectDescriptors(setCount);
+        for (uint32_t i = 0; i < setCount; i++) {
+            objectDescriptors[i].transform = vk::DescriptorBufferInfo{}
+                .setBuffer(uniformBuffer.get())
+                .setOffset(objectSize * (i * 2))
+                .setRange(objectSize);
+            objectDescriptors[i].material = vk::DescriptorBufferInfo{}
+                .setBuffer(uniformBuffer.get())
+                .setOffset(objectSize * (i * 2 + 1))
+                .setRange(objectSize);
+        }
+
+        gfx::DescriptorUpdateTemplate descriptorUpdateTemplate = gfx::DescriptorUpdateTemplate::Builder{}
+            .setDescriptorSetLayout(descriptorSetLayout)
+            .addEntry(0, offsetof(ObjectDescriptors, transform))
+            .addEntry(1, offsetof(ObjectDescriptors, material))
+            .build(device);
+
+        auto measure = [&](const char *name, auto&& updateAll) {
+            updateAll();  // warm up
+            auto start = std::chrono::high_resolution_clock::now();
+            for (uint32_t i = 0; i < iterations; i++) {
+                updateAll();
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            double totalMs = std::chrono::duration<double, std::milli>(end - start).count();
+            INFO("{:<28} {:>10.3f} ms/frame {:>10.1f} ns/set", name, totalMs / iterations, totalMs * 1e6 / (double(iterations) * setCount));
+        };
+
+        INFO("Updating {} descriptor sets, {} iterations", setCount, iterations);
+
+        measure("DescriptorSet::update", [&]() {
+            for (uint32_t i = 0; i < setCount; i++) {
+                descriptorSets[i].update(gfx::DescriptorSet::Update{}
+                    .addBuffer(0, objectDescriptors[i].transform)
+                    .addBuffer(1, objectDescriptors[i].material));
+            }
+        });
+
+        measure("DescriptorSet::Batch", [&]() {
+            gfx::DescriptorSet::Batch batch{device};
+            for (uint32_t i = 0; i < setCount; i++) {
+                batch.add(descriptorSets[i], gfx::DescriptorSet::Update{}
+                    .addBuffer(0, objectDescriptors[i].transform)
+                    .addBuffer(1, objectDescriptors[i].material));
+            }
+        });
+
+        measure("DescriptorUpdateTemplate", [&]() {
+            for (uint32_t i = 0; i < setCount; i++) {
+                descriptorUpdateTemplate.update(descriptorSets[i], objectDescriptors[i]);
+            }
+        });
+
+        // an invalid write has to reject its whole update, none of the valid writes before it may be applied or stay queued
+        std::array<gfx::DescriptorSet::Update, 2> invalidUpdates{
+            gfx::DescriptorSet::Update{}
+                .addBuffer(0, objectDescriptors[0].transform)
+                .addBuffer(2, objectDescriptors[0].material),     // binding not in the layout
+            gfx::DescriptorSet::Update{}
+                .addBuffer(0, objectDescriptors[0].transform)
+                .addBuffer(1, objectDescriptors[0].material, 1),  // array element out of range
+        };
+        for (auto& invalidUpdate : invalidUpdates) {
+            bool updateRejected = false;
+            try {
+                descriptorSets[0].update(invalidUpdate);
+            } catch (const std::runtime_error& error) {
+                INFO("Rejected update: {}", error.what());
+                updateRejected = true;
+            }
+            gfx::DescriptorSet::Batch batch{device};
+            bool batchRejected = false;
+            try {
+                batch.add(descriptorSets[0], invalidUpdate);
+            } catch (const std::runtime_error&) {
+                batchRejected = true;
+            }
+            if (!updateRejected || !batchRejected || batch.m_writeCount != 0) {
+                throw std::runtime_error("Invalid descriptor update was not rejected as a whole!");
+            }
+        }
+
+        device->get().waitIdle();
+    };
+
+    {
+        INFO("Descriptor pool backend");
+        benchmark(std::make_shared<gfx::Device>(window, false));
+    }
+    {
+        auto device = std::make_shared<gfx::Device>(window, false, gfx::Device::Config{}.setPreferDescriptorBuffer(true));
+        if (device->getDescriptorBackend() == gfx::Device::DescriptorBackend::eDescriptorBuffer) {
+            INFO("Descriptor buffer backend");
+            benchmark(device);
+        } else {
+            INFO("VK_EXT_descriptor_buffer not supported, skipping descriptor buffer backend");
+        }
+    }
+
+    return 0;
+}
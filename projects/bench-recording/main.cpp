@@ -0,0 +1,116 @@
+#include "core/window.hpp"
+#include "core/log.hpp"
+#include "gfx/device.hpp"
+#include "gfx/swapchain.hpp"
+#include "gfx/pipeline.hpp"
+#include "gfx/commandbuffer.hpp"
+
+#include "renderer/renderer.hpp"
+
+#include "bench-recording_shaders.hpp"
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+// compares recording every draw into the frame's command buffer with fanning them out over secondary command buffers
+int main() {
+    if (!core::Log::init()) {
+        throw std::runtime_error("Failed to initialize logger!");
+    }
+
+    const uint32_t objectCount = 100000;
+    const uint32_t frameCount = 64;
+
+    core::Window window{640, 420, "Bench Recording"};
+
+    std::shared_ptr<gfx::Device> device = std::make_shared<gfx::Device>(window, false);
+    gfx::SwapChain swapChain{device, 3};
+
+    auto buildPipeline = [&](const renderer::Renderer& renderer) {
+        return gfx::GraphicsPipeline::Builder{}
+            .addShaderFromSpirv(shaders::test_vert, vk::ShaderStageFlagBits::eVertex)
+            .addShaderFromSpirv(shaders::test_frag, vk::ShaderStageFlagBits::eFragment)
+            .setInputAssemblyTopology(vk::PrimitiveTopology::eTriangleList)
+            .setInputAssemblyPrimitiveRestartEnable(false)
+            .setRasterizerDepthClampEnable(false)
+            .setRasterizerDiscardEnable(false)
+            .setRasterizerPolygonMode(vk::PolygonMode::eFill)
+            .setRasterizerLineWidth(1)
+            .setRasterizerCullMode(vk::CullModeFlagBits::eNone)
+            .setRasterizerDepthBiasEnable(false)
+            .setMultisamplingSampleShadingEnable(false)
+            .setMultisamplinRasterizationSamples(vk::SampleCountFlagBits::e1)
+            .addColorBlendAttachmentState(vk::PipelineColorBlendAttachmentState{}
+                .setColorWriteMask(vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA)
+                .setBlendEnable(vk::Bool32{ false }))
+            .setColorBlendStateLogicOpEnable(false)
+            .setRenderPass(renderer.getRenderPass())
+            .build(device);
+    };
+
+    // one draw per object, firstInstance stands in for the per object data a real scene would bind
+    auto recordRange = [](const gfx::GraphicsPipeline& pipeline, const gfx::CommandBuffer& commandBuffer, uint32_t first, uint32_t last) {
+        pipeline.bind(commandBuffer);
+        for (uint32_t i = first; i < last; i++) {
+            commandBuffer.get().draw(3, 1, 0, i);
+        }
+    };
+
+    // average cpu time of the recording alone, acquire and present are left out
+    auto measure = [&](renderer::Renderer& renderer, vk::SubpassContents subpassContents, auto&& record) {
+        double totalMs = 0;
+        uint32_t frames = 0;
+        while (frames < frameCount && !window.shouldClose()) {
+            core::Window::pollEvents();
+
+            if (auto res = renderer.begin()) {
+                auto [commandBuffer, imageIndex] = res.value();
+
+                renderer.beginSwapChainRenderPass(subpassContents);
+
+                auto start = std::chrono::high_resolution_clock::now();
+                record(commandBuffer);
+                auto end = std::chrono::high_resolution_clock::now();
+                totalMs += std::chrono::duration<double, std::milli>(end - start).count();
+                frames++;
+
+                renderer.endSwapChainRenderPass();
+
+                renderer.end();
+            }
+        }
+        device->get().waitIdle();
+        return frames ? totalMs / frames : 0.0;
+    };
+
+    INFO("Recording {} draws", objectCount);
+
+    {
+        renderer::Renderer renderer = renderer::Renderer::Builder{}.setRecordThreadCount(1).build(device, swapChain);
+        gfx::GraphicsPipeline pipeline = buildPipeline(renderer);
+
+        double ms = measure(renderer, vk::SubpassContents::eInline, [&](const gfx::CommandBuffer& commandBuffer) {
+            recordRange(pipeline, commandBuffer, 0, objectCount);
+        });
+        INFO("{:<10} {:>10.3f} ms/frame", "inline", ms);
+    }
+
+    std::vector<uint32_t> threadCounts{1, 2, 4, 8};
+    if (std::thread::hardware_concurrency() > 8) {
+        threadCounts.push_back(std::thread::hardware_concurrency());
+    }
+    for (uint32_t threadCount : threadCounts) {
+        renderer::Renderer renderer = renderer::Renderer::Builder{}.setRecordThreadCount(threadCount).build(device, swapChain);
+        gfx::GraphicsPipeline pipeline = buildPipeline(renderer);
+
+        double ms = measure(renderer, vk::SubpassContents::eSecondaryCommandBuffers, [&](const gfx::CommandBuffer&) {
+            renderer.recordParallel(objectCount, [&](const gfx::CommandBuffer& commandBuffer, uint32_t first, uint32_t last) {
+                recordRange(pipeline, commandBuffer, first, last);
+            });
+        });
+        INFO("{:<10} {:>10.3f} ms/frame ({} threads)", "secondary", ms, threadCount);
+    }
+
+    return 0;
+}
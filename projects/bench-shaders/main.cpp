@@ -0,0 +1,256 @@
+#include "core/window.hpp"
+#include "core/log.hpp"
+#include "gfx/device.hpp"
+#include "gfx/swapchain.hpp"
+#include "gfx/pipeline.hpp"
+#include "gfx/shader.hpp"
+#include "gfx/pipelinebatch.hpp"
+#include "gfx/pipelinestatecache.hpp"
+#include "gfx/pipelinelibrary.hpp"
+#include "gfx/asyncpipeline.hpp"
+#include "gfx/shaderpermutations.hpp"
+
+#include "renderer/renderer.hpp"
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+// compares startup pipeline builds with an empty (cold) and a populated (warm) spirv cache
+int main() {
+    if (!core::Log::init()) {
+        throw std::runtime_error("Failed to initialize logger!");
+    }
+
+    // every variant gets its own define so each one is a distinct cache entry, like real permutations would be
+    const uint32_t variantCount = 32;
+    const std::filesystem::path cacheDirectory = "bench-shadercache";
+
+    core::Window window{640, 420, "Bench Shaders"};
+
+    // no pipeline cache blob from earlier runs, so the cold build is cold for the driver as well
+    std::shared_ptr<gfx::Device> device = std::make_shared<gfx::Device>(window, false, gfx::Device::Config{}.setPipelineCachePath(""));
+    gfx::SwapChain swapChain{device, 3};
+    renderer::Renderer renderer = renderer::Renderer::Builder{}.build(device, swapChain);
+
+    gfx::ShaderCompiler::setCacheDirectory(cacheDirectory);
+
+    std::vector<gfx::ShaderCompiler::CompileInfo> compileInfos;
+    for (uint32_t i = 0; i < variantCount; i++) {
+        compileInfos.push_back(gfx::ShaderCompiler::CompileInfo{}
+            .setPath("../../../assets/shader/test.vert")
+            .addDefine("VARIANT", std::to_string(i)));
+        compileInfos.push_back(gfx::ShaderCompiler::CompileInfo{}
+            .setPath("../../../assets/shader/test.frag")
+            .addDefine("VARIANT", std::to_string(i)));
+    }
+
+    auto measure = [](auto&& function) {
+        auto start = std::chrono::high_resolution_clock::now();
+        function();
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    };
+
+    // shaderc only, no cache
+    gfx::ShaderCompiler::setCacheEnabled(false);
+    double serialMs = measure([&]() {
+        for (auto& compileInfo : compileInfos) {
+            gfx::ShaderCompiler::compile(compileInfo);
+        }
+    });
+    double parallelMs = measure([&]() {
+        gfx::ShaderCompiler::compileAll(compileInfos);
+    });
+
+    // spirv size and compile time for every optimization setting
+    struct OptimizationSetting {
+        const char *name;
+        gfx::ShaderCompiler::OptimizationLevel optimizationLevel;
+        std::vector<std::string> optimizerPasses;
+    };
+    const std::vector<OptimizationSetting> optimizationSettings = {
+        {"zero", gfx::ShaderCompiler::OptimizationLevel::eZero, {}},
+        {"size", gfx::ShaderCompiler::OptimizationLevel::eSize, {}},
+        {"perf", gfx::ShaderCompiler::OptimizationLevel::ePerformance, {}},
+        {"custom", gfx::ShaderCompiler::OptimizationLevel::eZero, {"--eliminate-dead-code-aggressive", "--strip-debug"}},
+    };
+    std::vector<std::pair<double, size_t>> optimizationResults;
+    for (auto& optimizationSetting : optimizationSettings) {
+        auto settingCompileInfos = compileInfos;
+        for (auto& compileInfo : settingCompileInfos) {
+            compileInfo.setOptimizationLevel(optimizationSetting.optimizationLevel);
+            for (auto& optimizerPass : optimizationSetting.optimizerPasses) {
+                compileInfo.addOptimizerPass(optimizerPass);
+            }
+        }
+        size_t codeSize = 0;
+        double ms = measure([&]() {
+            for (auto& result : gfx::ShaderCompiler::compileAll(settingCompileInfos)) {
+                codeSize += result.m_code.size() * sizeof(uint32_t);
+            }
+        });
+        optimizationResults.emplace_back(ms, codeSize);
+    }
+    gfx::ShaderCompiler::setCacheEnabled(true);
+
+    auto createBuilders = [&]() {
+        std::vector<gfx::GraphicsPipeline::Builder> builders;
+        for (uint32_t i = 0; i < variantCount; i++) {
+            builders.push_back(gfx::GraphicsPipeline::Builder{}
+                .addShader(compileInfos[i * 2])
+                .addShader(compileInfos[i * 2 + 1])
+                .setInputAssemblyTopology(vk::PrimitiveTopology::eTriangleList)
+                .setInputAssemblyPrimitiveRestartEnable(false)
+                .addViewport(vk::Viewport{}
+                    .setWidth(swapChain.getExtent().width)
+                    .setHeight(swapChain.getExtent().height)
+                    .setMaxDepth(1.0f))
+                .addScissor(vk::Rect2D{}
+                    .setExtent(swapChain.getExtent()))
+                .setRasterizerPolygonMode(vk::PolygonMode::eFill)
+                .setRasterizerLineWidth(1)
+                .setRasterizerCullMode(vk::CullModeFlagBits::eNone)
+                .setMultisamplinRasterizationSamples(vk::SampleCountFlagBits::e1)
+                .addColorBlendAttachmentState(vk::PipelineColorBlendAttachmentState{}
+                    .setColorWriteMask(vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA)
+                    .setBlendEnable(vk::Bool32{ false }))
+                .setColorBlendStateLogicOpEnable(false)
+                .setRenderPass(renderer.getRenderPass()));
+        }
+        return builders;
+    };
+
+    // the spirv cache only shortens the shader part, pipeline creation is timed on its own since the
+    // in-memory VkPipelineCache is warm after the first build whatever the spirv cache does
+    struct BuildTimes {
+        double shadersMs = 0.0;
+        double pipelinesMs = 0.0;  // layouts, shader modules and pipeline creation
+        double createMs = 0.0;     // pipeline creation alone, summed over the pipelines as the batch reports them
+    };
+    auto buildPipelines = [&](gfx::PipelineBatch::Mode mode) {
+        auto builders = createBuilders();
+        BuildTimes buildTimes;
+        buildTimes.shadersMs = measure([&]() {
+            // every stage of every pipeline goes to the shader worker pool before waiting on any of them
+            for (auto& builder : builders) {
+                builder.compileShadersAsync();
+            }
+            for (auto& builder : builders) {
+                for (auto& compiledShader : builder.m_compiledShaders) {
+                    compiledShader.wait();
+                }
+            }
+        });
+        buildTimes.pipelinesMs = measure([&]() {
+            // the copies in the batch take the finished compilations along
+            gfx::PipelineBatch pipelineBatch{};
+            pipelineBatch.setMode(mode);
+            for (auto& builder : builders) {
+                pipelineBatch.add(builder);
+            }
+            for (auto& result : pipelineBatch.build(device)) {
+                buildTimes.createMs += result.milliseconds;
+            }
+        });
+        return buildTimes;
+    };
+
+    std::filesystem::remove_all(cacheDirectory);
+    BuildTimes cold = buildPipelines(gfx::PipelineBatch::Mode::eSingleCall);
+    BuildTimes warm = buildPipelines(gfx::PipelineBatch::Mode::eSingleCall);
+    BuildTimes warmThreaded = buildPipelines(gfx::PipelineBatch::Mode::eThreaded);
+
+    // every variant requested by several systems, only the first request builds
+    const uint32_t requestsPerVariant = 4;
+    gfx::PipelineStateCache pipelineStateCache{device};
+    std::vector<std::shared_ptr<gfx::GraphicsPipeline>> requestedPipelines;
+    double pipelineStateCacheMs = measure([&]() {
+        auto builders = createBuilders();
+        for (uint32_t i = 0; i < requestsPerVariant; i++) {
+            for (auto& builder : builders) {
+                requestedPipelines.push_back(pipelineStateCache.get(builder));
+            }
+        }
+    });
+    auto pipelineStateCacheStatistics = pipelineStateCache.getStatistics();
+
+    // pipelines assembled from shared library parts, the optimized versions link in the background
+    gfx::PipelineLibrary pipelineLibrary{device};
+    std::vector<gfx::PipelineLibrary::Result> linkedPipelines;
+    double pipelineLibraryMs = measure([&]() {
+        auto builders = createBuilders();
+        for (auto& builder : builders) {
+            linkedPipelines.push_back(pipelineLibrary.link(builder));
+        }
+    });
+    double pipelineLibraryOptimizedMs = measure([&]() {
+        for (auto& linkedPipeline : linkedPipelines) {
+            if (linkedPipeline.optimized.valid()) linkedPipeline.pipeline = linkedPipeline.optimized.get();
+        }
+    });
+    auto pipelineLibraryStatistics = pipelineLibrary.getStatistics();
+
+    // what a frame pays for requesting pipelines it does not have yet, and how long until they can be drawn with
+    gfx::AsyncPipelineCompiler asyncPipelineCompiler{device};
+    std::vector<gfx::AsyncGraphicsPipeline> asyncPipelines;
+    auto asyncBuilders = createBuilders();
+    double asyncRequestMs = measure([&]() {
+        for (auto& builder : asyncBuilders) {
+            asyncPipelines.push_back(asyncPipelineCompiler.build(builder));
+        }
+    });
+    double asyncReadyMs = measure([&]() {
+        while (asyncPipelineCompiler.getPendingCount() > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    // a material shader with many keywords, only the variants that are requested compile
+    gfx::ShaderPermutations shaderPermutations{gfx::ShaderCompiler::CompileInfo{}.setPath("../../../assets/shader/test.frag"),
+        {"SKINNED", "ALPHA_TEST", "NORMAL_MAP", "EMISSIVE", "FOG", "SHADOWS"}};
+    double permutationsMs = measure([&]() {
+        shaderPermutations.getVariant({}).get();
+        shaderPermutations.getVariant({"SKINNED"}).get();
+        shaderPermutations.getVariant({"ALPHA_TEST", "NORMAL_MAP"}).get();
+        shaderPermutations.getVariant({"SKINNED", "NORMAL_MAP", "SHADOWS"}).get();
+    });
+    shaderPermutations.saveManifest(cacheDirectory / "test.frag.variants");
+
+    INFO("Compiling {} shaders", compileInfos.size());
+    INFO("{:<8} {:>10.3f} ms total", "serial", serialMs);
+    INFO("{:<8} {:>10.3f} ms total ({} threads)", "parallel", parallelMs, gfx::ShaderCompiler::getThreadPool().getThreadCount());
+    INFO("Optimization settings");
+    for (size_t i = 0; i < optimizationSettings.size(); i++) {
+        auto [ms, codeSize] = optimizationResults[i];
+        INFO("{:<8} {:>10.3f} ms total {:>10} bytes spirv", optimizationSettings[i].name, ms, codeSize);
+    }
+    INFO("Building {} pipelines (pipeline creation is warm in the driver cache after the cold build)", variantCount);
+    auto logBuildTimes = [&](const char *name, const BuildTimes& buildTimes, const char *note) {
+        INFO("{:<8} {:>10.3f} ms shaders {:>10.3f} ms pipelines, {:.3f} ms of it creation {:>10.3f} ms/pipeline{}", name, 
+            buildTimes.shadersMs, buildTimes.pipelinesMs, buildTimes.createMs, (buildTimes.shadersMs + buildTimes.pipelinesMs) / variantCount, note);
+    };
+    logBuildTimes("cold", cold, "");
+    logBuildTimes("warm", warm, "");
+    logBuildTimes("warm", warmThreaded, " (threaded batch)");
+    INFO("Shader permutations");
+    INFO("{:<8} {:>10.3f} ms total, {} of {} variants compiled", "lazy", permutationsMs, 
+        shaderPermutations.getRequestedVariants().size(), uint64_t{1} << shaderPermutations.getKeywordNames().size());
+    INFO("Requesting {} pipelines through the pipeline state cache", variantCount * requestsPerVariant);
+    INFO("{:<8} {:>10.3f} ms total, {} hits, {} misses, {:.3f} ms building, {} pipelines", "pso", pipelineStateCacheMs, 
+        pipelineStateCacheStatistics.hits, pipelineStateCacheStatistics.misses, pipelineStateCacheStatistics.buildMilliseconds, pipelineStateCache.size());
+
+    INFO("Requesting {} pipelines asynchronously", variantCount);
+    INFO("{:<8} {:>10.3f} ms on the requesting thread, ready {:.3f} ms later", "async", asyncRequestMs, asyncReadyMs);
+    auto& shaderModuleCache = device->getShaderModuleCache();
+    INFO("Shader modules");
+    INFO("{:<8} {} alive, {} hits, {} misses", "shared", shaderModuleCache.size(), shaderModuleCache.getHits(), shaderModuleCache.getMisses());
+    INFO("Linking {} pipelines through the pipeline library{}", variantCount, pipelineLibrary.isSupported() ? "" : " (not supported, built whole)");
+    INFO("{:<8} {:>10.3f} ms total, {} part hits, {} part misses", "fast", pipelineLibraryMs, 
+        pipelineLibraryStatistics.partHits, pipelineLibraryStatistics.partMisses);
+    INFO("{:<8} {:>10.3f} ms waiting for the optimized links", "lto", pipelineLibraryOptimizedMs);
+
+    device->get().waitIdle();
+
+    return 0;
+}
@@ -8,6 +8,8 @@
 #include "renderer/renderer.hpp"
 #include "gfx/buffer.hpp"
 
+#include "test-2_shaders.hpp"
+
 #include <memory>
 
 struct vec2 {
@@ -117,8 +119,8 @@ int main(int argc, char **argv) {
 
 
     gfx::GraphicsPipeline pipeline = gfx::GraphicsPipeline::Builder{}
-        .addShaderFromPath("../../../assets/shader/test-2.vert")
-        .addShaderFromPath("../../../assets/shader/test.frag")
+        .addShaderFromSpirv(shaders::test_2_vert, vk::ShaderStageFlagBits::eVertex)
+        .addShaderFromSpirv(shaders::test_frag, vk::ShaderStageFlagBits::eFragment)
         .addVertexInputBindingDescription(Vertex::getBindingDescription()[0])
         .addVertexInputAttributeDescription(Vertex::getAttributeDescription()[0])
         .addVertexInputAttributeDescription(Vertex::getAttributeDescription()[1])
@@ -4,6 +4,8 @@
 #include "gfx/device.hpp"
 #include "gfx/swapchain.hpp"
 #include "gfx/pipeline.hpp"
+#include "gfx/hotreload.hpp"
+#include "gfx/pipelinemanifest.hpp"
 #include "gfx/commandbuffer.hpp"
 #include "gfx/buffer.hpp"
 #include "gfx/descriptors.hpp"
@@ -93,16 +95,14 @@ int main(int argc, char **argv) {
         .setUsage(vk::BufferUsageFlagBits::eIndexBuffer)
         .build(device);
 
-    std::vector<gfx::Buffer> uniformBuffers;
-    uniformBuffers.reserve(swapChain.MAX_FRAMES_IN_FLIGHT);
-    for (int i = 0; i < swapChain.MAX_FRAMES_IN_FLIGHT; i++) {
-        uniformBuffers.emplace_back(gfx::Buffer::Builder{}
-            .setMemoryProperty(vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible)
-            .setSharingMode(vk::SharingMode::eExclusive)
-            .setSize(sizeof(UniformBufferObject))
-            .setUsage(vk::BufferUsageFlagBits::eUniformBuffer)
-            .build(device));
-    }
+    // one uniform buffer for every frame in flight, each frame addresses its slice through a dynamic offset
+    const vk::DeviceSize uniformBufferObjectStride = device->alignUniformBufferSize(sizeof(UniformBufferObject));
+    gfx::Buffer uniformBuffer = gfx::Buffer::Builder{}
+        .setMemoryProperty(vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible)
+        .setSharingMode(vk::SharingMode::eExclusive)
+        .setSize(uniformBufferObjectStride * swapChain.MAX_FRAMES_IN_FLIGHT)
+        .setUsage(vk::BufferUsageFlagBits::eUniformBuffer)
+        .build(device);
 
     vertexBuffer.map();
     std::memcpy(vertexBuffer.getMapped(), vertices.data(), sizeof(Vertex) * vertices.size());
@@ -114,27 +114,31 @@ int main(int argc, char **argv) {
 
     
     gfx::DescriptorSetLayout descriptorSetLayout = gfx::DescriptorSetLayout::Builder{}
-        .addBinding(0, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eVertex, 1)
+        .addBinding(0, vk::DescriptorType::eUniformBufferDynamic, vk::ShaderStageFlagBits::eVertex, 1)
         .build(device);
 
     gfx::DescriptorPool descriptorPool = gfx::DescriptorPool::Builder{}
-        .addPoolSize(vk::DescriptorType::eUniformBuffer, swapChain.MAX_FRAMES_IN_FLIGHT)
-        .setMaxSets(swapChain.MAX_FRAMES_IN_FLIGHT)
+        .addPoolSize(vk::DescriptorType::eUniformBufferDynamic, 1)
+        .setMaxSets(1)
         // .setMaxSets(1000) // might be worth to default this to 1000
         .build(device);
 
     auto descriptors = descriptorPool.allocate(gfx::DescriptorPool::SetAllocateInfo{}
-        .addLayout(descriptorSetLayout)
-        .addLayout(descriptorSetLayout)
         .addLayout(descriptorSetLayout));
 
-    for (int i = 0; i < descriptors.size(); i++) {
-        auto& descriptor = descriptors[i];
-        descriptor.update(gfx::DescriptorSet::Update{}
-            .addBuffer(0, uniformBuffers[i].getDescriptorBufferInfo()));
-    }
+    descriptors[0].update(gfx::DescriptorSet::Update{}
+        .addBuffer(0, uniformBuffer.getDescriptorBufferInfo(0, sizeof(UniformBufferObject))));
 
-    gfx::GraphicsPipeline pipeline = gfx::GraphicsPipeline::Builder{}
+    // whatever the previous run recorded is built before the first frame, where a loading screen would show the progress
+    gfx::DescriptorSetLayoutCache descriptorSetLayoutCache{device};
+    device->getPipelineManifest().prewarm(device, gfx::PipelineManifest::PrewarmInfo{}
+        .addRenderPass(renderer.getRenderPass())
+        .setDescriptorSetLayoutCache(descriptorSetLayoutCache)
+        .setProgressCallback([](uint32_t completed, uint32_t total) {
+            INFO("Prewarming pipelines {}/{}", completed, total);
+        }));
+
+    auto pipelineBuilder = gfx::GraphicsPipeline::Builder{}
         .addShaderFromPath("../../../assets/shader/test-3.vert")
         .addShaderFromPath("../../../assets/shader/test.frag")
         .addDescriptorSetLayout(descriptorSetLayout)
@@ -143,16 +147,6 @@ int main(int argc, char **argv) {
         .addVertexInputAttributeDescription(Vertex::getAttributeDescription()[1])
         .setInputAssemblyTopology(vk::PrimitiveTopology::eTriangleList)
         .setInputAssemblyPrimitiveRestartEnable(false)
-        .addViewport(vk::Viewport{}
-            .setX(0.f)
-            .setY(0.f)
-            .setWidth(swapChain.getExtent().width)
-            .setHeight(swapChain.getExtent().height)
-            .setMinDepth(0.0f)
-            .setMaxDepth(1.0f))
-        .addScissor(vk::Rect2D{}
-            .setOffset(vk::Offset2D{ 0, 0 })
-            .setExtent(swapChain.getExtent()))
         .setRasterizerDepthClampEnable(false)
         .setRasterizerDiscardEnable(false)
         .setRasterizerPolygonMode(vk::PolygonMode::eFill)
@@ -166,7 +160,12 @@ int main(int argc, char **argv) {
             .setBlendEnable(vk::Bool32{ false }))
         .setColorBlendStateLogicOpEnable(false)
         .setRenderPass(renderer.getRenderPass())
-        .build(device);
+        .setExtendedDynamicState(true);
+    gfx::GraphicsPipeline pipeline = pipelineBuilder.build(device);
+
+    // edit the shaders while running to see them rebuilt
+    gfx::HotReloader hotReloader{device, swapChain.MAX_FRAMES_IN_FLIGHT};
+    hotReloader.watch(pipeline, pipelineBuilder);
 
     auto update = [&]() {
         UniformBufferObject ubo;
@@ -176,13 +175,14 @@ int main(int argc, char **argv) {
             v = 0;
         }
         ubo.color = {v, v, v};
-        uniformBuffers[renderer.getCurrentFrameIndex()].map();
-        std::memcpy(uniformBuffers[renderer.getCurrentFrameIndex()].getMapped(), &ubo, sizeof(ubo));
-        uniformBuffers[renderer.getCurrentFrameIndex()].unmap();
+        std::memcpy(static_cast<char *>(uniformBuffer.getMapped()) + uniformBufferObjectStride * renderer.getCurrentFrameIndex(), &ubo, sizeof(ubo));
     };
 
+    uniformBuffer.map();
+
     while (!window.shouldClose()) {
         core::Window::pollEvents();
+        hotReloader.update();
 
         if (auto res = renderer.begin()) {
             auto [commandBuffer, imageIndex] = res.value();
@@ -192,7 +192,21 @@ int main(int argc, char **argv) {
             update();
 
             pipeline.bind(commandBuffer);
-            commandBuffer.get().bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline.getPipelineLayout(), 0, 1, &descriptors[renderer.getCurrentFrameIndex()].get(), 0, nullptr);
+            // viewport and scissor are set by the renderer, the rest only when the device made them dynamic
+            if (pipeline.hasDynamicState(vk::DynamicState::eCullMode)) {
+                commandBuffer.setCullMode(vk::CullModeFlagBits::eNone);
+                commandBuffer.setFrontFace(vk::FrontFace::eCounterClockwise);
+                commandBuffer.setPrimitiveTopology(vk::PrimitiveTopology::eTriangleList);
+            }
+            if (pipeline.hasDynamicState(vk::DynamicState::ePrimitiveRestartEnable)) {
+                commandBuffer.setRasterizerDiscardEnable(false);
+                commandBuffer.setDepthBiasEnable(false);
+                commandBuffer.setPrimitiveRestartEnable(false);
+            }
+            if (pipeline.hasDynamicState(vk::DynamicState::ePolygonModeEXT)) {
+                commandBuffer.setPolygonMode(vk::PolygonMode::eFill);
+            }
+            commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline.getPipelineLayout(), 0, descriptors[0], static_cast<uint32_t>(uniformBufferObjectStride * renderer.getCurrentFrameIndex()));
 
             commandBuffer.get().bindVertexBuffers(0, {vertexBuffer.get()}, {0});
             commandBuffer.get().bindIndexBuffer(indexBuffer.get(), {0}, vk::IndexType::eUint32);
@@ -207,5 +221,7 @@ int main(int argc, char **argv) {
     
     device->get().waitIdle();
 
+    uniformBuffer.unmap();
+
     return 0;
 }
\ No newline at end of file
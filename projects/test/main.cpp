@@ -8,6 +8,8 @@
 #include "renderer/renderer.hpp"
 #include "gfx/buffer.hpp"
 
+#include "test_shaders.hpp"
+
 #include <memory>
 
 int main() {
@@ -22,8 +24,8 @@ int main() {
     renderer::Renderer renderer = renderer::Renderer::Builder{}.build(device, swapChain);
 
     gfx::GraphicsPipeline pipeline = gfx::GraphicsPipeline::Builder{}
-        .addShaderFromPath("../../../assets/shader/test.vert")
-        .addShaderFromPath("../../../assets/shader/test.frag")
+        .addShaderFromSpirv(shaders::test_vert, vk::ShaderStageFlagBits::eVertex)
+        .addShaderFromSpirv(shaders::test_frag, vk::ShaderStageFlagBits::eFragment)
         .addDynamicState(vk::DynamicState::eViewport)
         .addDynamicState(vk::DynamicState::eScissor)
         .setInputAssemblyTopology(vk::PrimitiveTopology::eTriangleList)